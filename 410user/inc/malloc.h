@@ -4,14 +4,44 @@
 #ifndef _MALLOC_WRAPPERS_H_
 #define _MALLOC_WRAPPERS_H_
 
+#define MALLOC_CLASSES 16   /* size class i holds blocks of up to 32 << i
+                               bytes, the last one all larger ones too */
+
+/* What the allocator has been up to, see malloc_stats() */
+typedef struct malloc_stats {
+  unsigned int allocs[MALLOC_CLASSES]; /* blocks handed out, by size class */
+  unsigned int frees[MALLOC_CLASSES];  /* blocks freed, by size class */
+  unsigned int searches;    /* free list searches */
+  unsigned int probes;      /* blocks the searches looked at */
+  unsigned int lock_waits;  /* times a heap's lock was taken already */
+  unsigned int lock_ticks;  /* ticks spent waiting for it */
+  int live;                 /* bytes in allocated blocks of the heaps */
+  int committed;            /* bytes of the heaps backed by pages */
+  int mapped;               /* bytes in ranges of their own */
+  int free_bytes;           /* bytes in free blocks */
+  int free_blocks;          /* number of free blocks */
+  int largest_free;         /* bytes in the largest free block */
+} malloc_stats_t;
+
 void *malloc(size_t size);
 void *calloc(size_t nelt, size_t eltsize);
 void *realloc(void *buf, size_t new_size);
+void *memalign(size_t alignment, size_t size);
+void *valloc(size_t size);
 void free(void *buf);
+void malloc_set_trim_threshold(size_t threshold);
+int malloc_trim(void);
+void malloc_stats(malloc_stats_t *stats);
+void malloc_report(void);
 
 void *_malloc(size_t size);
 void *_calloc(size_t nelt, size_t eltsize);
 void *_realloc(void *buf, size_t new_size);
+void *_memalign(size_t alignment, size_t size);
 void _free(void *buf);
+void _malloc_set_trim_threshold(size_t threshold);
+int _malloc_trim(void);
+void _malloc_stats(malloc_stats_t *stats);
+void _malloc_report(void);
 
 #endif /* _MALLOC_WRAPPERS_H_ */
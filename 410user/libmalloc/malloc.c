@@ -7,13 +7,18 @@
 #include "mm_malloc.h"
 #include <stddef.h>
 #include <stdlib.h>
-#include <string.h> /* for bzero */
+#include <string.h> /* for memset */
 
 /*
  * Has the mm_malloc library been initialized yet?
  */
 static unsigned int inited = 0;
 
+/*
+ * The heap right above the program
+ */
+static mm_heap_t heap;
+
 
 /*
  * wrapper around the mm_malloc library mm_malloc
@@ -22,35 +27,43 @@ void *
 _malloc( size_t __size )
 {
 	if( !inited ) {
-		if ( mm_init() < 0 ) {
+		if ( mm_init( &heap, mem_init( 0xffffffff ), 1 ) < 0 ) {
 			return NULL;
 		}
 		inited = 1;
 	}
-	return mm_malloc( __size );
+	return mm_malloc( &heap, __size );
 }
 
 /*
- * calloc implimented with mm_malloc library
+ * wrapper around the mm_malloc library mm_calloc
  */
 void *
 _calloc( size_t __nelt, size_t __eltsize )
 {
-	void *new;
-
 	if( !inited ) {
-		if ( mm_init() < 0 ) {
+		if ( mm_init( &heap, mem_init( 0xffffffff ), 1 ) < 0 ) {
 			return NULL;
 		}
 		inited = 1;
 	}
 
-	new = mm_malloc( __nelt * __eltsize );
-	if( !new ) {
-		return NULL;
+	return mm_calloc( &heap, __nelt * __eltsize );
+}
+
+/*
+ * wrapper around the mm_malloc library mm_memalign
+ */
+void *
+_memalign( size_t __alignment, size_t __size )
+{
+	if( !inited ) {
+		if ( mm_init( &heap, mem_init( 0xffffffff ), 1 ) < 0 ) {
+			return NULL;
+		}
+		inited = 1;
 	}
-	bzero( new, __nelt * __eltsize );
-	return new;
+	return mm_memalign( &heap, __alignment, __size );
 }
 
 /*
@@ -63,7 +76,7 @@ _realloc( void *__buf, size_t __new_size )
 		/* have to malloc before realloc =P */
 		return NULL;
         }
-	return mm_realloc( __buf, __new_size );
+	return mm_realloc( &heap, __buf, __new_size );
 }
 
 /*
@@ -76,5 +89,51 @@ _free( void *__buf )
 		/* hmm. not really anything to free. */
 		return;
 	}
-	mm_free( __buf );
+	mm_free( &heap, __buf );
+}
+
+/*
+ * wrapper around the mm_malloc library mm_set_trim_threshold
+ */
+void
+_malloc_set_trim_threshold( size_t __threshold )
+{
+	mm_set_trim_threshold( __threshold );
+}
+
+/*
+ * wrapper around the mm_malloc library mm_trim
+ */
+int
+_malloc_trim( void )
+{
+	if( !inited ) {
+		/* nothing to give back yet */
+		return 0;
+	}
+	return mm_trim( &heap );
+}
+
+/*
+ * wrapper around the mm_malloc library mm_stats, starting from zero
+ */
+void
+_malloc_stats( malloc_stats_t *__stats )
+{
+	memset( __stats, 0, sizeof( *__stats ) );
+	if( inited ) {
+		mm_stats( &heap, __stats );
+	}
+}
+
+/*
+ * print what _malloc_stats has to say
+ */
+void
+_malloc_report( void )
+{
+	malloc_stats_t stats;
+
+	_malloc_stats( &stats );
+	mm_report( &stats );
 }
@@ -8,6 +8,7 @@
 #include <stddef.h>
 #include <stdio.h>
 #include <syscall.h>
+#include <memlib.h>
 
 /* #define PAGE_SIZE       0x00001000 */
 /* #define PAGE_ALIGN_MASK 0xFFFFF000 */
@@ -17,56 +18,323 @@
 #define NULL 0
 #endif
 
+/* heap->regions holds every new_pages() call the heap made, in address
+ * order. Region i runs from its base up to the base of region i+1, the last
+ * one up to heap->alloctop. The low bits of an entry are flags, the bases
+ * are page aligned. */
+#define MEM_REMOVED     0x1 /* pages given back with remove_pages() */
+#define MEM_PINNED      0x2 /* table overflowed, spans several new_pages() */
+#define REGION_BASE(h, i) ((char *)((h)->regions[i] & PAGE_ALIGN_MASK))
+#define REGION_END(h, i)  ((i) + 1 < (h)->nregions ? \
+                           REGION_BASE(h, (i) + 1) : (h)->alloctop)
+
+/* Ranges handed out by mem_map(), and the ones given back by mem_unmap()
+ * kept around to be handed out again. */
+#define MEM_MAX_MAPS    256
+
 /* private global variables */
-static char *mem_max_addr;   /* max virtual address for the heap */
-static char *mem_brkp; /* Simulated brk pointer */
-static char *mem_alloctop; /* Maximum allocated address */
+static mem_heap_t mem_main; /* The heap right above the ELF binary, whose
+                               max is where reserved ranges start */
+static struct {
+  char *base;
+  int len;
+  int used;
+} mem_maps[MEM_MAX_MAPS];
+static int mem_nmaps;
+
+/*
+ * mem_add_region - records a new_pages() call at base. Once the table is
+ *    full the last region just grows, and can no longer be removed.
+ */
+static void mem_add_region(mem_heap_t *heap, char *base)
+{
+  if (heap->nregions < MEM_MAX_REGIONS)
+    heap->regions[heap->nregions++] = (unsigned int)base;
+  else
+    heap->regions[heap->nregions - 1] |= MEM_PINNED;
+}
+
+/*
+ * mem_find_region - index of the region holding addr, or of the first one
+ *    above it. heap->nregions if there is none.
+ */
+static int mem_find_region(mem_heap_t *heap, char *addr)
+{
+  int lo = 0, hi = heap->nregions;
+
+  while (lo < hi) {
+    int mid = (lo + hi) / 2;
+    if (REGION_END(heap, mid) <= addr)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return lo;
+}
 
 extern void *_end; /* The end of the ELF binary address space */
 
 /* 
- * mem_init - initializes the memory system model
+ * mem_init - initializes the memory system model, returns the heap right
+ *    above the ELF binary
+ */
+mem_heap_t *mem_init(int max_heap_addr)
+{
+  /* The max address for the heap, unless it was lowered already. */
+  if (mem_main.max_addr == NULL || (char*)max_heap_addr < mem_main.max_addr)
+    mem_main.max_addr = (char*)max_heap_addr;
+  mem_main.brkp = (char*)&_end + PAGE_SIZE;
+  mem_main.brkp = (char*)((int)mem_main.brkp & PAGE_ALIGN_MASK);
+  while (new_pages(mem_main.brkp, PAGE_SIZE))
+    mem_main.brkp += PAGE_SIZE;
+  mem_main.nregions = 0;
+  mem_add_region(&mem_main, mem_main.brkp);
+  mem_main.alloctop = mem_main.brkp + PAGE_SIZE;
+  return &mem_main;
+}
+
+/*
+ * mem_heap_init - initializes a heap of its own in [lo, hi), which is
+ *    usually a range from mem_reserve(). Nothing is mapped up front.
  */
-void mem_init(int max_heap_addr)
+void mem_heap_init(mem_heap_t *heap, void *lo, void *hi)
 {
-  /* The max address for the heap. */
-  mem_max_addr = (char*)max_heap_addr;
-  mem_brkp = (char*)&_end + PAGE_SIZE;
-  mem_brkp = (char*)((int)mem_brkp & PAGE_ALIGN_MASK);
-  while (new_pages(mem_brkp, PAGE_SIZE))
-    mem_brkp += PAGE_SIZE;
-  mem_alloctop = mem_brkp + PAGE_SIZE;
+  heap->max_addr = (char *)hi;
+  heap->brkp = (char *)lo;
+  heap->alloctop = (char *)lo;
+  heap->nregions = 0;
 }
 
 /* 
  * mem_sbrk - simply uses the the sbrk function. Extends the heap 
  *    by incr bytes and returns the start address of the new area. In
- *    this model, the heap cannot be shrunk.
+ *    this model, the heap cannot be shrunk, but pages in the middle of it
+ *    can be given back with mem_release().
  */
-void *mem_sbrk(int incr) 
+void *mem_sbrk(mem_heap_t *heap, int incr) 
 {
-    char *old_brk = mem_brkp;
+    char *old_brk = heap->brkp;
 
     /* Error check the request. */
-    if ( (incr < 0) || ((old_brk + incr) > mem_max_addr)) {
+    if ( (incr < 0) || ((old_brk + incr) > heap->max_addr)) {
       return (void *)NULL;
     }
 
-    if (old_brk + incr > mem_alloctop) {
-      int allocincr = old_brk + incr - mem_alloctop;
+    if (old_brk + incr > heap->alloctop) {
+      int allocincr = old_brk + incr - heap->alloctop;
       allocincr += PAGE_SIZE - 1;
       allocincr &= PAGE_ALIGN_MASK;
 
       /* Issue a SBRK for more memory. */
-      if (new_pages((void*)mem_alloctop, allocincr)) {
+      if (new_pages((void*)heap->alloctop, allocincr)) {
 	return (void *)NULL;
       }
 
-      mem_alloctop += allocincr;
+      mem_add_region(heap, heap->alloctop);
+      heap->alloctop += allocincr;
     }
 
-    mem_brkp += incr;
+    heap->brkp += incr;
 
     return (void *)old_brk;
 }
+
+/*
+ * mem_set_max - lowers the max virtual address for the heap above the ELF
+ *    binary, so whatever lives above it is safe from the heap growing into
+ *    it. Returns -1 if the heap is already in the way.
+ */
+int mem_set_max(void *max_addr)
+{
+    char *max = (char *)((unsigned int)max_addr & PAGE_ALIGN_MASK);
+
+    if (mem_main.alloctop != NULL && max < mem_main.alloctop)
+      return -1;
+    if (mem_main.max_addr == NULL || max < mem_main.max_addr)
+      mem_main.max_addr = max;
+    return 0;
+}
+
+/*
+ * mem_reserve - takes size bytes of address space, rounded up to whole
+ *    pages, off the top of the range of the heap above the ELF binary. The
+ *    heap never grows into a reserved range, and nothing is mapped there;
+ *    that is up to the caller. Returns the low end of the range. Reserved
+ *    ranges are never given back.
+ */
+void *mem_reserve(int size)
+{
+    char *low;
+
+    if (size <= 0 || mem_main.max_addr == NULL)
+      return (void *)NULL;
+
+    size = (size + PAGE_SIZE - 1) & PAGE_ALIGN_MASK;
+    low = (char *)(((unsigned int)mem_main.max_addr - size) & PAGE_ALIGN_MASK);
+    if (low > mem_main.max_addr || low < mem_main.alloctop)
+      return (void *)NULL;
+
+    mem_main.max_addr = low;
+    return (void *)low;
+}
+
+/*
+ * mem_release - gives every region of heap lying entirely within [lo, hi)
+ *    back to the kernel. The caller promises not to touch the range until it
+ *    has gone through mem_recommit(). Returns the number of bytes released.
+ */
+int mem_release(mem_heap_t *heap, void *lo, void *hi)
+{
+    int i, released = 0;
+
+    for (i = mem_find_region(heap, (char *)lo);
+         i < heap->nregions && REGION_END(heap, i) <= (char *)hi; i++) {
+      if (REGION_BASE(heap, i) < (char *)lo ||
+          (heap->regions[i] & (MEM_REMOVED | MEM_PINNED)))
+        continue;
+      if (remove_pages(REGION_BASE(heap, i)) == 0) {
+        heap->regions[i] |= MEM_REMOVED;
+        released += REGION_END(heap, i) - REGION_BASE(heap, i);
+      }
+    }
+    return released;
+}
+
+/*
+ * mem_recommit - maps back every released region of heap overlapping
+ *    [lo, hi). Returns 0 on success, -1 if the kernel is out of memory, in
+ *    which case some of the regions may be back already.
+ */
+int mem_recommit(mem_heap_t *heap, void *lo, void *hi)
+{
+    int i;
+
+    for (i = mem_find_region(heap, (char *)lo);
+         i < heap->nregions && REGION_BASE(heap, i) < (char *)hi; i++) {
+      if (!(heap->regions[i] & MEM_REMOVED))
+        continue;
+      if (new_pages(REGION_BASE(heap, i),
+                    REGION_END(heap, i) - REGION_BASE(heap, i)) < 0)
+        return -1;
+      heap->regions[i] &= ~MEM_REMOVED;
+    }
+    return 0;
+}
+
+/*
+ * mem_map - maps size bytes, rounded up to whole pages, in a range of its
+ *    own outside the heap. Address space given back by mem_unmap() is used
+ *    again before more is taken with mem_reserve(). Returns the low end of
+ *    the range, NULL if there is no room in the table, address space or
+ *    memory.
+ */
+void *mem_map(int size)
+{
+    int i, best = -1;
+    char *base;
+
+    if (size <= 0)
+      return (void *)NULL;
+    size = (size + PAGE_SIZE - 1) & PAGE_ALIGN_MASK;
+
+    /* Best fit among the ranges that were unmapped */
+    for (i = 0; i < mem_nmaps; i++) {
+      if (!mem_maps[i].used && mem_maps[i].len >= size &&
+          (best < 0 || mem_maps[i].len < mem_maps[best].len))
+        best = i;
+    }
+
+    if (best >= 0) {
+      /* Split off the rest, or take all of it if the table is full */
+      if (mem_maps[best].len > size && mem_nmaps < MEM_MAX_MAPS) {
+        mem_maps[mem_nmaps].base = mem_maps[best].base + size;
+        mem_maps[mem_nmaps].len = mem_maps[best].len - size;
+        mem_maps[mem_nmaps].used = 0;
+        mem_nmaps++;
+        mem_maps[best].len = size;
+      }
+      if (new_pages(mem_maps[best].base, mem_maps[best].len))
+        return (void *)NULL;
+      mem_maps[best].used = 1;
+      return (void *)mem_maps[best].base;
+    }
+
+    if (mem_nmaps >= MEM_MAX_MAPS || (base = mem_reserve(size)) == NULL)
+      return (void *)NULL;
+    mem_maps[mem_nmaps].base = base;
+    mem_maps[mem_nmaps].len = size;
+    mem_maps[mem_nmaps].used = 0;
+    mem_nmaps++;
+    if (new_pages(base, size))
+      return (void *)NULL;
+    mem_maps[mem_nmaps - 1].used = 1;
+    return (void *)base;
+}
+
+/*
+ * mem_unmap - gives a range from mem_map() back to the kernel. Its address
+ *    space is merged with any free neighbours for mem_map() to reuse.
+ *    Returns -1 if base didn't come from mem_map().
+ */
+int mem_unmap(void *base)
+{
+    int i, j;
+
+    for (i = 0; i < mem_nmaps; i++) {
+      if (mem_maps[i].used && mem_maps[i].base == (char *)base)
+        break;
+    }
+    if (i == mem_nmaps || remove_pages(base))
+      return -1;
+    mem_maps[i].used = 0;
+
+    for (j = 0; j < mem_nmaps; j++) {
+      if (j == i || mem_maps[j].used)
+        continue;
+      if (mem_maps[j].base + mem_maps[j].len == mem_maps[i].base) {
+        mem_maps[j].len += mem_maps[i].len;
+      } else if (mem_maps[i].base + mem_maps[i].len == mem_maps[j].base) {
+        mem_maps[i].len += mem_maps[j].len;
+        mem_maps[j] = mem_maps[i];
+      } else {
+        continue;
+      }
+      /* Entry j took over i, drop i and look for a neighbour on the other
+       * side of the merged range */
+      mem_maps[i] = mem_maps[--mem_nmaps];
+      if (j == mem_nmaps)
+        j = i;
+      i = j;
+      j = -1;
+    }
+    return 0;
+}
+
+/*
+ * mem_committed - bytes of heap backed by pages right now
+ */
+int mem_committed(mem_heap_t *heap)
+{
+    int i, committed = 0;
+
+    for (i = 0; i < heap->nregions; i++) {
+      if (!(heap->regions[i] & MEM_REMOVED))
+        committed += REGION_END(heap, i) - REGION_BASE(heap, i);
+    }
+    return committed;
+}
+
+/*
+ * mem_mapped - bytes in ranges from mem_map() that are still mapped
+ */
+int mem_mapped(void)
+{
+    int i, mapped = 0;
+
+    for (i = 0; i < mem_nmaps; i++) {
+      if (mem_maps[i].used)
+        mapped += mem_maps[i].len;
+    }
+    return mapped;
+}
 /* $end memlib */
@@ -7,7 +7,28 @@
 #ifndef _MEMLIB_H
 #define _MEMLIB_H
 
-void *mem_init(int size);
-void *mem_sbrk(int incr);
+/* Most new_pages() calls a heap keeps track of, see memlib.c */
+#define MEM_MAX_REGIONS 2048
+
+/* A heap growing upwards through mem_sbrk() */
+typedef struct mem_heap {
+  char *max_addr;   /* max virtual address for the heap */
+  char *brkp;       /* Simulated brk pointer */
+  char *alloctop;   /* Maximum allocated address */
+  unsigned int regions[MEM_MAX_REGIONS]; /* new_pages() calls so far */
+  int nregions;
+} mem_heap_t;
+
+mem_heap_t *mem_init(int size);
+void mem_heap_init(mem_heap_t *heap, void *lo, void *hi);
+void *mem_sbrk(mem_heap_t *heap, int incr);
+int mem_set_max(void *max_addr);
+void *mem_reserve(int size);
+int mem_release(mem_heap_t *heap, void *lo, void *hi);
+int mem_recommit(mem_heap_t *heap, void *lo, void *hi);
+void *mem_map(int size);
+int mem_unmap(void *base);
+int mem_committed(mem_heap_t *heap);
+int mem_mapped(void);
 
 #endif /* _MEMLIB_H */
@@ -24,6 +24,29 @@
  *
  * The allocated prologue and epilogue blocks are overhead that
  * eliminate edge conditions during coalescing.
+ *
+ * Once a free block grows past the trim threshold, the new_pages() regions
+ * lying strictly inside it are given back with remove_pages() and the block
+ * is marked with HOLES. Only its header and footer are ever looked at while
+ * it is free, and place() maps the holes back before handing it out again.
+ *
+ * Requests of LARGE_SIZE or more don't go into the list at all. They get a
+ * range of pages of their own from mem_map(), with a header marked MAPPED a
+ * word below the payload, and go straight back to the kernel when freed.
+ * The payload of a mapped block starts less than a page into its range.
+ *
+ * mm_memalign() gets a block with room to spare, hands out the aligned part
+ * of it and splits what is in front and behind off into free blocks.
+ *
+ * The kernel hands out new_pages() zeroed, so the heap keeps a watermark
+ * below which blocks have been handed out at some point. Above it nothing
+ * but the boundary tags of free blocks was ever written, and mm_calloc()
+ * only has to clear the part of a block below it. Mapped blocks are always
+ * zero to begin with.
+ *
+ * Each heap counts the blocks coming and going by size class, the bytes in
+ * use and the work find_fit() does. The rest of the picture mm_stats() puts
+ * together when asked, by walking the heap.
  */
 #include "mm_malloc.h"
 #include <memlib.h>
@@ -31,15 +54,24 @@
 #include <string.h>
 #include <stdio.h>
 #include <simics.h>
+#include <syscall.h>
 
-/* The only global variable is a pointer to the first block */
-static char *heap_listp;   
+/* Free blocks at least this large give their pages back, 0 never does */
+static int trim_threshold = TRIM_THRESHOLD;
 
 /* function prototypes for internal helper routines */
-static void *extend_heap(int words);
-static void place(void *bp, int asize);
-static void *find_fit(int asize);
+static void *extend_heap(mm_heap_t *heap, int words);
+static void *heap_alloc(mm_heap_t *heap, int asize);
+static int place(mm_heap_t *heap, void *bp, int asize);
+static void *find_fit(mm_heap_t *heap, int asize);
 static void *coalesce(void *bp);
+static int release(mm_heap_t *heap, void *bp);
+static void *map_block(int asize, int align);
+static void count_alloc(mm_heap_t *heap, void *bp);
+static void count_free(mm_heap_t *heap, void *bp);
+static int resize(mm_heap_t *heap, void *bp, int asize);
+static void used(mm_heap_t *heap, void *bp);
+static void zero(void *p, unsigned int n);
 static void printblock(void *bp); 
 static void checkblock(void *bp);
 
@@ -50,26 +82,50 @@ min( unsigned int x, unsigned int y )
 	return ( x < y ? x : y );
 }
 
+/* Size class of a block of size bytes, see MALLOC_CLASSES */
+static inline int
+size_class( int size )
+{
+	int class = 0;
+
+	while ( class < MALLOC_CLASSES - 1 && (32 << class) < size )
+		class++;
+	return class;
+}
+
+/* Adjust block size to include overhead and alignment reqs. */
+static inline int
+adjusted_size( int size )
+{
+	if ( size <= DSIZE )
+		return DSIZE + OVERHEAD;
+	return DSIZE * ((size + (OVERHEAD) + (DSIZE-1)) / DSIZE);
+}
+
 /* 
- * mm_init - Initialize the memory manager 
+ * mm_init - Initialize the memory manager for a heap in mem. Only the
+ *     heap whose map_large is set maps large requests on their own, mem_map()
+ *     is shared by all of them.
  */
 /* $begin mminit */
-int mm_init(void) 
+int mm_init(mm_heap_t *heap, mem_heap_t *mem, int map_large) 
 {
-  
-    /* create the initial empty heap */
-  mem_init(0xffffffff);
-  
-  if ((heap_listp = mem_sbrk(4*WSIZE)) == NULL)
+  char *heap_listp;
+
+  heap->mem = mem;
+  heap->map_large = map_large;
+  if ((heap_listp = mem_sbrk(mem, 4*WSIZE)) == NULL)
     return -1;
   PUT(heap_listp, 0);                        /* alignment padding */
   PUT(heap_listp+WSIZE, PACK(OVERHEAD, 1));  /* prologue header */ 
   PUT(heap_listp+DSIZE, PACK(OVERHEAD, 1));  /* prologue footer */ 
   PUT(heap_listp+WSIZE+DSIZE, PACK(0, 1));   /* epilogue header */
-  heap_listp += DSIZE;
+  heap->heap_listp = heap_listp + DSIZE;
+  heap->fresh = heap_listp + 4*WSIZE;
+  memset(&heap->stats, 0, sizeof(heap->stats));
   
   /* Extend the empty heap with a free block of CHUNKSIZE bytes */
-  if (extend_heap(CHUNKSIZE/WSIZE) == NULL)
+  if (extend_heap(heap, CHUNKSIZE/WSIZE) == NULL)
     return -1;
   return 0;
 }
@@ -80,44 +136,95 @@ int mm_init(void)
  * mm_malloc - Allocate a block with at least size bytes of payload 
  */
 /* $begin mmmalloc */
-void *mm_malloc(int size) 
+void *mm_malloc(mm_heap_t *heap, int size) 
 {
     int asize;      /* adjusted block size */
-    int extendsize; /* amount to extend heap if no fit */
     char *bp;      
 
     /* Ignore spurious requests */
     if (size <= 0) {
 		return NULL;
 	 }
-    /* Adjust block size to include overhead and alignment reqs. */
-    if (size <= DSIZE)
-	asize = DSIZE + OVERHEAD;
-    else
-	asize = DSIZE * ((size + (OVERHEAD) + (DSIZE-1)) / DSIZE);
-    
-    /* Search the free list for a fit */
-    if ((bp = find_fit(asize)) != NULL) {
-		place(bp, asize);
-		return bp;
-	 }
+    asize = adjusted_size(size);
 
-    /* No fit found. Get more memory and place the block */
-    extendsize = MAX(asize,CHUNKSIZE);
-    if ((bp = extend_heap(extendsize/WSIZE)) == NULL) {
-		return NULL;
-	 }
-    place(bp, asize);
-    
+    /* Big ones get pages of their own, or go into the heap if that fails */
+    if ((heap->map_large && size >= LARGE_SIZE &&
+	 (bp = map_block(asize, DSIZE)) != NULL) ||
+	(bp = heap_alloc(heap, asize)) != NULL)
+		count_alloc(heap, bp);
     return bp;
 } 
 /* $end mmmalloc */
 
+/*
+ * mm_memalign - Allocate a block with at least size bytes of payload at a
+ *     multiple of align, which is a power of two
+ */
+void *mm_memalign(mm_heap_t *heap, int align, int size)
+{
+    int asize, csize, prefix;
+    char *bp, *abp;
+
+    if (size <= 0 || align <= 0 || (align & (align - 1)))
+	return NULL;
+    if (align <= DSIZE)
+	return mm_malloc(heap, size);
+    asize = adjusted_size(size);
+
+    if (heap->map_large && size >= LARGE_SIZE && align <= PAGE_SIZE &&
+	(bp = map_block(asize, align)) != NULL) {
+	count_alloc(heap, bp);
+	return bp;
+    }
+
+    /* Enough to start at the alignment with a free block in front of us, if
+     * there has to be anything in front of us at all */
+    if ((bp = heap_alloc(heap, asize + align + DSIZE + OVERHEAD)) == NULL)
+	return NULL;
+    abp = (char *)(((unsigned int)bp + align - 1) & ~(align - 1));
+    if (abp != bp && abp - bp < DSIZE + OVERHEAD)
+	abp += align;
+
+    if (abp != bp) {
+	csize = GET_SIZE(HDRP(bp));
+	prefix = abp - bp;
+	PUT(HDRP(bp), PACK(prefix, 0));
+	PUT(FTRP(bp), PACK(prefix, 0));
+	PUT(HDRP(abp), PACK(csize - prefix, 1));
+	PUT(FTRP(abp), PACK(csize - prefix, 1));
+	bp = coalesce(bp);
+	if (trim_threshold > 0 && GET_SIZE(HDRP(bp)) >= trim_threshold)
+	    release(heap, bp);
+    }
+
+    /* Give back what is left behind us, can't fail when shrinking */
+    resize(heap, abp, asize);
+    count_alloc(heap, abp);
+    return abp;
+}
+
+/*
+ * mm_calloc - Allocate a block with at least size bytes of zeroed payload
+ */
+void *mm_calloc(mm_heap_t *heap, int size)
+{
+    char *fresh = heap->fresh;
+    char *bp;
+
+    if ((bp = mm_malloc(heap, size)) == NULL)
+	return NULL;
+
+    /* Only what lies below the watermark was ever written to */
+    if (!GET_MAPPED(HDRP(bp)) && bp < fresh)
+	zero(bp, min(size, fresh - bp));
+    return bp;
+}
+
 /* 
  * mm_free - Free a block 
  */
 /* $begin mmfree */
-void mm_free(void *bp)
+void mm_free(mm_heap_t *heap, void *bp)
 {
     /*
      * mm_free(NULL) is now a no-op.  Previously _malloc(5); _free(0);
@@ -128,31 +235,94 @@ void mm_free(void *bp)
     if (bp != NULL) {
         int size;
 
+        count_free(heap, bp);
+        if (GET_MAPPED(HDRP(bp))) {
+            mem_unmap((void *)(((unsigned int)bp - DSIZE) & ~(PAGE_SIZE - 1)));
+            return;
+        }
+
         size = GET_SIZE(HDRP(bp));
 
         PUT(HDRP(bp), PACK(size, 0));
         PUT(FTRP(bp), PACK(size, 0));
-        coalesce(bp);
+        bp = coalesce(bp);
+        if (trim_threshold > 0 && GET_SIZE(HDRP(bp)) >= trim_threshold)
+            release(heap, bp);
     }
 }
 
 /* $end mmfree */
 
-/* Not implemented. For consistency with 15-213 malloc driver */
-void *mm_realloc(void *ptr, int size)
+/*
+ * mm_set_trim_threshold - Free blocks of at least threshold bytes give their
+ *     pages back to the kernel from now on, in all heaps. 0 turns trimming
+ *     off.
+ */
+void mm_set_trim_threshold(int threshold)
+{
+    trim_threshold = threshold;
+}
+
+/*
+ * mm_trim - Give the pages of every free block back to the kernel now,
+ *     whatever the threshold. Returns the number of bytes released.
+ */
+int mm_trim(mm_heap_t *heap)
+{
+    char *bp;
+    int released = 0;
+
+    for (bp = heap->heap_listp; GET_SIZE(HDRP(bp)) > 0; bp = NEXT_BLKP(bp)) {
+	if (!GET_ALLOC(HDRP(bp)))
+	    released += release(heap, bp);
+    }
+    return released;
+}
+
+/*
+ * mm_size - Bytes of payload block bp has room for
+ */
+int mm_size(void *bp)
+{
+    /* A mapped block ends right after its payload */
+    return GET_SIZE(HDRP(bp)) - OVERHEAD;
+}
+
+/*
+ * mm_realloc - Resize the block in place if the blocks after it allow,
+ *     otherwise move it to a new block
+ */
+void *mm_realloc(mm_heap_t *heap, void *ptr, int size)
 {
 	unsigned int old_size;
 	unsigned int *new_chunk;
 
-	new_chunk = mm_malloc( size );
+	if( ptr && size > 0 ) {
+		if( GET_MAPPED( HDRP(ptr) ) ) {
+			/* Its pages are its own, as long as it stays large */
+			if( size >= LARGE_SIZE && size <= mm_size( ptr ) )
+				return ptr;
+		} else {
+			old_size = GET_SIZE( HDRP(ptr) );
+			if( resize( heap, ptr, adjusted_size( size ) ) == 0 ) {
+				/* Counts as the old block going, a new one coming */
+				heap->stats.frees[size_class( old_size )]++;
+				heap->stats.live -= old_size;
+				count_alloc( heap, ptr );
+				return ptr;
+			}
+		}
+	}
+
+	new_chunk = mm_malloc( heap, size );
 	if( !new_chunk ) {
 		return NULL;
 	}
 
 	if( ptr ) {
-		old_size = GET_SIZE( HDRP(ptr) );
+		old_size = mm_size( ptr );
 		memcpy( new_chunk, ptr, min( old_size, size ) );
-		mm_free( ptr );
+		mm_free( heap, ptr );
 	}
 	return new_chunk;
 }
@@ -160,8 +330,9 @@ void *mm_realloc(void *ptr, int size)
 /* 
  * mm_checkheap - Check the heap for consistency 
  */
-void mm_checkheap(int verbose) 
+void mm_checkheap(mm_heap_t *heap, int verbose) 
 {
+    char *heap_listp = heap->heap_listp;
     char *bp = heap_listp;
 
     if (verbose)
@@ -183,20 +354,86 @@ void mm_checkheap(int verbose)
 	lprintf("Bad epilogue header\n");
 }
 
+/*
+ * mm_stats - Add what happened to the heap so far to stats, and what it
+ *     looks like right now. The lock counters are left alone.
+ */
+void mm_stats(mm_heap_t *heap, malloc_stats_t *stats)
+{
+    char *bp;
+    int i, size;
+
+    for (i = 0; i < MALLOC_CLASSES; i++) {
+	stats->allocs[i] += heap->stats.allocs[i];
+	stats->frees[i] += heap->stats.frees[i];
+    }
+    stats->searches += heap->stats.searches;
+    stats->probes += heap->stats.probes;
+    stats->live += heap->stats.live;
+    stats->committed += mem_committed(heap->mem);
+    if (heap->map_large)
+	stats->mapped += mem_mapped();
+
+    for (bp = heap->heap_listp; GET_SIZE(HDRP(bp)) > 0; bp = NEXT_BLKP(bp)) {
+	if (GET_ALLOC(HDRP(bp)))
+	    continue;
+	size = GET_SIZE(HDRP(bp));
+	stats->free_bytes += size;
+	stats->free_blocks++;
+	if (size > stats->largest_free)
+	    stats->largest_free = size;
+    }
+}
+
+/*
+ * mm_report - Print stats for a human. Fragmentation is the share of the
+ *     free bytes that are not in the largest free block.
+ */
+void mm_report(malloc_stats_t *stats)
+{
+    int i, frag = 0;
+
+    /* Without overflowing, and without 64 bit division */
+    if (stats->free_bytes >= (1 << 24))
+	frag = 100 - stats->largest_free / (stats->free_bytes / 100);
+    else if (stats->free_bytes > 0)
+	frag = 100 - 100 * stats->largest_free / stats->free_bytes;
+
+    printf("malloc: %d bytes committed, %d live, %d free in %d blocks, "
+	   "%d mapped\n", stats->committed, stats->live, stats->free_bytes,
+	   stats->free_blocks, stats->mapped);
+    printf("malloc: largest free block %d, fragmentation %d%%\n",
+	   stats->largest_free, frag);
+    printf("malloc: %u searches, %u probes, %u lock waits for %u ticks\n",
+	   stats->searches, stats->probes, stats->lock_waits,
+	   stats->lock_ticks);
+    printf("malloc: %10s %10s %10s %10s\n", "size", "allocs", "frees",
+	   "in use");
+    for (i = 0; i < MALLOC_CLASSES; i++) {
+	if (stats->allocs[i] == 0)
+	    continue;
+	printf("malloc: %2s %7d %10u %10u %10u\n",
+	       i == MALLOC_CLASSES - 1 ? ">" : "<=",
+	       i == MALLOC_CLASSES - 1 ? 16 << i : 32 << i,
+	       stats->allocs[i], stats->frees[i],
+	       stats->allocs[i] - stats->frees[i]);
+    }
+}
+
 /* The remaining routines are internal helper routines */
 
 /* 
  * extend_heap - Extend heap with free block and return its block pointer
  */
 /* $begin mmextendheap */
-static void *extend_heap(int words) 
+static void *extend_heap(mm_heap_t *heap, int words) 
 {
-    char *bp;
+    char *bp, *prev;
     int size;
 	
     /* Allocate an even number of words to maintain alignment */
     size = (words % 2) ? (words+1) * WSIZE : words * WSIZE;
-    if ((bp = mem_sbrk(size)) == NULL) 
+    if ((bp = mem_sbrk(heap->mem, size)) == NULL) 
 	return NULL;
 
     /* Initialize free block header/footer and the epilogue header */
@@ -204,33 +441,77 @@ static void *extend_heap(int words)
     PUT(FTRP(bp), PACK(size, 0));         /* free block footer */
     PUT(HDRP(NEXT_BLKP(bp)), PACK(0, 1)); /* new epilogue header */
 
-    /* Coalesce if the previous block was free */
-    return coalesce(bp);
+    /* Coalesce if the previous block was free. Its footer and our header
+     * end up inside the merged block, maybe above the watermark, so clear
+     * them for mm_calloc() */
+    if (GET_ALLOC(HDRP(bp) - WSIZE))
+	return bp;
+    prev = coalesce(bp);
+    PUT(HDRP(bp) - WSIZE, 0);
+    PUT(HDRP(bp), 0);
+    return prev;
 }
 /* $end mmextendheap */
 
+/*
+ * heap_alloc - Place a block of asize bytes in the heap, growing it if
+ *     nothing fits
+ */
+static void *heap_alloc(mm_heap_t *heap, int asize)
+{
+    int extendsize; /* amount to extend heap if no fit */
+    char *bp;
+
+    /* Search the free list for a fit */
+    if ((bp = find_fit(heap, asize)) != NULL) {
+	if (place(heap, bp, asize) < 0)
+	    return NULL;
+	return bp;
+    }
+
+    /* No fit found. Get more memory and place the block */
+    extendsize = MAX(asize,CHUNKSIZE);
+    if ((bp = extend_heap(heap, extendsize/WSIZE)) == NULL)
+	return NULL;
+    if (place(heap, bp, asize) < 0)
+	return NULL;
+    return bp;
+}
+
 /* 
  * place - Place block of asize bytes at start of free block bp 
- *         and split if remainder would be at least minimum block size
+ *         and split if remainder would be at least minimum block size.
+ *         Returns -1 if the holes in the way can't be mapped back.
  */
 /* $begin mmplace */
 /* $begin mmplace-proto */
-static void place(void *bp, int asize)
+static int place(mm_heap_t *heap, void *bp, int asize)
 /* $end mmplace-proto */
 {
     int csize = GET_SIZE(HDRP(bp));   
+    int holes = GET_HOLES(HDRP(bp));
+    int split = (csize - asize) >= (DSIZE + OVERHEAD);
 
-    if ((csize - asize) >= (DSIZE + OVERHEAD)) { 
+    /* Map back what the new block and the remainder's header sit on. The
+     * remainder keeps whatever holes are left above that. */
+    if (holes && mem_recommit(heap->mem, HDRP(bp),
+			      split ? (char *)bp + asize : FTRP(bp)))
+	return -1;
+
+    if (split) { 
 	PUT(HDRP(bp), PACK(asize, 1));
 	PUT(FTRP(bp), PACK(asize, 1));
+	used(heap, bp);
 	bp = NEXT_BLKP(bp);
-	PUT(HDRP(bp), PACK(csize-asize, 0));
-	PUT(FTRP(bp), PACK(csize-asize, 0));
+	PUT(HDRP(bp), PACK(csize-asize, holes));
+	PUT(FTRP(bp), PACK(csize-asize, holes));
     }
     else { 
 	PUT(HDRP(bp), PACK(csize, 1));
 	PUT(FTRP(bp), PACK(csize, 1));
+	used(heap, bp);
     }
+    return 0;
 }
 /* $end mmplace */
 
@@ -239,13 +520,15 @@ static void place(void *bp, int asize)
  */
 /* $begin mmfirstfit */
 /* $begin mmfirstfit-proto */
-static void *find_fit(int asize)
+static void *find_fit(mm_heap_t *heap, int asize)
 /* $end mmfirstfit-proto */
 {
     void *bp;
 
     /* first fit search */
-    for (bp = heap_listp; GET_SIZE(HDRP(bp)) > 0; bp = NEXT_BLKP(bp)) {
+    heap->stats.searches++;
+    for (bp = heap->heap_listp; GET_SIZE(HDRP(bp)) > 0; bp = NEXT_BLKP(bp)) {
+	heap->stats.probes++;
 	if (!GET_ALLOC(HDRP(bp)) && (asize <= GET_SIZE(HDRP(bp)))) {
 	    return bp;
 	}
@@ -263,6 +546,7 @@ static void *coalesce(void *bp)
     int prev_alloc = GET_ALLOC(FTRP(PREV_BLKP(bp)));
     int next_alloc = GET_ALLOC(HDRP(NEXT_BLKP(bp)));
     int size = GET_SIZE(HDRP(bp));
+    int holes = GET_HOLES(HDRP(bp));
 
     if (prev_alloc && next_alloc) {            /* Case 1 */
 	return bp;
@@ -270,28 +554,169 @@ static void *coalesce(void *bp)
 
     else if (prev_alloc && !next_alloc) {      /* Case 2 */
 	size += GET_SIZE(HDRP(NEXT_BLKP(bp)));
-	PUT(HDRP(bp), PACK(size, 0));
-	PUT(FTRP(bp), PACK(size,0));
+	holes |= GET_HOLES(HDRP(NEXT_BLKP(bp)));
+	PUT(HDRP(bp), PACK(size, holes));
+	PUT(FTRP(bp), PACK(size, holes));
 	return(bp);
     }
 
     else if (!prev_alloc && next_alloc) {      /* Case 3 */
 	size += GET_SIZE(HDRP(PREV_BLKP(bp)));
-	PUT(FTRP(bp), PACK(size, 0));
-	PUT(HDRP(PREV_BLKP(bp)), PACK(size, 0));
+	holes |= GET_HOLES(FTRP(PREV_BLKP(bp)));
+	PUT(FTRP(bp), PACK(size, holes));
+	PUT(HDRP(PREV_BLKP(bp)), PACK(size, holes));
 	return(PREV_BLKP(bp));
     }
 
     else {                                     /* Case 4 */
 	size += GET_SIZE(HDRP(PREV_BLKP(bp))) + 
 	    GET_SIZE(FTRP(NEXT_BLKP(bp)));
-	PUT(HDRP(PREV_BLKP(bp)), PACK(size, 0));
-	PUT(FTRP(NEXT_BLKP(bp)), PACK(size, 0));
+	holes |= GET_HOLES(FTRP(PREV_BLKP(bp))) |
+	    GET_HOLES(HDRP(NEXT_BLKP(bp)));
+	PUT(HDRP(PREV_BLKP(bp)), PACK(size, holes));
+	PUT(FTRP(NEXT_BLKP(bp)), PACK(size, holes));
 	return(PREV_BLKP(bp));
     }
 }
 /* $end mmfree */
 
+/*
+ * release - Give the pages strictly inside free block bp back to the
+ *     kernel and return how many bytes that was
+ */
+static int release(mm_heap_t *heap, void *bp)
+{
+    int size = GET_SIZE(HDRP(bp));
+    int released = mem_release(heap->mem, bp, FTRP(bp));
+
+    if (released > 0) {
+	PUT(HDRP(bp), PACK(size, HOLES));
+	PUT(FTRP(bp), PACK(size, HOLES));
+    }
+    return released;
+}
+
+/*
+ * map_block - Map a block of asize bytes in a range of its own, with the
+ *     payload align bytes into it. align is at least DSIZE and at most a
+ *     page. Returns NULL if mem_map() can't have it.
+ */
+static void *map_block(int asize, int align)
+{
+    char *base = mem_map(align - DSIZE + asize);
+
+    if (base == NULL)
+	return NULL;
+    PUT(base + align - WSIZE, PACK(asize, MAPPED | 1));
+    return base + align;
+}
+
+/*
+ * resize - Make allocated block bp asize bytes large without moving it.
+ *     It grows into the free block after it, if need be after extending the
+ *     heap, and shrinks by splitting off a free block. Returns -1 if it
+ *     can't grow far enough.
+ */
+static int resize(mm_heap_t *heap, void *bp, int asize)
+{
+    int csize = GET_SIZE(HDRP(bp));
+    char *next = NEXT_BLKP(bp);
+    int holes = 0;
+    int avail;
+
+    if (asize > csize) {
+	avail = csize + (GET_ALLOC(HDRP(next)) ? 0 : GET_SIZE(HDRP(next)));
+
+	/* Nothing but free space up to the end of the heap, make more */
+	if (avail < asize &&
+	    (GET_SIZE(HDRP(next)) == 0 ||
+	     (!GET_ALLOC(HDRP(next)) && GET_SIZE(HDRP(NEXT_BLKP(next))) == 0))) {
+	    if (extend_heap(heap, MAX(asize - avail, CHUNKSIZE)/WSIZE) == NULL)
+		return -1;
+	    avail = csize + GET_SIZE(HDRP(next));
+	}
+	if (avail < asize)
+	    return -1;
+
+	/* Absorb the free block after us, mapping back what we take of it
+	 * and the header of what is left */
+	holes = GET_HOLES(HDRP(next));
+	if (holes && mem_recommit(heap->mem, HDRP(next),
+				  avail - asize >= DSIZE + OVERHEAD ?
+				  (char *)bp + asize : (char *)bp + avail - DSIZE))
+	    return -1;
+	csize = avail;
+    }
+
+    if (csize - asize >= DSIZE + OVERHEAD) {
+	PUT(HDRP(bp), PACK(asize, 1));
+	PUT(FTRP(bp), PACK(asize, 1));
+	used(heap, bp);
+	next = NEXT_BLKP(bp);
+	PUT(HDRP(next), PACK(csize-asize, holes));
+	PUT(FTRP(next), PACK(csize-asize, holes));
+
+	/* When shrinking, the block after may be free too */
+	next = coalesce(next);
+	if (trim_threshold > 0 && GET_SIZE(HDRP(next)) >= trim_threshold)
+	    release(heap, next);
+    } else {
+	PUT(HDRP(bp), PACK(csize, 1));
+	PUT(FTRP(bp), PACK(csize, 1));
+	used(heap, bp);
+    }
+    return 0;
+}
+
+/*
+ * count_alloc - Count allocated block bp as handed out
+ */
+static void count_alloc(mm_heap_t *heap, void *bp)
+{
+    int size = GET_SIZE(HDRP(bp));
+
+    heap->stats.allocs[size_class(size)]++;
+    if (!GET_MAPPED(HDRP(bp)))
+	heap->stats.live += size;
+}
+
+/*
+ * count_free - Count allocated block bp as given back
+ */
+static void count_free(mm_heap_t *heap, void *bp)
+{
+    int size = GET_SIZE(HDRP(bp));
+
+    heap->stats.frees[size_class(size)]++;
+    if (!GET_MAPPED(HDRP(bp)))
+	heap->stats.live -= size;
+}
+
+/*
+ * used - Allocated block bp has been handed out, move the watermark past it
+ */
+static void used(mm_heap_t *heap, void *bp)
+{
+    if (NEXT_BLKP(bp) > heap->fresh)
+	heap->fresh = NEXT_BLKP(bp);
+}
+
+/*
+ * zero - Clear n bytes at p a word at a time. p is word aligned.
+ */
+static void zero(void *p, unsigned int n)
+{
+    char *tail = (char *)p + (n & ~(WSIZE-1));
+    int d0, d1;
+
+    __asm__ __volatile__("rep stosl"
+			 : "=&c" (d0), "=&D" (d1)
+			 : "a" (0), "0" (n / WSIZE), "1" (p)
+			 : "memory");
+    while (tail < (char *)p + n)
+	*tail++ = 0;
+}
+
 void printblock(void *bp) 
 {
     int hsize, halloc, fsize, falloc;
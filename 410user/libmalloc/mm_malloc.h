@@ -8,12 +8,19 @@
 #ifndef _MM_MALLOC_H
 #define _MM_MALLOC_H
 
+#include <memlib.h>
+#include <malloc.h>
+
 /* $begin mallocmacros */
 /* Basic constants and macros */
 #define WSIZE       4       /* word size (bytes) */
 #define DSIZE       8       /* doubleword size (bytes) */
 #define CHUNKSIZE  (1<<12)  /* initial heap size (bytes) */
 #define OVERHEAD    8       /* overhead of header and footer (bytes) */
+#define TRIM_THRESHOLD (1<<17) /* default size of a free block whose pages
+                                  are given back to the kernel (bytes) */
+#define LARGE_SIZE (1<<14)  /* requests this large get mapped on their own
+                               instead of going into the heap (bytes) */
 
 #define MAX(x, y) ((x) > (y)? (x) : (y))
 
@@ -24,9 +31,16 @@
 #define GET(p)       (*(int *)(p))
 #define PUT(p, val)  (*(int *)(p) = (val))
 
-/* Read the size and allocated fields from address p */
-#define GET_SIZE(p)  (GET(p) & ~0x7)
-#define GET_ALLOC(p) (GET(p) & 0x1)
+/* Read the size, allocated, holes and mapped fields from address p. A free
+ * block has holes if some of the pages strictly between its header and
+ * footer were given back to the kernel. A mapped block lives in a range of
+ * its own from mem_map() and has no footer. */
+#define GET_SIZE(p)   (GET(p) & ~0x7)
+#define GET_ALLOC(p)  (GET(p) & 0x1)
+#define GET_HOLES(p)  (GET(p) & 0x2)
+#define GET_MAPPED(p) (GET(p) & 0x4)
+#define HOLES       0x2
+#define MAPPED      0x4
 
 /* Given block ptr bp, compute address of its header and footer */
 #define HDRP(bp)       ((char *)(bp) - WSIZE)
@@ -37,9 +51,28 @@
 #define PREV_BLKP(bp)  ((char *)(bp) - GET_SIZE(((char *)(bp) - DSIZE)))
 /* $end mallocmacros */
 
-int mm_init(void);
-void *mm_malloc(int size);
-void mm_free(void *bp);
-void *mm_realloc(void *ptr, int size);
+/* A heap of blocks, see mm_init() */
+typedef struct mm_heap {
+    char *heap_listp; /* Pointer to the first block */
+    mem_heap_t *mem;  /* Memory the blocks live in */
+    int map_large;    /* Non zero if large requests are mapped on their own */
+    char *fresh;      /* Everything from here up, boundary tags aside, was
+                         never handed out and is still zero from new_pages() */
+    malloc_stats_t stats; /* What happened to the heap so far, only the
+                             counters are kept up to date */
+} mm_heap_t;
+
+int mm_init(mm_heap_t *heap, mem_heap_t *mem, int map_large);
+void *mm_malloc(mm_heap_t *heap, int size);
+void *mm_calloc(mm_heap_t *heap, int size);
+void *mm_memalign(mm_heap_t *heap, int align, int size);
+void mm_free(mm_heap_t *heap, void *bp);
+void *mm_realloc(mm_heap_t *heap, void *ptr, int size);
+int mm_size(void *bp);
+void mm_set_trim_threshold(int threshold);
+int mm_trim(mm_heap_t *heap);
+void mm_checkheap(mm_heap_t *heap, int verbose);
+void mm_stats(mm_heap_t *heap, malloc_stats_t *stats);
+void mm_report(malloc_stats_t *stats);
 
 #endif /* _MM_MALLOC_H */
@@ -141,34 +141,136 @@
 #define isdigit(d) ((d) >= '0' && (d) <= '9')
 #define Ctod(c) ((c) - '0')
 
-#define MAXBUF (sizeof(long int) * 8)		 /* enough for binary */
+#define MAXBUF (sizeof(long long) * 8)		 /* enough for binary */
 
 static char digs[] = "0123456789abcdef";
 
+/*
+ * Two digits at a time take half the divisions.
+ */
+static const char digit_pairs[] =
+	"00010203040506070809"
+	"10111213141516171819"
+	"20212223242526272829"
+	"30313233343536373839"
+	"40414243444546474849"
+	"50515253545556575859"
+	"60616263646566676869"
+	"70717273747576777879"
+	"80818283848586878889"
+	"90919293949596979899";
+
+static const char blanks[] = "                                ";
+static const char zeros[] = "00000000000000000000000000000000";
+
+/*
+ * Write the digits of v in decimal, ending right before end.
+ * Returns where they begin.
+ */
+static char *
+format_dec(unsigned long v, char *end)
+{
+	register char *p = end;
+	register unsigned long r;
+
+	while (v >= 100) {
+	    r = v % 100 * 2;
+	    v /= 100;
+	    *--p = digit_pairs[r + 1];
+	    *--p = digit_pairs[r];
+	}
+	if (v >= 10) {
+	    *--p = digit_pairs[v * 2 + 1];
+	    *--p = digit_pairs[v * 2];
+	}
+	else
+	    *--p = '0' + v;
+	return p;
+}
+
+/*
+ * Write the digits of u in base, ending right before end.
+ * Returns where they begin.  Powers of two take shifts.  64 bit
+ * divisions are done in software, so decimal takes one per nine
+ * digits, and only for numbers that need more than 32 bits.
+ */
+static char *
+format_num(unsigned long long u, int base, char *end)
+{
+	register char *p = end;
+	char *q;
+	unsigned long long hi;
+
+	switch (base) {
+	    case 16:
+		do {
+		    *--p = digs[u & 0xf];
+		    u >>= 4;
+		} while (u != 0);
+		return p;
+
+	    case 8:
+		do {
+		    *--p = digs[u & 7];
+		    u >>= 3;
+		} while (u != 0);
+		return p;
+
+	    case 10:
+		while (u > 0xffffffffULL) {
+		    hi = u / 1000000000;
+		    q = p - 9;
+		    p = format_dec((unsigned long)(u - hi * 1000000000), p);
+		    while (p > q)
+			*--p = '0';
+		    u = hi;
+		}
+		return format_dec((unsigned long) u, p);
+
+	    default:
+		do {
+		    *--p = digs[u % base];
+		    u /= base;
+		} while (u != 0);
+		return p;
+	}
+}
+
+/*
+ * Output one character.
+ */
 static void
-printnum(u, base, putc, putc_arg)
-	register unsigned long	u;	/* number to print */
-	register int		base;
-	void			(*putc)();
-	char			*putc_arg;
+putch(void (*write)(char *, const char *, int), char *write_arg, char c)
 {
-	char	buf[MAXBUF];	/* build number here */
-	register char *	p = &buf[MAXBUF-1];
+	(*write)(write_arg, &c, 1);
+}
 
-	do {
-	    *p-- = digs[u % base];
-	    u /= base;
-	} while (u != 0);
+/*
+ * Output n copies of c, a blank or a zero.
+ */
+static void
+pad(void (*write)(char *, const char *, int), char *write_arg, char c, int n)
+{
+	const char *s = (c == '0') ? zeros : blanks;
+	int chunk = sizeof(blanks) - 1;
 
-	while (++p != &buf[MAXBUF])
-	    (*putc)(putc_arg, *p);
+	for (; n > 0; n -= chunk)
+	    (*write)(write_arg, s, n < chunk ? n : chunk);
 }
 
 static void
-printnum_16(u, putc, putc_arg)
-	register unsigned long	u;	/* number to print */
-	void			(*putc)();
-	char			*putc_arg;
+printnum(unsigned long long u, int base,
+	 void (*write)(char *, const char *, int), char *write_arg)
+{
+	char	buf[MAXBUF];	/* build number here */
+	char	*p = format_num(u, base, &buf[MAXBUF]);
+
+	(*write)(write_arg, p, &buf[MAXBUF] - p);
+}
+
+static void
+printnum_16(unsigned long u,
+	    void (*write)(char *, const char *, int), char *write_arg)
 {
 	char	buf[8];	/* build number here */
 	register char *	p = &buf[7];
@@ -179,19 +281,22 @@ printnum_16(u, putc, putc_arg)
 	    u >>= 4;
 	};
 
-        for(i=0;i<8;i++){ 
-	    (*putc)(putc_arg, buf[i]);
-	}
+	(*write)(write_arg, buf, 8);
 }
 
 boolean_t	_doprnt_truncates = FALSE;
 
-void _doprnt(fmt, args, radix, putc, putc_arg)
+/*
+ * Like _doprnt(), but the output goes to write() in runs of characters:
+ * plain text between conversions, strings, numbers and padding each come
+ * in one call.
+ */
+void _doprnt_write(fmt, args, radix, write, write_arg)
 	register	const char *fmt;
 	va_list		args;
 	int		radix;		/* default radix - for '%r' */
- 	void		(*putc)();	/* character output */
-	char		*putc_arg;	/* argument for putc */
+	void		(*write)(char *, const char *, int); /* output */
+	char		*write_arg;	/* argument for write */
 {
 	int		length;
 	int		prec;
@@ -205,10 +310,13 @@ void _doprnt(fmt, args, radix, putc, putc_arg)
 	int		base;
 	char		c;
 	int		longopt;
+	const char	*run;
 
 	while (*fmt != '\0') {
 	    if (*fmt != '%') {
-		(*putc)(putc_arg, *fmt++);
+		for (run = fmt; *fmt != '\0' && *fmt != '%'; fmt++)
+		    continue;
+		(*write)(write_arg, run, fmt - run);
 		continue;
 	    }
 
@@ -294,7 +402,7 @@ void _doprnt(fmt, args, radix, putc, putc_arg)
 		    u = va_arg(args, unsigned long);
 		    p = va_arg(args, char *);
 		    base = *p++;
-		    printnum(u, base, putc, putc_arg);
+		    printnum(u, base, write, write_arg);
 
 		    if (u == 0)
 			break;
@@ -308,26 +416,26 @@ void _doprnt(fmt, args, radix, putc, putc_arg)
 			     */
 			    register int j;
 			    if (any)
-				(*putc)(putc_arg, ',');
+				putch(write, write_arg, ',');
 			    else {
-				(*putc)(putc_arg, '<');
+				putch(write, write_arg, '<');
 				any = TRUE;
 			    }
 			    j = *p++;
 			    for (; (c = *p) > 32; p++)
-				(*putc)(putc_arg, c);
+				putch(write, write_arg, c);
 			    printnum((unsigned)( (u>>(j-1)) & ((2<<(i-j))-1)),
-					base, putc, putc_arg);
+					base, write, write_arg);
 			}
 			else if (u & (1<<(i-1))) {
 			    if (any)
-				(*putc)(putc_arg, ',');
+				putch(write, write_arg, ',');
 			    else {
-				(*putc)(putc_arg, '<');
+				putch(write, write_arg, '<');
 				any = TRUE;
 			    }
 			    for (; (c = *p) > 32; p++)
-				(*putc)(putc_arg, c);
+				putch(write, write_arg, c);
 			}
 			else {
 			    for (; *p > 32; p++)
@@ -335,13 +443,13 @@ void _doprnt(fmt, args, radix, putc, putc_arg)
 			}
 		    }
 		    if (any)
-			(*putc)(putc_arg, '>');
+			putch(write, write_arg, '>');
 		    break;
 		}
 
 		case 'c':
 		    c = va_arg(args, int);
-		    (*putc)(putc_arg, c);
+		    putch(write, write_arg, c);
 		    break;
 
 		case 't':
@@ -376,22 +484,22 @@ void _doprnt(fmt, args, radix, putc, putc_arg)
 		      
 		      if (length > 0 && !ladjust) {
 		        while(n < length){
-		          putc(putc_arg, ' ');
+		          putch(write, write_arg, ' ');
 		          n++;
 		        }
 		      }
-		      if(altfmt) putc(putc_arg, '[');
-		      printnum_16( tid.lh.high, putc, putc_arg);
+		      if(altfmt) putch(write, write_arg, '[');
+		      printnum_16( tid.lh.high, write, write_arg);
 		      
-		      putc(putc_arg, ':');
+		      putch(write, write_arg, ':');
 		      
-		      printnum_16( tid.lh.low, putc, putc_arg);
+		      printnum_16( tid.lh.low, write, write_arg);
 		      
-		      if(altfmt) putc(putc_arg, ']');
+		      if(altfmt) putch(write, write_arg, ']');
 		      
 		      if(length > 0 && ladjust) {
 		        while(n < length){
-		          putc(putc_arg, ' ');
+		          putch(write, write_arg, ' ');
 		          n++;
 		        }
 		      }
@@ -412,36 +520,36 @@ void _doprnt(fmt, args, radix, putc, putc_arg)
 		    
 		      if (length > 0 && !ladjust && padc == ' ') {
 			while (n + 2 < length) {
-			    (*putc)(putc_arg, ' ');
+			    putch(write, write_arg, ' ');
 			    n++;
 			}
                       }
 
-		      if(altfmt) (*putc)(putc_arg, '[');
+		      if(altfmt) putch(write, write_arg, '[');
 		      
 		      if( length > 0 && !ladjust && padc == '0') {
 		        while (n + 2 < length) {
-		          putc(putc_arg, '0');
+		          putch(write, write_arg, '0');
 		          n++;
 		        }
 		      }
 		      
-		      printnum(tid.id.task, 16, putc, putc_arg);
-                      putc(putc_arg, '.');
+		      printnum(tid.id.task, 16, write, write_arg);
+                      putch(write, write_arg, '.');
                       
                       if(length > 0 && !ladjust) {
                         while (n+m < length){
-                          putc(putc_arg, padc);
+                          putch(write, write_arg, padc);
                           n++;
                         }
                       }
-                      printnum(tid.id.lthread, 16, putc, putc_arg);
+                      printnum(tid.id.lthread, 16, write, write_arg);
                       
-                      if(altfmt) putc(putc_arg, ']');
+                      if(altfmt) putch(write, write_arg, ']');
 
 		      if (n + m < length && ladjust) {
 			while (n + m < length) {
-			    (*putc)(putc_arg, ' ');
+			    putch(write, write_arg, ' ');
 			    n++;
 			}
 		      }
@@ -453,7 +561,7 @@ void _doprnt(fmt, args, radix, putc, putc_arg)
 		case 's':
 		{
 		    register char *p;
-		    register char *p2;
+		    register int len;
 
 		    if (prec == -1)
 			prec = 0x7fffffff;	/* MAXINT */
@@ -463,36 +571,14 @@ void _doprnt(fmt, args, radix, putc, putc_arg)
 		    if (p == (char *)0)
 			p = "";
 
-		    if (length > 0 && !ladjust) {
-			n = 0;
-			p2 = p;
-
-			for (; *p != '\0' && n < prec; p++)
-			    n++;
+		    for (len = 0; len < prec && p[len] != '\0'; len++)
+			continue;
 
-			p = p2;
-
-			while (n < length) {
-			    (*putc)(putc_arg, ' ');
-			    n++;
-			}
-		    }
-
-		    n = 0;
-
-		    while (*p != '\0') {
-			if (++n > prec)
-			    break;
-
-			(*putc)(putc_arg, *p++);
-		    }
-
-		    if (n < length && ladjust) {
-			while (n < length) {
-			    (*putc)(putc_arg, ' ');
-			    n++;
-			}
-		    }
+		    if (!ladjust)
+			pad(write, write_arg, ' ', length - len);
+		    (*write)(write_arg, p, len);
+		    if (ladjust)
+			pad(write, write_arg, ' ', length - len);
 
 		    break;
 		}
@@ -524,8 +610,8 @@ void _doprnt(fmt, args, radix, putc, putc_arg)
 		     * because we want 0 to have a 0x in front, and we want
 		     * eight digits after the 0x -- not just 6.
 		     */
-		    (*putc)(putc_arg, '0');
-		    (*putc)(putc_arg, 'x');
+		    putch(write, write_arg, '0');
+		    putch(write, write_arg, 'x');
 		case 'x':
  		    truncate = _doprnt_truncates;
 		case 'X':
@@ -575,8 +661,7 @@ void _doprnt(fmt, args, radix, putc, putc_arg)
 		print_num:
 		{
 		    char	buf[MAXBUF];	/* build number here */
-		    register char *	p = &buf[MAXBUF-1];
-		    static char digits[] = "0123456789abcdef";
+		    register char *	p;
 		    char *prefix = 0;
 
 		    if (truncate) u = (long)((int)(u));
@@ -588,12 +673,9 @@ void _doprnt(fmt, args, radix, putc, putc_arg)
 			    prefix = "0x";
 		    }
 
-		    do {
-			*p-- = digits[u % base];
-			u /= base;
-		    } while (u != 0);
+		    p = format_num(u, base, &buf[MAXBUF]);
 
-		    length -= (&buf[MAXBUF-1] - p);
+		    length -= (&buf[MAXBUF] - p);
 		    if (sign_char)
 			length--;
 		    if (prefix)
@@ -601,26 +683,22 @@ void _doprnt(fmt, args, radix, putc, putc_arg)
 
 		    if (padc == ' ' && !ladjust) {
 			/* blank padding goes before prefix */
-			while (--length >= 0)
-			    (*putc)(putc_arg, ' ');
+			pad(write, write_arg, ' ', length);
+			length = 0;
 		    }
 		    if (sign_char)
-			(*putc)(putc_arg, sign_char);
+			putch(write, write_arg, sign_char);
 		    if (prefix)
-			while (*prefix)
-			    (*putc)(putc_arg, *prefix++);
+			(*write)(write_arg, prefix, strlen(prefix));
 		    if (padc == '0') {
 			/* zero padding goes after sign and prefix */
-			while (--length >= 0)
-			    (*putc)(putc_arg, '0');
+			pad(write, write_arg, '0', length);
+			length = 0;
 		    }
-		    while (++p != &buf[MAXBUF])
-			(*putc)(putc_arg, *p);
+		    (*write)(write_arg, p, &buf[MAXBUF] - p);
 
-		    if (ladjust) {
-			while (--length >= 0)
-			    (*putc)(putc_arg, ' ');
-		    }
+		    if (ladjust)
+			pad(write, write_arg, ' ', length);
 		    break;
 		}
 
@@ -629,8 +707,36 @@ void _doprnt(fmt, args, radix, putc, putc_arg)
 		    break;
 
 		default:
-		    (*putc)(putc_arg, *fmt);
+		    putch(write, write_arg, *fmt);
 	    }
 	fmt++;
 	}
 }
+
+struct putc_state {
+	void	(*putc)();	/* character output */
+	char	*putc_arg;	/* argument for putc */
+};
+
+static void
+putc_write(char *arg, const char *s, int len)
+{
+	struct putc_state *state = (struct putc_state *) arg;
+
+	while (len-- > 0)
+	    (*state->putc)(state->putc_arg, *s++);
+}
+
+void _doprnt(fmt, args, radix, putc, putc_arg)
+	register	const char *fmt;
+	va_list		args;
+	int		radix;		/* default radix - for '%r' */
+ 	void		(*putc)();	/* character output */
+	char		*putc_arg;	/* argument for putc */
+{
+	struct putc_state state;
+
+	state.putc = putc;
+	state.putc_arg = putc_arg;
+	_doprnt_write(fmt, args, radix, putc_write, (char *) &state);
+}
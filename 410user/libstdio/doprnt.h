@@ -31,4 +31,11 @@ void _doprnt(
  	void		(*putc)(),	/* character output */
 	char		*putc_arg);	/* argument for putc */
 
+void _doprnt_write(
+	register	const char *fmt,
+	va_list		args,
+	int		radix,		/* default radix - for '%r' */
+	void		(*write)(char *, const char *, int), /* output */
+	char		*write_arg);	/* argument for write */
+
 #endif /* __DOPRNT_H_INCLUDED__ */
@@ -29,39 +29,16 @@
 
 #include <stdio.h>
 #include <stdarg.h>
-#include <syscall.h>
 #include "doprnt.h"
+#include "stdout.h"
 
-/* This version of printf is implemented in terms of putchar and puts.  */
-
-#define	PRINTF_BUFMAX	128
-
-struct printf_state {
-	char buf[PRINTF_BUFMAX];
-	unsigned int index;
-};
+/* This version of printf writes into the calling thread's stdout buffer,
+   see stdout.c.  */
 
 static void
-flush(struct printf_state *state)
+printf_write(char *arg, const char *s, int len)
 {
-	print(state->index, state->buf);
-	state->index = 0;
-}
-
-static void
-printf_char(char *arg, int c)
-{
-	struct printf_state *state = (struct printf_state *) arg;
-
-	if (state->index >= PRINTF_BUFMAX) {
-		flush(state);
-	}
-
-	state->buf[state->index] = c;
-	state->index++;
-	if (c == '\n') {
-		flush(state);
-	}
+	stdout_write((stdout_buf_t *) arg, s, len);
 }
 
 /*
@@ -69,13 +46,10 @@ printf_char(char *arg, int c)
  */
 int vprintf(const char *fmt, va_list args)
 {
-	struct printf_state state;
-
-	state.index = 0;
-	_doprnt(fmt, args, 0, (void (*)())printf_char, (char *) &state);
+	stdout_buf_t *out = stdout_self();
 
-	if (state.index != 0)
-	    flush(&state);
+	_doprnt_write(fmt, args, 0, printf_write, (char *) out);
+	stdout_done(out);
 
 	/* _doprnt currently doesn't pass back error codes,
 	   so just assume nothing bad happened.  */
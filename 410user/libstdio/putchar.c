@@ -21,11 +21,15 @@
 
 /* 15-410 mods by de0u 2008-09-02 ... */
 #include <stdio.h>
-#include <syscall.h>
+#include "stdout.h"
 
+/* Goes through the thread's buffer, see stdout.c */
 int putchar(int c)
 {
-    print( 1, (char *)&c );
+    stdout_buf_t *out = stdout_self();
+
+    stdout_putc( out, c );
+    stdout_done( out );
     return c;
 }
 
@@ -5,10 +5,14 @@
 
 #include <stdio.h>
 #include <string.h>
-#include <syscall.h>
+#include "stdout.h"
 
 int puts(const char *s) {
-	print(strlen(s), (char *)s);
-	putchar('\n');
+	stdout_buf_t *out = stdout_self();
+
+	/* The string and its newline go out in one print() */
+	stdout_write(out, s, strlen(s));
+	stdout_putc(out, '\n');
+	stdout_done(out);
 	return 0;
 }
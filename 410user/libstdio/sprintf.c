@@ -35,19 +35,19 @@ struct sprintf_state {
 };
 
 static void
-savechar(char *arg, int c)
+savechars(char *arg, const char *s, int len)
 {
 	struct sprintf_state *state = (struct sprintf_state *)arg;
 	
 	if (state->max != SPRINTF_UNLIMITED)
 	{
-		if (state->len == state->max)
-			return;
+		if (len > state->max - state->len)
+			len = state->max - state->len;
 	}
 
-	state->len++;
-	*state->buf = c;
-	state->buf++;
+	state->len += len;
+	while (len-- > 0)
+		*state->buf++ = *s++;
 }
 
 int vsprintf(char *s, const char *fmt, va_list args)
@@ -57,7 +57,7 @@ int vsprintf(char *s, const char *fmt, va_list args)
 	state.len = 0;
 	state.buf = s;
 
-	_doprnt(fmt, args, 0, (void (*)()) savechar, (char *) &state);
+	_doprnt_write(fmt, args, 0, savechars, (char *) &state);
 	*(state.buf) = '\0';
 
 	return state.len;
@@ -70,7 +70,7 @@ int vsnprintf(char *s, int size, const char *fmt, va_list args)
 	state.len = 0;
 	state.buf = s;
 
-	_doprnt(fmt, args, 0, (void (*)()) savechar, (char *) &state);
+	_doprnt_write(fmt, args, 0, savechars, (char *) &state);
 	*(state.buf) = '\0';
 
 	return state.len;
@@ -26,6 +26,20 @@
 #include <stdarg.h>
 #include <types.h>
 
+/* Only stdout is there, buffered per thread, see stdout.c */
+typedef struct __stdio_file FILE;
+extern FILE *stdout;
+
+#define EOF     (-1)
+#define BUFSIZ  256
+
+/* Modes of setvbuf() */
+#define _IOFBF  0   /* Print when a buffer is full */
+#define _IOLBF  1   /* Print as lines are done */
+#define _IONBF  2   /* Print as soon as possible */
+
+int fflush(FILE *__stream);
+int setvbuf(FILE *__stream, char *__buf, int __mode, size_t __size);
 int putchar(int __c);
 int puts(const char *__str);
 int printf(const char *__format, ...)
@@ -0,0 +1,171 @@
+/**
+ * @file 410user/libstdio/stdout.c
+ * @brief Buffered standard output, behind printf(), puts() and putchar()
+ *
+ * Every thread writes into a buffer of its own, which the thread library
+ * hands out through stdout_set_hook(). Until it does, there is only the one
+ * below. Whatever goes out goes out in a single print().
+ *
+ * When it goes out depends on the mode picked with setvbuf():
+ *
+ *  _IONBF  The default. Every call prints what it wrote as it returns, so
+ *          a printf() is never torn apart, however many lines it has. The
+ *          console programs prompt and move the cursor in between lines,
+ *          and count on that.
+ *  _IOLBF  Every call prints the lines it finished, an unfinished line
+ *          waits for its newline.
+ *  _IOFBF  Buffers go out once they are full, up to the last newline.
+ *
+ * Under the last two, lines of different threads never run into each
+ * other, unless a line doesn't fit in BUFSIZ. What a thread holds goes out
+ * on fflush(), thr_exit() and exit() as well, but exit() only empties the
+ * buffer of the thread calling it. The mode is the same for all threads.
+ *
+ * @author Zhan Chen (zhanc1)
+ * @author X.D. Zhai (xingdaz)
+ */
+
+#include <stdio.h>
+#include <stdlib.h>   /* atexit() */
+#include <syscall.h>  /* print() */
+#include "stdout.h"
+
+/**
+ * @brief There is only the one stream.
+ */
+struct __stdio_file {
+  int fd;
+};
+
+static struct __stdio_file stdout_file = { 1 };
+FILE *stdout = &stdout_file;
+
+static stdout_buf_t main_buf;     /* Everybody's until there is a hook */
+static stdout_buf_t *(*hook)(void) = NULL;
+static int buf_mode = _IONBF;
+static int exit_registered = 0;
+
+/**
+ * @brief Empties the buffer of the thread calling exit().
+ */
+static void flush_at_exit(void)
+{
+  stdout_flush(stdout_self());
+}
+
+/**
+ * @brief Hands out a buffer per thread from now on. Called by thr_init(),
+ *        while there is only one thread.
+ * @param self Returns the buffer of the thread calling it.
+ */
+void stdout_set_hook(stdout_buf_t *(*self)(void))
+{
+  stdout_flush(stdout_self());
+  hook = self;
+}
+
+/**
+ * @brief Returns the buffer of the calling thread.
+ */
+stdout_buf_t *stdout_self(void)
+{
+  if (!exit_registered) {
+    exit_registered = 1;
+    atexit(flush_at_exit);
+  }
+  return hook ? hook() : &main_buf;
+}
+
+/**
+ * @brief Prints the first n characters of the buffer and keeps the rest,
+ *        which is no more than an unfinished line.
+ */
+static void emit(stdout_buf_t *out, int n)
+{
+  int i;
+
+  print(n, out->buf);
+
+  /* libx86's memmove() comes before us on the link line */
+  for (i = n; i < out->len; i++)
+    out->buf[i - n] = out->buf[i];
+  out->len -= n;
+  out->lines = 0;
+}
+
+/**
+ * @brief Prints whatever the buffer holds.
+ */
+void stdout_flush(stdout_buf_t *out)
+{
+  if (out->len > 0)
+    emit(out, out->len);
+}
+
+/**
+ * @brief Adds a character to the buffer. A full buffer goes out up to the
+ *        last newline, all of it if there is none.
+ */
+void stdout_putc(stdout_buf_t *out, int c)
+{
+  if (out->len == BUFSIZ)
+    emit(out, out->lines ? out->lines : out->len);
+  out->buf[out->len++] = c;
+  if (c == '\n')
+    out->lines = out->len;
+}
+
+/**
+ * @brief Adds len characters to the buffer, same as stdout_putc() on each.
+ */
+void stdout_write(stdout_buf_t *out, const char *s, int len)
+{
+  while (len-- > 0) {
+    if (out->len == BUFSIZ)
+      emit(out, out->lines ? out->lines : out->len);
+    if ((out->buf[out->len++] = *s++) == '\n')
+      out->lines = out->len;
+  }
+}
+
+/**
+ * @brief Ends a call that wrote into the buffer.
+ */
+void stdout_done(stdout_buf_t *out)
+{
+  if (buf_mode == _IONBF)
+    stdout_flush(out);
+  else if (buf_mode == _IOLBF && out->lines > 0)
+    emit(out, out->lines);
+}
+
+/**
+ * @brief Prints whatever the calling thread has written so far.
+ * @param stream stdout, or NULL, which means the same here.
+ * @return 0 on success, EOF if stream isn't stdout.
+ */
+int fflush(FILE *stream)
+{
+  if (stream != NULL && stream != stdout)
+    return EOF;
+  stdout_flush(stdout_self());
+  return 0;
+}
+
+/**
+ * @brief Picks when buffers go out, for all threads.
+ * @param stream stdout.
+ * @param buf NULL, the buffers belong to the threads.
+ * @param mode One of _IOFBF, _IOLBF and _IONBF.
+ * @param size Ignored, buffers are BUFSIZ.
+ * @return 0 on success, EOF on bad arguments.
+ */
+int setvbuf(FILE *stream, char *buf, int mode, size_t size)
+{
+  if (stream != stdout || buf != NULL ||
+      (mode != _IOFBF && mode != _IOLBF && mode != _IONBF))
+    return EOF;
+  stdout_flush(stdout_self());
+  buf_mode = mode;
+  return 0;
+}
@@ -0,0 +1,33 @@
+/**
+ * @file 410user/libstdio/stdout.h
+ * @brief The buffers behind stdout, see stdout.c.
+ *
+ * The thread library gives every thread one of these and hands them out
+ * through stdout_set_hook().
+ *
+ * @author Zhan Chen (zhanc1)
+ * @author X.D. Zhai (xingdaz)
+ */
+
+#ifndef _STDOUT_H_
+#define _STDOUT_H_
+
+#include <stdio.h>  /* BUFSIZ */
+
+/**
+ * @brief What a thread has written and not printed yet.
+ */
+typedef struct stdout_buf {
+  int len;                /* Characters held */
+  int lines;              /* Of those, up to the last newline */
+  char buf[BUFSIZ];
+} stdout_buf_t;
+
+void stdout_set_hook(stdout_buf_t *(*self)(void));
+stdout_buf_t *stdout_self(void);
+void stdout_putc(stdout_buf_t *out, int c);
+void stdout_write(stdout_buf_t *out, const char *s, int len);
+void stdout_done(stdout_buf_t *out);
+void stdout_flush(stdout_buf_t *out);
+
+#endif /* _STDOUT_H_ */
@@ -7,6 +7,7 @@
 						puts.o    \
 						sprintf.o \
 						sscanf.o  \
+						stdout.o  \
 
 410ULIB_STDIO_OBJS := $(410ULIB_STDIO_OBJS:%=$(410UDIR)/libstdio/%)
 
@@ -4,13 +4,33 @@
  * @author Dave Eckhardt (de0u)
  */
 
+#include <stdlib.h>
 #include <syscall.h>
 
+#define ATEXIT_MAX 32
+
 void set_status(int status);
 void vanish(void) NORETURN;
 
+static void (*handlers[ATEXIT_MAX])(void);
+static int nhandlers = 0;
+
+/*
+ * Registers fn to be called by exit(), in the reverse order of
+ * registration.  Returns 0 on success, -1 once the table is full.
+ */
+int atexit(void (*fn)(void))
+{
+	if (nhandlers == ATEXIT_MAX)
+		return -1;
+	handlers[nhandlers++] = fn;
+	return 0;
+}
+
 void exit(int status)
 {
+	while (nhandlers > 0)
+		handlers[--nhandlers]();
 	set_status(status);
 	vanish();
 }
@@ -8,6 +8,7 @@
 
 /* Apologies for the gcc-ism, but gcc gets angry w/o it */
 void exit(int status) __attribute__((__noreturn__));
+int atexit(void (*__fn)(void));
 
 /* end user-land only */
 
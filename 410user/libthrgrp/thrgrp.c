@@ -20,6 +20,18 @@
 #include <stdio.h>
 #include <simics.h>
 #include <assert.h>
+#include <slab.h>
+#include <once.h>
+
+/* one thrgrp_data_t per thread, they come and go as fast as threads do */
+static slab_t *data_slab;
+static once_t data_slab_once = ONCE_INIT;
+
+/** @brief creates the cache thrgrp_data_t come from, run through thr_once()
+ */
+static void data_slab_init(void){
+  data_slab = slab_create(sizeof(thrgrp_data_t));
+}
 
 /** 
  * @brief Initializes a thread group 
@@ -124,7 +136,10 @@ int thrgrp_create(thrgrp_group_t *tg, void *(*func)(void *),void *arg){
     this is used both to get the arguments into the other thread,
     and then as the memory to go on the zombie queue, this way we only
     malloc once */
-  data = malloc(sizeof(thrgrp_data_t));
+  thr_once(&data_slab_once, data_slab_init);
+  if(data_slab == NULL)
+    return -1;
+  data = slab_alloc(data_slab);
   if(data == NULL)
     return -1;
   data->tmp.func = func;
@@ -136,7 +151,7 @@ int thrgrp_create(thrgrp_group_t *tg, void *(*func)(void *),void *arg){
 
   /* tid<0 indicates error */
   if(tid < 0) {
-    free(data);
+    slab_free(data_slab, data);
     return tid;
   }
   
@@ -189,7 +204,7 @@ int thrgrp_join(thrgrp_group_t* eg, void **status){
   /* grab the tid out before we free it */
   tid = thr_data->tid;
   /* free the memory from the queue */
-  free(thr_data);
+  slab_free(data_slab, thr_data);
   /* join on the tid, and return the result */
   return thr_join(tid, status);
 }
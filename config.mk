@@ -96,13 +96,43 @@ UPDATE_METHOD = afs
 # directory
 #
 STUDENTTESTS = virgin life_cycle_test thread_management_test \
-							 memory_management_test console_IO_test misc_test
+							 memory_management_test console_IO_test misc_test \
+							 ebr_test bench_seqlock barrier_test once_test \
+							 thr_attr_test detach_test lazy_stack_test rwlock_handoff_test \
+							 stack_overflow_test heap_trim_test \
+							 large_alloc_test large_alloc_stack_test slab_test \
+							 arena_test realloc_test malloc_report_test \
+							 calloc_test memalign_test malloc_stats_test lockprof_test \
+							 trace_test cond_race_test rwlock_race_test fiber_test \
+							 coroutine_test stdout_test printf_test
+
+# Benchmarks, each prints a "bench: name=... threads=..." line per run, see
+# user/progs/bench.h
+BENCHMARKS = bench_mutex bench_cond_pingpong bench_rwlock_mix bench_sem \
+						 bench_create_join bench_malloc
+STUDENTTESTS += $(BENCHMARKS)
 
 ###########################################################################
 # Object files for your thread library
 ###########################################################################
 THREAD_OBJS = malloc.o panic.o mutex.o asm.o cvar.o list.o thread.o \
-							swexn_handler.o rwlock.o sem.o
+							swexn_handler.o rwlock.o sem.o ebr.o seqlock.o \
+							barrier.o latch.o once.o stack.o slab.o lockprof.o \
+							trace.o fiber.o coroutine.o
+
+# Set to 1 for a thread library that profiles lock contention, see
+# user/inc/lockprof.h. Programs don't need to be rebuilt.
+THR_PROFILE = 0
+ifeq ($(THR_PROFILE),1)
+$(STUUDIR)/libthread/%: CFLAGS += -DTHR_PROFILE
+endif
+
+# Set to 1 for a thread library that records events into per-thread rings,
+# see user/inc/trace.h. Programs don't need to be rebuilt.
+THR_TRACE = 0
+ifeq ($(THR_TRACE),1)
+$(STUUDIR)/libthread/%: CFLAGS += -DTHR_TRACE
+endif
 
 # Thread Group Library Support.
 #
@@ -0,0 +1,220 @@
+/**
+ * @file explore.c
+ * @brief Runs a program under the schedule explorer over and over, till a
+ *        schedule makes it fail.
+ *
+ * A Linux program, built with the host's own C library. See sched.c for how
+ * a schedule is picked and what the SCHED_ variables do.
+ *
+ *    explore [-s seeds] [-b bound] [-n runs] [-t secs] program [args]
+ *
+ * With -s the program runs with SCHED_SEED from 1 to seeds. With -b it is
+ * run under every schedule that strays from the default at up to bound
+ * steps: with all defaults first, then with a choice other than the default
+ * at each step that had one, and so on, each run telling where the next can
+ * stray. The number of runs grows with the steps to the power of bound, -n
+ * caps it, 10000 by default. Without either, -s 100 it is.
+ *
+ * A run passes if the program prints "<program>: success" like the tests
+ * do, and neither dies, deadlocks, runs out of steps nor takes more than -t
+ * seconds, 10 by default. The first run that doesn't is printed, with what
+ * takes it again, and explore exits with 1.
+ *
+ * @author Zhan Chen (zhanc1)
+ * @author X.D. Zhai (xingdaz)
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <sys/wait.h>
+
+static char **prog_argv;
+static char success[256];
+static int max_runs = 10000, timeout = 10, bound;
+static int runs, capped;
+
+/**
+ * @brief How a run went.
+ */
+typedef struct run {
+  char *out;                /* Everything it printed */
+  int passed;
+  int status;
+} run_t;
+
+/**
+ * @brief Runs the program with var set in its environment.
+ * @param var SCHED_SEED or SCHED_REPLAY.
+ * @param value What to set it to.
+ * @param points Whether to ask for the steps that had a choice.
+ */
+static void run(run_t *r, const char *var, const char *value, int points)
+{
+  int fds[2], len = 0, cap = 4096, n;
+  pid_t pid;
+
+  if (pipe(fds) < 0 || (pid = fork()) < 0) {
+    perror("explore");
+    exit(2);
+  }
+  if (pid == 0) {
+    dup2(fds[1], 1);
+    dup2(fds[1], 2);
+    close(fds[0]);
+    close(fds[1]);
+    unsetenv("SCHED_SEED");
+    unsetenv("SCHED_REPLAY");
+    setenv(var, value, 1);
+    setenv("SCHED_POINTS", points ? "1" : "0", 1);
+    alarm(timeout);
+    execv(prog_argv[0], prog_argv);
+    perror(prog_argv[0]);
+    _exit(127);
+  }
+  close(fds[1]);
+  r->out = malloc(cap);
+  while (r->out && (n = read(fds[0], r->out + len, cap - len - 1)) > 0) {
+    len += n;
+    if (len == cap - 1)
+      r->out = realloc(r->out, cap *= 2);
+  }
+  close(fds[0]);
+  if (!r->out) {
+    perror("explore");
+    exit(2);
+  }
+  r->out[len] = '\0';
+  waitpid(pid, &r->status, 0);
+  r->passed = strstr(r->out, success) != NULL && WIFEXITED(r->status) &&
+              !strstr(r->out, "sched: deadlock") &&
+              !strstr(r->out, "sched: no end");
+  runs++;
+}
+
+/**
+ * @brief Tells how a run that didn't pass went, and how to take it again.
+ */
+static void report(run_t *r, const char *var, const char *value)
+{
+  char **arg;
+
+  fputs(r->out, stdout);
+  if (WIFSIGNALED(r->status))
+    printf("explore: killed by signal %d%s\n", WTERMSIG(r->status),
+           WTERMSIG(r->status) == SIGALRM ? ", it took too long" : "");
+  printf("explore: failed after %d runs, to take it again:\n   %s=%s",
+         runs, var, value);
+  for (arg = prog_argv; *arg; arg++)
+    printf(" %s", *arg);
+  printf("\n");
+}
+
+/**
+ * @brief Runs the program under every schedule that strays from the
+ *        default where devs does and at up to depth more steps after.
+ * @param devs SCHED_REPLAY to start from.
+ * @param after The step of the last of devs, 0 if none.
+ * @return 1 if a run failed, 0 otherwise.
+ */
+static int explore(const char *devs, unsigned long after, int depth)
+{
+  unsigned long step, *steps = NULL;
+  int *choices = NULL, npoints = 0, i, c;
+  char *p, *next;
+  run_t r;
+
+  run(&r, "SCHED_REPLAY", devs, depth > 0);
+  if (!r.passed) {
+    report(&r, "SCHED_REPLAY", devs);
+    return 1;
+  }
+  if (depth > 0 && (p = strstr(r.out, "sched: points")) != NULL) {
+    p += strlen("sched: points");
+    steps = malloc(strlen(p) * sizeof(*steps));
+    choices = malloc(strlen(p) * sizeof(*choices));
+    while ((step = strtoul(p, &next, 10)) != 0 && *next == ':') {
+      if (step > after) {
+        steps[npoints] = step;
+        choices[npoints++] = strtol(next + 1, &next, 10);
+      } else {
+        strtol(next + 1, &next, 10);
+      }
+      p = next;
+    }
+  }
+  free(r.out);
+
+  for (i = 0; i < npoints; i++) {
+    for (c = 1; c < choices[i]; c++) {
+      if (runs >= max_runs) {
+        capped = 1;
+        break;
+      }
+      next = malloc(strlen(devs) + 32);
+      sprintf(next, "%s%s%lu=%d", devs, *devs ? "," : "", steps[i], c);
+      if (explore(next, steps[i], depth - 1)) {
+        free(next);
+        return 1;
+      }
+      free(next);
+    }
+  }
+  free(steps);
+  free(choices);
+  return 0;
+}
+
+int main(int argc, char *argv[])
+{
+  int opt, seeds = 0, seed;
+  char value[16], *name;
+  run_t r;
+
+  bound = -1;
+  while ((opt = getopt(argc, argv, "+s:b:n:t:")) != -1) {
+    switch (opt) {
+    case 's': seeds = atoi(optarg); break;
+    case 'b': bound = atoi(optarg); break;
+    case 'n': max_runs = atoi(optarg); break;
+    case 't': timeout = atoi(optarg); break;
+    default:
+      fprintf(stderr, "usage: explore [-s seeds] [-b bound] [-n runs] "
+              "[-t secs] program [args]\n");
+      return 2;
+    }
+  }
+  if (optind == argc) {
+    fprintf(stderr, "explore: which program?\n");
+    return 2;
+  }
+  prog_argv = &argv[optind];
+  name = strrchr(prog_argv[0], '/');
+  snprintf(success, sizeof(success), "%s: success",
+           name ? name + 1 : prog_argv[0]);
+  if (!seeds && bound < 0)
+    seeds = 100;
+
+  for (seed = 1; seed <= seeds; seed++) {
+    sprintf(value, "%d", seed);
+    run(&r, "SCHED_SEED", value, 0);
+    if (!r.passed) {
+      report(&r, "SCHED_SEED", value);
+      return 1;
+    }
+    free(r.out);
+  }
+  if (bound >= 0 && explore("", 0, bound))
+    return 1;
+
+  printf("explore: %s passed %d runs", prog_argv[0], runs);
+  if (seeds)
+    printf(", seeds 1 to %d", seeds);
+  if (bound >= 0)
+    printf(", %sstraying at up to %d steps", capped ? "capped, " : "",
+           bound);
+  printf("\n");
+  return 0;
+}
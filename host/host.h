@@ -0,0 +1,63 @@
+/**
+ * @file host.h
+ * @brief What pebbles.c, sched.c and linux.S share: Linux system calls and
+ *        the hooks of the schedule explorer.
+ *
+ * @author Zhan Chen (zhanc1)
+ * @author X.D. Zhai (xingdaz)
+ */
+
+#ifndef _HOST_H_
+#define _HOST_H_
+
+#include <ureg.h>
+#include <syscall.h>
+
+/* Linux system call numbers on i386 */
+#define SYS_exit            1
+#define SYS_read            3
+#define SYS_write           4
+#define SYS_getpid          20
+#define SYS_munmap          91
+#define SYS_sched_yield     158
+#define SYS_nanosleep       162
+#define SYS_rt_sigreturn    173
+#define SYS_rt_sigaction    174
+#define SYS_sigaltstack     186
+#define SYS_mmap2           192
+#define SYS_gettid          224
+#define SYS_futex           240
+#define SYS_exit_group      252
+#define SYS_clock_gettime   265
+#define SYS_tgkill          270
+
+#define FUTEX_WAIT          0
+#define FUTEX_WAKE          1
+#define FUTEX_WAIT_PRIVATE  128
+#define FUTEX_WAKE_PRIVATE  129
+
+int linux_syscall(int nr, ...);
+void host_ureg_restore(ureg_t *ureg) NORETURN;
+
+static inline int xchg_int(int *p, int v)
+{
+  __asm__ __volatile__("xchgl %0,%1" : "+r" (v), "+m" (*p) : : "memory");
+  return v;
+}
+
+/* The schedule explorer, see sched.c, stands in for the scheduler when on */
+extern int sched_on;
+
+void sched_init(char **envp);
+int sched_gettid(void);
+int sched_yield(int tid);
+int sched_deschedule(int *reject);
+int sched_make_runnable(int tid);
+unsigned int sched_ticks(void);
+int *sched_fork_prepare(void);
+int sched_forked(int tid);
+void sched_started(int *alive);
+void sched_vanish(void);
+void sched_exit(void);
+
+#endif /* _HOST_H_ */
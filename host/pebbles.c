@@ -0,0 +1,601 @@
+/**
+ * @file pebbles.c
+ * @brief The Pebbles system calls on top of i386 Linux.
+ *
+ * Stands in for user/libsyscall when the thread library runs as a Linux
+ * program, see the Makefile. The library can't tell the difference, except
+ * in what follows:
+ *
+ * - thread_fork() is clone() and every thread is a Linux thread, so they
+ *   run on all the cores at once.
+ * - deschedule() sleeps on a futex of the thread's own, make_runnable()
+ *   wakes it. A table maps tids to their state, under a spin lock.
+ * - yield(tid) can't make tid run, it only checks it exists and yields.
+ * - new_pages() and remove_pages() are mmap() and munmap() at the address
+ *   asked for, never over something that is there already.
+ * - swexn() handlers are run by the handlers of SIGSEGV and friends, on an
+ *   alternate signal stack of each thread. The registration is kept at the
+ *   bottom of that stack, where neither needs the lock: a fault may come
+ *   while the thread holds it, say one growing its stack.
+ * - get_ticks() counts milliseconds, sleep() takes them.
+ * - fork(), exec() and wait() fail, the console calls do nothing, and
+ *   lprintf() prints to stderr.
+ *
+ * With SCHED_SEED or SCHED_REPLAY in the environment the scheduling calls go
+ * to the schedule explorer in sched.c instead, see there.
+ *
+ * @author Zhan Chen (zhanc1)
+ * @author X.D. Zhai (xingdaz)
+ */
+
+#include <syscall.h>
+#include <ureg.h>
+#include <stddef.h>
+#include <stdarg.h>
+#include <simics.h>
+
+#include "host.h"
+
+#define CLOCK_MONOTONIC     1
+
+#define PROT_RWX            7
+#define PROT_RW             3
+#define MAP_PRIVATE_ANON    0x22
+#define MAP_FIXED_NOREPLACE 0x100000
+
+#define SA_SIGINFO          0x4
+#define SA_ONSTACK          0x08000000
+#define SA_RESTORER         0x04000000
+#define SA_NODEFER          0x40000000
+#define SS_DISABLE          2
+
+#define MAX_THREADS         8192  /* Threads alive at once, at most */
+#define MAX_REGIONS         262144 /* new_pages() regions at once, at most */
+#define ALT_STACK_SIZE      (4 * PAGE_SIZE)
+#define LOCK_STACK          512   /* Deeper than anything under the lock */
+
+#define RUNNING             0
+#define DESCHEDULED         1
+
+#define GONE                (-1)  /* tid of a slot that was let go */
+
+/**
+ * @brief What is known about a thread.
+ */
+typedef struct host_thr {
+  int tid;                  /* 0 for a free slot, GONE for one let go */
+  int state;                /* RUNNING or DESCHEDULED */
+  int wake;                 /* Futex make_runnable() wakes it up on */
+  void *alt_stack;          /* Signal stack, taken on the first swexn() */
+} host_thr_t;
+
+/**
+ * @brief A thread's swexn() handler, at the bottom of its signal stack.
+ */
+typedef struct host_swexn {
+  void *esp3;               /* Handler, if eip isn't NULL */
+  swexn_handler_t eip;
+  void *arg;
+} host_swexn_t;
+
+static host_thr_t threads[MAX_THREADS];
+static int used;            /* Slots that aren't free */
+static int lock_word;
+static int task_status;
+
+/**
+ * @brief A region handed out by new_pages().
+ */
+static struct {
+  void *base;
+  int len;
+} regions[MAX_REGIONS];
+static int free_region;     /* No free slot below it */
+static int top_region;      /* No region at or above it */
+
+/**
+ * @brief Takes the lock around the thread and region tables.
+ *
+ * A lazily grown stack may fault on any call, and the handler needs
+ * new_pages(). So the stack the lock is held on is touched first, while a
+ * fault there can still take the lock.
+ */
+static void lock(void)
+{
+  char below[LOCK_STACK];
+
+  *(volatile char *) below = 0;
+  while (xchg_int(&lock_word, 1))
+    linux_syscall(SYS_sched_yield);
+}
+
+static void unlock(void)
+{
+  xchg_int(&lock_word, 0);
+}
+
+/**
+ * @brief Lets go of the slots of threads that are gone, and rehashes the
+ *        rest so that lookups don't have to wade through the dead.
+ *
+ * Threads leave by thread_vanish(), which can't touch memory, so nobody
+ * tells us. The table is cleaned up once it fills instead. The lock is held.
+ */
+static void reap_threads(void)
+{
+  static host_thr_t live[MAX_THREADS];
+  unsigned int i, j, h;
+  int pid = linux_syscall(SYS_getpid), n = 0;
+
+  for (i = 0; i < MAX_THREADS; i++) {
+    if (threads[i].tid <= 0)
+      continue;
+    if (linux_syscall(SYS_tgkill, pid, threads[i].tid, 0) < 0) {
+      if (threads[i].alt_stack)
+        linux_syscall(SYS_munmap, threads[i].alt_stack, ALT_STACK_SIZE);
+    } else {
+      live[n++] = threads[i];
+    }
+  }
+  for (i = 0; i < MAX_THREADS; i++)
+    threads[i].tid = 0;
+  for (j = 0; j < n; j++) {
+    h = (unsigned int) live[j].tid * 2654435761u;
+    for (i = 0; threads[(h + i) % MAX_THREADS].tid != 0; i++)
+      continue;
+    threads[(h + i) % MAX_THREADS] = live[j];
+  }
+  used = n;
+}
+
+/**
+ * @brief Finds the slot of a thread, the lock held.
+ * @param tid Thread to look for.
+ * @param create Whether to make it a slot if it has none.
+ * @return The slot, NULL if there is none.
+ */
+static host_thr_t *find_thread(int tid, int create)
+{
+  unsigned int i, h = (unsigned int) tid * 2654435761u;
+  host_thr_t *t;
+
+  for (i = 0; i < MAX_THREADS; i++) {
+    t = &threads[(h + i) % MAX_THREADS];
+    if (t->tid == tid)
+      return t;
+    if (t->tid == 0)
+      break;
+  }
+  if (!create)
+    return NULL;
+  if (used >= MAX_THREADS / 4 * 3) {
+    reap_threads();
+    if (used >= MAX_THREADS / 4 * 3)
+      return NULL;
+  }
+  for (i = 0; threads[(h + i) % MAX_THREADS].tid != 0; i++)
+    continue;
+  t = &threads[(h + i) % MAX_THREADS];
+  t->tid = tid;
+  t->state = RUNNING;
+  t->alt_stack = NULL;
+  used++;
+  return t;
+}
+
+/**
+ * @brief The Linux tid of the calling thread, which is what gettid() says
+ *        unless the schedule explorer is on.
+ */
+static int host_tid(void)
+{
+  return linux_syscall(SYS_gettid);
+}
+
+int gettid(void)
+{
+  if (sched_on)
+    return sched_gettid();
+  return host_tid();
+}
+
+int yield(int tid)
+{
+  host_thr_t *t;
+  int ret = 0;
+
+  if (sched_on)
+    return sched_yield(tid);
+  if (tid != -1) {
+    if (linux_syscall(SYS_tgkill, linux_syscall(SYS_getpid), tid, 0) < 0)
+      return -1;
+    lock();
+    if ((t = find_thread(tid, 0)) != NULL && t->state == DESCHEDULED)
+      ret = -1;
+    unlock();
+    if (ret < 0)
+      return ret;
+  }
+  linux_syscall(SYS_sched_yield);
+  return 0;
+}
+
+int deschedule(int *reject)
+{
+  host_thr_t *t;
+
+  if (sched_on)
+    return sched_deschedule(reject);
+  lock();
+  if (*(volatile int *) reject) {
+    unlock();
+    return 0;
+  }
+  if ((t = find_thread(host_tid(), 1)) == NULL) {
+    unlock();
+    return -1;
+  }
+  t->state = DESCHEDULED;
+  t->wake = 0;
+  unlock();
+  while (!*(volatile int *) &t->wake)
+    linux_syscall(SYS_futex, &t->wake, FUTEX_WAIT_PRIVATE, 0, NULL);
+  return 0;
+}
+
+int make_runnable(int tid)
+{
+  host_thr_t *t;
+
+  if (sched_on)
+    return sched_make_runnable(tid);
+  lock();
+  if ((t = find_thread(tid, 0)) == NULL || t->state != DESCHEDULED) {
+    unlock();
+    return -1;
+  }
+  t->state = RUNNING;
+  xchg_int(&t->wake, 1);
+  linux_syscall(SYS_futex, &t->wake, FUTEX_WAKE_PRIVATE, 1);
+  unlock();
+  return 0;
+}
+
+unsigned int get_ticks(void)
+{
+  int ts[2];
+
+  if (sched_on)
+    return sched_ticks();
+  linux_syscall(SYS_clock_gettime, CLOCK_MONOTONIC, ts);
+  return (unsigned int) ts[0] * 1000u + ts[1] / 1000000;
+}
+
+int sleep(int ticks)
+{
+  int ts[2];
+
+  if (ticks < 0)
+    return -1;
+  if (sched_on) {
+    sched_yield(-1);            /* Time only passes in steps */
+    return 0;
+  }
+  ts[0] = ticks / 1000;
+  ts[1] = (ticks % 1000) * 1000000;
+  linux_syscall(SYS_nanosleep, ts, NULL);
+  return 0;
+}
+
+int new_pages(void *addr, int len)
+{
+  int i, ret;
+
+  if (((unsigned int) addr & (PAGE_SIZE - 1)) || len <= 0 ||
+      (len & (PAGE_SIZE - 1)))
+    return -1;
+  ret = linux_syscall(SYS_mmap2, addr, len, PROT_RWX,
+                      MAP_PRIVATE_ANON | MAP_FIXED_NOREPLACE, -1, 0);
+  if ((unsigned int) ret != (unsigned int) addr) {
+    /* Older kernels take the address as a hint only */
+    if ((unsigned int) ret < 0xfffff000u)
+      linux_syscall(SYS_munmap, ret, len);
+    return -1;
+  }
+  lock();
+  for (i = free_region; i < MAX_REGIONS && regions[i].base; i++)
+    continue;
+  if (i < MAX_REGIONS) {
+    regions[i].base = addr;
+    regions[i].len = len;
+    free_region = i + 1;
+    if (i >= top_region)
+      top_region = i + 1;
+  }
+  unlock();
+  if (i == MAX_REGIONS) {
+    linux_syscall(SYS_munmap, addr, len);
+    return -2;
+  }
+  return 0;
+}
+
+int remove_pages(void *addr)
+{
+  int i, len = 0;
+
+  lock();
+  for (i = 0; i < top_region; i++) {
+    if (regions[i].base == addr) {
+      len = regions[i].len;
+      regions[i].base = NULL;
+      if (i < free_region)
+        free_region = i;
+      break;
+    }
+  }
+  unlock();
+  if (!len)
+    return -1;
+  linux_syscall(SYS_munmap, addr, len);
+  return 0;
+}
+
+void set_status(int status)
+{
+  task_status = status;
+}
+
+void vanish(void)
+{
+  if (sched_on)
+    sched_vanish();
+  for (;;)
+    linux_syscall(SYS_exit, task_status);
+}
+
+void task_vanish(int status)
+{
+  if (sched_on)
+    sched_exit();
+  for (;;)
+    linux_syscall(SYS_exit_group, status);
+}
+
+void halt(void)
+{
+  task_vanish(0);
+}
+
+int print(int size, char *buf)
+{
+  return linux_syscall(SYS_write, 1, buf, size) < 0 ? -1 : 0;
+}
+
+char getchar(void)
+{
+  char c = 0;
+
+  linux_syscall(SYS_read, 0, &c, 1);
+  return c;
+}
+
+int readline(int size, char *buf)
+{
+  int n = 0;
+
+  while (n < size && linux_syscall(SYS_read, 0, buf + n, 1) == 1) {
+    if (buf[n++] == '\n')
+      break;
+  }
+  return n;
+}
+
+int fork(void)
+{
+  return -1;
+}
+
+int exec(char *execname, char *argvec[])
+{
+  return -1;
+}
+
+int wait(int *status_ptr)
+{
+  return -1;
+}
+
+int set_term_color(int color)
+{
+  return 0;
+}
+
+int set_cursor_pos(int row, int col)
+{
+  return 0;
+}
+
+int get_cursor_pos(int *row, int *col)
+{
+  *row = *col = 0;
+  return 0;
+}
+
+int readfile(char *filename, char *buf, int count, int offset)
+{
+  return -1;
+}
+
+void misbehave(int mode)
+{
+}
+
+/**
+ * @brief Registers of a Linux signal frame.
+ */
+typedef struct host_mcontext {
+  unsigned int gs, fs, es, ds, edi, esi, ebp, esp, ebx, edx, ecx, eax;
+  unsigned int trapno, err, eip, cs, efl, uesp, ss;
+  void *fpregs;
+  unsigned int oldmask, cr2;
+} host_mcontext_t;
+
+typedef struct host_ucontext {
+  unsigned int flags;
+  void *link;
+  void *ss_sp;
+  int ss_flags;
+  unsigned int ss_size;
+  host_mcontext_t mc;
+} host_ucontext_t;
+
+typedef struct host_sigaction {
+  void *handler;
+  unsigned int flags;
+  void *restorer;
+  unsigned int mask[2];
+} host_sigaction_t;
+
+/* Where a signal handler returns to */
+void host_sigreturn(void);
+__asm__(".globl host_sigreturn\n"
+        "host_sigreturn:\n"
+        "  movl $173,%eax\n"            /* SYS_rt_sigreturn */
+        "  int $0x80\n");
+
+/**
+ * @brief Turns a fault into a call of the thread's swexn() handler.
+ *
+ * The handler is deregistered and gets a ureg_t on its exception stack,
+ * just like under Pebbles. Returning from the signal goes straight to it.
+ * Threads without a handler take the task down with them.
+ */
+static void host_fault(int sig, void *info, host_ucontext_t *uc)
+{
+  host_mcontext_t *mc = &uc->mc;
+  host_swexn_t *reg = (host_swexn_t *) uc->ss_sp;
+  swexn_handler_t eip = NULL;
+  void *esp3 = NULL, *arg = NULL;
+  unsigned int *sp;
+  ureg_t *ureg;
+
+  /* Only threads that called swexn() have a signal stack */
+  if (!(uc->ss_flags & SS_DISABLE) && reg && reg->eip) {
+    esp3 = reg->esp3;
+    arg = reg->arg;
+    eip = reg->eip;
+    reg->eip = NULL;
+  }
+
+  if (!eip) {
+    lprintf("host: thread %d killed by signal %d at %p, address %p",
+            gettid(), sig, (void *) mc->eip, (void *) mc->cr2);
+    if (sched_on)
+      sched_exit();
+    for (;;)
+      linux_syscall(SYS_exit_group, -2);
+  }
+
+  ureg = (ureg_t *) ((char *) esp3 - sizeof(ureg_t));
+  ureg->cause = mc->trapno;
+  ureg->cr2 = mc->trapno == SWEXN_CAUSE_PAGEFAULT ? mc->cr2 : 0;
+  ureg->ds = mc->ds;
+  ureg->es = mc->es;
+  ureg->fs = mc->fs;
+  ureg->gs = mc->gs;
+  ureg->edi = mc->edi;
+  ureg->esi = mc->esi;
+  ureg->ebp = mc->ebp;
+  ureg->zero = 0;
+  ureg->ebx = mc->ebx;
+  ureg->edx = mc->edx;
+  ureg->ecx = mc->ecx;
+  ureg->eax = mc->eax;
+  ureg->error_code = mc->err;
+  ureg->eip = mc->eip;
+  ureg->cs = mc->cs;
+  ureg->eflags = mc->efl;
+  ureg->esp = mc->esp;
+  ureg->ss = mc->ss;
+
+  sp = (unsigned int *) ureg;
+  *--sp = (unsigned int) ureg;
+  *--sp = (unsigned int) arg;
+  *--sp = 0;                    /* Return address, handlers don't return */
+  mc->esp = (unsigned int) sp;
+  mc->eip = (unsigned int) eip;
+}
+
+int swexn(void *esp3, swexn_handler_t eip, void *arg, ureg_t *newureg)
+{
+  static const int sigs[] = { 4, 5, 7, 8, 11 };  /* ILL TRAP BUS FPE SEGV */
+  static int installed = 0;
+  host_sigaction_t sa;
+  host_swexn_t *reg;
+  host_thr_t *t;
+  int i, ss[3];
+
+  if (!installed) {
+    sa.handler = host_fault;
+    sa.flags = SA_SIGINFO | SA_ONSTACK | SA_RESTORER | SA_NODEFER;
+    sa.restorer = host_sigreturn;
+    sa.mask[0] = sa.mask[1] = 0;
+    for (i = 0; i < sizeof(sigs) / sizeof(sigs[0]); i++)
+      linux_syscall(SYS_rt_sigaction, sigs[i], &sa, NULL, 8);
+    installed = 1;
+  }
+
+  /* Handlers call us again from wherever the fault left the thread, so
+   * the lock is only for the first time around */
+  linux_syscall(SYS_sigaltstack, NULL, ss);
+  if (ss[1] & SS_DISABLE) {
+    lock();
+    if ((t = find_thread(host_tid(), 1)) == NULL) {
+      unlock();
+      return -1;
+    }
+    if (!t->alt_stack)
+      t->alt_stack = (void *) linux_syscall(SYS_mmap2, NULL, ALT_STACK_SIZE,
+                                            PROT_RW, MAP_PRIVATE_ANON, -1, 0);
+    ss[0] = (int) t->alt_stack;
+    ss[1] = 0;
+    ss[2] = ALT_STACK_SIZE;
+    linux_syscall(SYS_sigaltstack, ss, NULL);
+    unlock();
+  }
+
+  /* A fault in between finds no handler rather than half of one */
+  reg = (host_swexn_t *) ss[0];
+  reg->eip = NULL;
+  if (esp3 && eip) {
+    reg->esp3 = esp3;
+    reg->arg = arg;
+    *(swexn_handler_t volatile *) &reg->eip = eip;
+  }
+  if (newureg)
+    host_ureg_restore(newureg);
+  return 0;
+}
+
+/**
+ * @brief Takes the place of the Simics magic instruction, of which only
+ *        printing is of any use here.
+ */
+int sim_call(int ebx, ...)
+{
+  const char *s;
+  va_list ap;
+  int n = 0;
+
+  if (ebx == SIM_PUTS) {
+    va_start(ap, ebx);
+    s = va_arg(ap, const char *);
+    va_end(ap);
+    while (s[n])
+      n++;
+    linux_syscall(SYS_write, 2, s, n);
+    linux_syscall(SYS_write, 2, "\n", 1);
+  }
+  return 0;
+}
@@ -0,0 +1,444 @@
+/**
+ * @file sched.c
+ * @brief Schedule explorer: runs the threads of a program one at a time, in
+ *        an order that can be picked, varied and replayed.
+ *
+ * Races in the thread library, say between cond_wait() letting go of the
+ * mutex and deschedule(), only show when the threads run in just the wrong
+ * order. With the explorer on, one thread runs at a time and the others
+ * wait on a futex of their own. The running thread only lets another one
+ * run in a system call that schedules, which is called a step:
+ *
+ * - yield(), sleep() and vanish(),
+ * - deschedule() and make_runnable() on the way in, as if a timer interrupt
+ *   struck right before the trap, and again on the way out,
+ * - thread_fork() in the invoking thread.
+ *
+ * At every step the explorer picks the thread to go on with among the
+ * runnable ones. They are lined up from the default on, which is the
+ * running thread itself, unless it yields, sleeps or can't run anymore, in
+ * which case it is the next runnable thread by tid, round robin. A choice
+ * is the place of the pick in that line, 0 for the default. The choices
+ * taken decide the whole run, nothing is left to timing: gettid() counts
+ * threads from 1 in the order they are created, and get_ticks() counts
+ * steps.
+ *
+ *    SCHED_SEED=<n>             picks at random, seeded with n
+ *    SCHED_REPLAY=<s>=<c>,...   takes choice c at step s and the default
+ *                               everywhere else, SCHED_REPLAY= is all
+ *                               defaults
+ *    SCHED_STEPS=<n>            gives up after n steps, 100000 by default
+ *    SCHED_POINTS=1             also lists the steps that had a choice
+ *
+ * At the end the explorer prints the number of steps and the SCHED_REPLAY
+ * that takes the same run again, random or not. If every thread left is
+ * descheduled it reports a deadlock, if the steps don't come to an end it
+ * gives up, and the task exits with an error either way. explore.c runs a
+ * program over and over under different schedules.
+ *
+ * A thread that waits by spinning without a system call in the loop keeps
+ * the others from ever running. A yield() to a thread that can't run is a
+ * step where the others get their turn, as a timer interrupt would give it
+ * to them sooner or later.
+ *
+ * @author Zhan Chen (zhanc1)
+ * @author X.D. Zhai (xingdaz)
+ */
+
+#include <syscall.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "host.h"
+
+#define SCHED_THREADS   4096      /* Threads a run can create, at most */
+#define SCHED_MAX_STEPS (1 << 20) /* Steps a run can take, at most */
+#define SCHED_DEVS      65536     /* Choices other than the default kept */
+#define DEFAULT_STEPS   100000
+
+#define RUNNABLE        0
+#define BLOCKED         1
+#define EXITED          2
+
+#define EXIT_DEADLOCK   (-3)
+#define EXIT_NO_END     (-4)
+
+/**
+ * @brief What the explorer knows about a thread.
+ */
+typedef struct sched_thr {
+  int alive;                /* Linux clears it once the thread is gone, has
+                               to come first, see sched_fork_prepare() */
+  int go;                   /* Set when it is the thread's turn */
+  int state;                /* RUNNABLE, BLOCKED or EXITED */
+} sched_thr_t;
+
+int sched_on;
+
+static sched_thr_t thr[SCHED_THREADS];  /* By tid - 1 */
+static int nthr;            /* Threads created so far */
+static int live;            /* Those of them that haven't vanished */
+static int current;         /* The running thread */
+static sched_thr_t *exiting;  /* Vanished, but may still be on its stack */
+static int line[SCHED_THREADS];
+
+static unsigned int step, max_steps = DEFAULT_STEPS;
+static unsigned int rng;
+static int by_seed;         /* SCHED_SEED rather than SCHED_REPLAY */
+static int points;          /* SCHED_POINTS */
+static unsigned char runnable[SCHED_MAX_STEPS];  /* At each step */
+
+/**
+ * @brief A choice other than the default, to take or that was taken.
+ */
+static struct {
+  unsigned int step;
+  unsigned int choice;
+} devs[SCHED_DEVS];
+static int ndevs;           /* From SCHED_REPLAY */
+static int next_dev;        /* The next of them to take */
+static int taken;           /* Kept so far, over the ones already taken */
+static int lost;            /* More were taken than could be kept */
+
+static char out_buf[256];
+static int out_len;
+
+static void out_flush(void)
+{
+  if (out_len)
+    linux_syscall(SYS_write, 2, out_buf, out_len);
+  out_len = 0;
+}
+
+static void out_str(const char *s)
+{
+  while (*s) {
+    if (out_len == sizeof(out_buf))
+      out_flush();
+    out_buf[out_len++] = *s++;
+  }
+}
+
+static void out_int(unsigned int n)
+{
+  char digits[12];
+  int i = sizeof(digits) - 1;
+
+  digits[i] = '\0';
+  do {
+    digits[--i] = '0' + n % 10;
+    n /= 10;
+  } while (n);
+  out_str(&digits[i]);
+}
+
+/**
+ * @brief Prints how the run went and how to take it again.
+ */
+static void report(void)
+{
+  unsigned int s;
+  int i;
+
+  out_str("sched: ");
+  out_int(step);
+  out_str(" steps, ");
+  out_int(nthr);
+  out_str(" threads, ");
+  if (lost) {
+    out_str("too many choices to replay");
+  } else {
+    out_str("SCHED_REPLAY=");
+    for (i = 0; i < taken; i++) {
+      if (i)
+        out_str(",");
+      out_int(devs[i].step);
+      out_str("=");
+      out_int(devs[i].choice);
+    }
+  }
+  out_str("\n");
+  if (points) {
+    out_str("sched: points");
+    for (s = 1; s <= step && s < SCHED_MAX_STEPS; s++) {
+      if (runnable[s] > 1) {
+        out_str(" ");
+        out_int(s);
+        out_str(":");
+        out_int(runnable[s]);
+      }
+    }
+    out_str("\n");
+  }
+  out_flush();
+}
+
+/**
+ * @brief Ends the run, with why first.
+ */
+static void give_up(const char *why, int status)
+{
+  int i;
+
+  out_str("sched: ");
+  out_str(why);
+  if (status == EXIT_DEADLOCK) {
+    out_str(", descheduled:");
+    for (i = 0; i < nthr; i++) {
+      if (thr[i].state == BLOCKED) {
+        out_str(" ");
+        out_int(i + 1);
+      }
+    }
+  }
+  out_str("\n");
+  report();
+  for (;;)
+    linux_syscall(SYS_exit_group, status);
+}
+
+void sched_init(char **envp)
+{
+  char *s, *end;
+  int replay = 0;
+
+  for (; *envp; envp++) {
+    s = *envp;
+    if (!strncmp(s, "SCHED_SEED=", 11)) {
+      rng = strtoul(s + 11, NULL, 10) * 2654435761u ^ 0x9e3779b9u;
+      by_seed = sched_on = 1;
+    } else if (!strncmp(s, "SCHED_REPLAY=", 13)) {
+      for (s += 13; *s && ndevs < SCHED_DEVS; s = end + 1) {
+        devs[ndevs].step = strtoul(s, &end, 10);
+        if (*end != '=')
+          break;
+        devs[ndevs++].choice = strtoul(end + 1, &end, 10);
+        if (*end != ',')
+          break;
+      }
+      replay = sched_on = 1;
+    } else if (!strncmp(s, "SCHED_STEPS=", 12)) {
+      max_steps = strtoul(s + 12, NULL, 10);
+    } else if (!strncmp(s, "SCHED_POINTS=", 13)) {
+      points = atoi(s + 13);
+    }
+  }
+  if (replay)
+    by_seed = 0;
+  if (max_steps >= SCHED_MAX_STEPS)
+    max_steps = SCHED_MAX_STEPS - 1;
+  if (!rng)
+    rng = 1;
+
+  thr[0].state = RUNNABLE;
+  nthr = live = 1;
+  current = 0;
+}
+
+/**
+ * @brief Takes a step, picking the thread to go on with.
+ * @param stay Whether the running thread is the default, if it can run.
+ * @return The thread picked.
+ */
+static int pick(int stay)
+{
+  unsigned int c = 0;
+  int i, t, n = 0;
+
+  for (i = 0; i < nthr; i++) {
+    t = (current + !stay + i) % nthr;
+    if (thr[t].state == RUNNABLE)
+      line[n++] = t;
+  }
+  if (n == 0)
+    give_up("deadlock", EXIT_DEADLOCK);
+  if (++step > max_steps)
+    give_up("no end in sight", EXIT_NO_END);
+  runnable[step] = n > 255 ? 255 : n;
+
+  if (by_seed) {
+    rng ^= rng << 13;
+    rng ^= rng >> 17;
+    rng ^= rng << 5;
+    c = rng % n;
+  } else {
+    while (next_dev < ndevs && devs[next_dev].step < step)
+      next_dev++;
+    if (next_dev < ndevs && devs[next_dev].step == step)
+      c = devs[next_dev++].choice % n;
+  }
+  if (c) {
+    /* In a replay taken never catches up with next_dev */
+    if (taken < SCHED_DEVS) {
+      devs[taken].step = step;
+      devs[taken++].choice = c;
+    } else {
+      lost = 1;
+    }
+  }
+  return line[c];
+}
+
+/**
+ * @brief Waits for the turn of thread me.
+ */
+static void wait_turn(sched_thr_t *me)
+{
+  int alive;
+
+  while (!*(volatile int *) &me->go)
+    linux_syscall(SYS_futex, &me->go, FUTEX_WAIT_PRIVATE, 0, NULL);
+  me->go = 0;
+
+  /* The stack of a thread that vanished may be reused as soon as we go on,
+   * so it has to be off it for good */
+  if (exiting) {
+    while ((alive = *(volatile int *) &exiting->alive) != 0)
+      linux_syscall(SYS_futex, &exiting->alive, FUTEX_WAIT, alive, NULL);
+    exiting = NULL;
+  }
+}
+
+/**
+ * @brief Lets thread next run instead of the running one.
+ */
+static void hand_over(int next)
+{
+  current = next;
+  xchg_int(&thr[next].go, 1);
+  linux_syscall(SYS_futex, &thr[next].go, FUTEX_WAKE_PRIVATE, 1);
+}
+
+/**
+ * @brief Takes a step and goes on with the thread picked, returning once it
+ *        is the running thread's turn again.
+ */
+static void reschedule(int stay)
+{
+  sched_thr_t *me = &thr[current];
+  int next = pick(stay);
+
+  if (next != current) {
+    hand_over(next);
+    wait_turn(me);
+  }
+}
+
+int sched_gettid(void)
+{
+  return current + 1;
+}
+
+int sched_yield(int tid)
+{
+  sched_thr_t *me = &thr[current];
+  int t = tid - 1;
+
+  if (tid == -1) {
+    reschedule(0);
+    return 0;
+  }
+  if (t < 0 || t >= nthr || thr[t].state != RUNNABLE) {
+    reschedule(0);
+    return -1;
+  }
+  if (t != current) {
+    hand_over(t);
+    wait_turn(me);
+  }
+  return 0;
+}
+
+int sched_deschedule(int *reject)
+{
+  reschedule(1);
+  if (*reject)
+    return 0;
+  thr[current].state = BLOCKED;
+  reschedule(0);
+  return 0;
+}
+
+int sched_make_runnable(int tid)
+{
+  int t = tid - 1, ret = -1;
+
+  reschedule(1);
+  if (t >= 0 && t < nthr && thr[t].state == BLOCKED) {
+    thr[t].state = RUNNABLE;
+    ret = 0;
+  }
+  reschedule(1);
+  return ret;
+}
+
+unsigned int sched_ticks(void)
+{
+  return step;
+}
+
+/**
+ * @brief Gets a thread ready before linux.S clones it.
+ * @return Where Linux is to clear once the thread is gone, NULL if the
+ *         explorer is off.
+ */
+int *sched_fork_prepare(void)
+{
+  if (!sched_on)
+    return NULL;
+  if (nthr == SCHED_THREADS)
+    give_up("out of threads", EXIT_NO_END);
+  thr[nthr].alive = 1;
+  thr[nthr].go = 0;
+  thr[nthr].state = EXITED;
+  return &thr[nthr].alive;
+}
+
+/**
+ * @brief Takes the step after the invoking thread cloned one.
+ * @param tid The Linux tid of the new thread, negative if there is none.
+ * @return The tid the new thread goes by.
+ */
+int sched_forked(int tid)
+{
+  if (tid < 0)
+    return tid;
+  thr[nthr].state = RUNNABLE;
+  tid = ++nthr;
+  live++;
+  reschedule(1);
+  return tid;
+}
+
+/**
+ * @brief Holds a new thread until its first turn.
+ * @param alive What sched_fork_prepare() gave for it.
+ */
+void sched_started(int *alive)
+{
+  wait_turn((sched_thr_t *) alive);
+}
+
+/**
+ * @brief Takes the last step of the running thread, which then exits
+ *        without touching its stack anymore.
+ */
+void sched_vanish(void)
+{
+  sched_thr_t *me = &thr[current];
+
+  me->state = EXITED;
+  if (--live == 0) {
+    report();
+    return;
+  }
+  /* The first thread runs on the stack Linux gave the task, not reused */
+  exiting = current ? me : NULL;
+  hand_over(pick(0));
+}
+
+void sched_exit(void)
+{
+  report();
+}
@@ -0,0 +1,247 @@
+/**
+ * @file trace2json.c
+ * @brief Turns the output of trace_dump() into a Chrome trace.
+ *
+ * Reads a log on stdin, keeps the lines trace_dump() printed, see
+ * user/inc/trace.h, and writes a timeline in the Chrome trace event format
+ * to stdout, for chrome://tracing or https://ui.perfetto.dev:
+ *
+ *    ./trace2json [-t usecs_per_tick] < simics.log > trace.json
+ *
+ * Every thread gets a track. A lock shows up as a slice from acquiring to
+ * releasing it, a deschedule() as a slice until the thread is back, and the
+ * rest as instants. Ticks are coarse, so the events of a thread within one
+ * tick are spread a nanosecond apart to keep them in order. Anything still
+ * open at the end of a ring is shown as an instant.
+ *
+ * @author Zhan Chen (zhanc1)
+ * @author X.D. Zhai (xingdaz)
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "trace.h"
+
+#define MAX_OPEN    64      /* Slices a thread can have open at once */
+
+/**
+ * @brief A slice that has begun but not ended yet.
+ */
+typedef struct open_slice {
+  int type;                 /* TRACE_LOCK or TRACE_SLEEP */
+  unsigned int a, b;
+  double ts;
+} open_slice_t;
+
+/**
+ * @brief What is known about a thread so far.
+ */
+typedef struct thread {
+  int tid;
+  double last;              /* Time of its last event */
+  int nopen;
+  open_slice_t open[MAX_OPEN];
+  struct thread *next;
+} thread_t;
+
+static thread_t *threads = NULL;
+static int first = 1;
+
+static const char *kind_names[] = { "mutex", "rwlock read", "rwlock write" };
+
+/**
+ * @brief Finds the thread with tid, or starts a track for it.
+ */
+static thread_t *find_thread(int tid)
+{
+  thread_t *t;
+
+  for (t = threads; t; t = t->next) {
+    if (t->tid == tid)
+      return t;
+  }
+  if ((t = calloc(1, sizeof(*t))) == NULL) {
+    perror("trace2json");
+    exit(1);
+  }
+  t->tid = tid;
+  t->last = -1;
+  t->next = threads;
+  threads = t;
+  printf("%s{\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"name\":\"thread_name\","
+         "\"args\":{\"name\":\"thread %d\"}}", first ? "" : ",\n", tid, tid);
+  first = 0;
+  return t;
+}
+
+/**
+ * @brief Prints the start of an event, up to where its arguments go.
+ */
+static void begin_event(const char *ph, const char *name, const char *cat,
+                        int tid, double ts)
+{
+  printf("%s{\"ph\":\"%s\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,"
+         "\"name\":\"%s\",\"cat\":\"%s\"", first ? "" : ",\n", ph, tid, ts,
+         name, cat);
+  first = 0;
+}
+
+/**
+ * @brief Prints an instant event with an argument.
+ */
+static void instant(thread_t *t, double ts, const char *name, const char *cat,
+                    const char *arg, unsigned int val)
+{
+  begin_event("i", name, cat, t->tid, ts);
+  printf(",\"s\":\"t\",\"args\":{\"%s\":\"0x%x\"}}", arg, val);
+}
+
+/**
+ * @brief Names the slice of an open lock or deschedule().
+ */
+static const char *slice_name(open_slice_t *o, char *buf, int len)
+{
+  if (o->type == TRACE_SLEEP)
+    snprintf(buf, len, "deschedule");
+  else
+    snprintf(buf, len, "%s 0x%x", o->b < 3 ? kind_names[o->b] : "lock",
+             o->a);
+  return buf;
+}
+
+/**
+ * @brief Ends the open slice matching type and a, the latest one first.
+ */
+static void end_slice(thread_t *t, int type, unsigned int a, double ts)
+{
+  char name[64];
+  open_slice_t *o;
+  int i;
+
+  for (i = t->nopen - 1; i >= 0; i--) {
+    o = &t->open[i];
+    if (o->type == type && o->a == a) {
+      begin_event("X", slice_name(o, name, sizeof(name)),
+                  type == TRACE_SLEEP ? "sched" : "lock", t->tid, o->ts);
+      printf(",\"dur\":%.3f,\"args\":{\"object\":\"0x%x\"}}", ts - o->ts, a);
+      t->open[i] = t->open[--t->nopen];
+      return;
+    }
+  }
+  instant(t, ts, type == TRACE_SLEEP ? "wake" : "unlock",
+          type == TRACE_SLEEP ? "sched" : "lock", "object", a);
+}
+
+/**
+ * @brief Begins a slice, or shows it as an instant if too many are open.
+ */
+static void begin_slice(thread_t *t, int type, unsigned int a,
+                        unsigned int b, double ts)
+{
+  open_slice_t *o;
+
+  if (t->nopen == MAX_OPEN) {
+    instant(t, ts, type == TRACE_SLEEP ? "sleep" : "lock",
+            type == TRACE_SLEEP ? "sched" : "lock", "object", a);
+    return;
+  }
+  o = &t->open[t->nopen++];
+  o->type = type;
+  o->a = a;
+  o->b = b;
+  o->ts = ts;
+}
+
+/**
+ * @brief Turns an event into its part of the timeline.
+ */
+static void event(int tid, unsigned int ticks, int type, unsigned int a,
+                  unsigned int b, double scale)
+{
+  thread_t *t = find_thread(tid);
+  double ts = ticks * scale;
+
+  if (ts <= t->last)
+    ts = t->last + 0.001;
+  t->last = ts;
+
+  switch (type) {
+  case TRACE_CREATE:
+    instant(t, ts, "thr_create", "thread", "tid", a);
+    break;
+  case TRACE_EXIT:
+    instant(t, ts, "thr_exit", "thread", "status", a);
+    break;
+  case TRACE_LOCK:
+  case TRACE_SLEEP:
+    begin_slice(t, type, a, b, ts);
+    break;
+  case TRACE_UNLOCK:
+    end_slice(t, TRACE_LOCK, a, ts);
+    break;
+  case TRACE_WAKE:
+    end_slice(t, TRACE_SLEEP, a, ts);
+    break;
+  case TRACE_RUNNABLE:
+    instant(t, ts, "make_runnable", "sched", "tid", a);
+    break;
+  case TRACE_MALLOC:
+    begin_event("i", "malloc", "malloc", tid, ts);
+    printf(",\"s\":\"t\",\"args\":{\"block\":\"0x%x\",\"size\":%u}}", a, b);
+    break;
+  case TRACE_FREE:
+    instant(t, ts, "free", "malloc", "block", a);
+    break;
+  default:
+    instant(t, ts, "unknown", "trace", "type", type);
+    break;
+  }
+}
+
+/**
+ * @brief Shows what is still open at the end of each ring.
+ */
+static void close_all(void)
+{
+  char name[64];
+  thread_t *t;
+  int i;
+
+  for (t = threads; t; t = t->next) {
+    for (i = 0; i < t->nopen; i++) {
+      begin_event("i", slice_name(&t->open[i], name, sizeof(name)),
+                  "open", t->tid, t->open[i].ts);
+      printf(",\"s\":\"t\"}");
+    }
+  }
+}
+
+int main(int argc, char *argv[])
+{
+  char line[256], *p;
+  unsigned int ticks, a, b;
+  int tid, type, c;
+  double scale = 1.0;
+
+  while ((c = getopt(argc, argv, "t:")) != -1) {
+    if (c != 't' || (scale = atof(optarg)) <= 0) {
+      fprintf(stderr, "usage: %s [-t usecs_per_tick] < log > trace.json\n",
+              argv[0]);
+      return 1;
+    }
+  }
+
+  printf("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+  while (fgets(line, sizeof(line), stdin)) {
+    if ((p = strstr(line, "trace: ")) == NULL)
+      continue;
+    if (sscanf(p, "trace: %d %u %d %x %x", &tid, &ticks, &type, &a, &b) == 5)
+      event(tid, ticks, type, a, b, scale);
+  }
+  close_all();
+  printf("\n]}\n");
+  return 0;
+}
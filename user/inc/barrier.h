@@ -0,0 +1,29 @@
+/**
+ * @file barrier.h
+ * @brief This file defines the interface for reusable barriers.
+ *
+ * A barrier makes a fixed number of threads wait for each other. Once the
+ * last of them arrives all are released and the barrier is ready for the
+ * next round right away, so a phase structured job can simply do:
+ *
+ *    for (phase = 0; phase < PHASES; phase++) {
+ *      work(phase);
+ *      barrier_wait(&barrier);
+ *    }
+ *
+ * @author Zhan Chen (zhanc1)
+ * @author X.D. Zhai (xingdaz)
+ */
+#ifndef BARRIER_H
+#define BARRIER_H
+
+#include <barrier_type.h>
+
+/* Returned by barrier_wait() to exactly one thread of every round */
+#define BARRIER_SERIAL_THREAD 1
+
+int barrier_init(barrier_t *b, int parties);
+void barrier_destroy(barrier_t *b);
+int barrier_wait(barrier_t *b);
+
+#endif /* BARRIER_H */
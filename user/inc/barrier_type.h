@@ -0,0 +1,30 @@
+/**
+ * @file barrier_type.h
+ * @brief This file defines the type for reusable barriers.
+ * @author Zhan Chen (zhanc1)
+ * @author X.D. Zhai (xingdaz)
+ */
+#ifndef _BARRIER_TYPE_H
+#define _BARRIER_TYPE_H
+
+#include <mutex_type.h> /* mutex_t */
+#include <list.h>       /* list_t */
+
+/**
+ * @brief A sense reversing barrier.
+ *
+ * Arriving threads count down remaining without taking any lock. The last one
+ * to arrive refills the count and flips the sense, which releases everybody
+ * waiting on the old sense. The queue only holds the threads that actually
+ * had to go to sleep.
+ */
+typedef struct barrier {
+  int parties;            /* Number of threads that meet at the barrier */
+  volatile int remaining; /* Threads yet to arrive in the current round */
+  volatile int sense;     /* Flipped every time the barrier opens */
+  mutex_t qmutex;         /* Lock around the queue and the sense flip */
+  list_t queue;           /* Threads sleeping until the sense flips */
+  int init;               /* 1 when it's initialized */
+} barrier_t;
+
+#endif /* _BARRIER_TYPE_H */
@@ -0,0 +1,125 @@
+/**
+ * @file coroutine.h
+ * @brief This file defines the interface for stackless coroutines and the
+ *        channels they pass values on.
+ *
+ * A coroutine is a function that returns wherever it has to wait, and is
+ * called again to go on from there. It takes a co_t of a few dozen bytes
+ * and no stack of its own, so a pipeline stage costs next to nothing. The
+ * body sits between co_begin() and co_end() and waits with co_yield(),
+ * co_recv() and co_send():
+ *
+ *    int square(co_t *co)
+ *    {
+ *      stage_t *st = co->arg;
+ *
+ *      co_begin(co);
+ *      for (;;) {
+ *        co_recv(co, st->in, &st->val, st->rc);
+ *        if (st->rc == CHAN_CLOSED)
+ *          break;
+ *        st->val = (void *) ((int) st->val * (int) st->val);
+ *        co_send(co, st->out, st->val, st->rc);
+ *      }
+ *      chan_close(st->out);
+ *      co_end(co);
+ *    }
+ *
+ *    co_sched_init(&sched);
+ *    co_start(&sched, &st.co, square, &st);
+ *    co_sched_run(&sched);
+ *
+ * Locals don't keep their values across a wait, whatever has to goes in
+ * arg. The arguments of co_recv() and co_send() are evaluated again each
+ * time the coroutine goes on, so they can't be locals either. The body
+ * is one big switch statement, with a case for every wait, told apart by
+ * __LINE__. So only one of the macros fits on a line, and none of them can
+ * be in a switch statement of the body's own.
+ *
+ * The coroutines of a scheduler run on whichever threads call
+ * co_sched_run() on it, one at a time each. A channel can be used by
+ * threads as well, chan_send() and chan_recv() wait on a condition
+ * variable. Either side wakes up the other, coroutine or thread.
+ *
+ * @author Zhan Chen (zhanc1)
+ * @author X.D. Zhai (xingdaz)
+ */
+#ifndef COROUTINE_H
+#define COROUTINE_H
+
+#include <coroutine_type.h>
+
+/* What a coroutine body returns */
+#define CO_DONE         0   /* It has finished */
+#define CO_YIELDED      1   /* It is to be called again after the others */
+#define CO_WAITING      2   /* It is to be called again once a channel
+                               wakes it up */
+
+/* Results of the channel operations, besides 0 */
+#define CHAN_CLOSED     (-1)  /* Closed, and for receiving, empty as well */
+#define CHAN_AGAIN      1     /* Would have to wait */
+
+/**
+ * @brief Goes on where the coroutine left off, comes first in the body.
+ */
+#define co_begin(co)    switch ((co)->line) { case 0:
+
+/**
+ * @brief Finishes the coroutine, comes last in the body.
+ */
+#define co_end(co)      } return CO_DONE
+
+/**
+ * @brief Finishes the coroutine from anywhere in the body.
+ */
+#define co_exit(co)     return CO_DONE
+
+/**
+ * @brief Lets the other ready coroutines run first.
+ */
+#define co_yield(co)                                                        \
+  do {                                                                      \
+    (co)->line = __LINE__;                                                  \
+    return CO_YIELDED;                                                      \
+  case __LINE__:                                                            \
+    ;                                                                       \
+  } while (0)
+
+/**
+ * @brief Receives a value from ch into *valp, waiting for one if need be.
+ *        rc is 0 then, or CHAN_CLOSED if ch is closed and empty.
+ */
+#define co_recv(co, ch, valp, rc)                                           \
+  do {                                                                      \
+    (co)->line = __LINE__;                                                  \
+  case __LINE__:                                                            \
+    if (((rc) = chan_try_recv((ch), (valp), (co))) == CHAN_AGAIN)           \
+      return CO_WAITING;                                                    \
+  } while (0)
+
+/**
+ * @brief Sends val on ch, waiting for room if need be. rc is 0 then, or
+ *        CHAN_CLOSED if ch is closed.
+ */
+#define co_send(co, ch, val, rc)                                            \
+  do {                                                                      \
+    (co)->line = __LINE__;                                                  \
+  case __LINE__:                                                            \
+    if (((rc) = chan_try_send((ch), (val), (co))) == CHAN_AGAIN)            \
+      return CO_WAITING;                                                    \
+  } while (0)
+
+int co_sched_init(co_sched_t *s);
+void co_sched_destroy(co_sched_t *s);
+int co_start(co_sched_t *s, co_t *co, int (*body)(co_t *), void *arg);
+int co_sched_run(co_sched_t *s);
+
+int chan_init(chan_t *ch, int cap);
+void chan_destroy(chan_t *ch);
+int chan_send(chan_t *ch, void *val);
+int chan_recv(chan_t *ch, void **valp);
+int chan_try_send(chan_t *ch, void *val, co_t *co);
+int chan_try_recv(chan_t *ch, void **valp, co_t *co);
+void chan_close(chan_t *ch);
+
+#endif /* COROUTINE_H */
@@ -0,0 +1,58 @@
+/**
+ * @file coroutine_type.h
+ * @brief This file defines the types for stackless coroutines, their
+ *        schedulers and channels.
+ * @author Zhan Chen (zhanc1)
+ * @author X.D. Zhai (xingdaz)
+ */
+#ifndef _COROUTINE_TYPE_H
+#define _COROUTINE_TYPE_H
+
+#include <mutex_type.h> /* mutex_t */
+#include <cond_type.h>  /* cond_t */
+#include <list.h>       /* list_t */
+
+struct co_sched;
+
+/**
+ * @brief A stackless coroutine, all there is to it besides what its body
+ *        keeps in arg.
+ */
+typedef struct co {
+  int line;               /* Where the body goes on, 0 at the start */
+  int state;              /* One of CO_READY, CO_RUNNING, ... in coroutine.c */
+  int (*body)(struct co *);
+  void *arg;
+  struct co_sched *sched;
+  list_t entry;           /* In the ready queue or a channel's wait queue */
+} co_t;
+
+/**
+ * @brief A set of coroutines and the queue of those ready to run.
+ */
+typedef struct co_sched {
+  mutex_t lock;           /* Lock around the rest */
+  cond_t work;            /* Signaled when a coroutine gets ready */
+  list_t ready;           /* Coroutines ready to run */
+  int live;               /* Coroutines started and not done yet */
+  int init;               /* 1 when it's initialized */
+} co_sched_t;
+
+/**
+ * @brief A bounded queue of pointers between coroutines, threads, or both.
+ */
+typedef struct chan {
+  mutex_t lock;           /* Lock around the rest */
+  void **buf;             /* Ring of cap slots */
+  int cap;
+  int head;               /* Slot of the oldest value */
+  int count;              /* Values in the ring */
+  int closed;             /* Set by chan_close() */
+  cond_t nonempty;        /* Threads waiting to receive */
+  cond_t nonfull;         /* Threads waiting to send */
+  list_t co_recvq;        /* Coroutines waiting to receive */
+  list_t co_sendq;        /* Coroutines waiting to send */
+  int init;               /* 1 when it's initialized */
+} chan_t;
+
+#endif /* _COROUTINE_TYPE_H */
@@ -0,0 +1,24 @@
+/**
+ * @file ebr.h
+ * @brief This file defines the interface for epoch based reclamation.
+ *
+ * Readers bracket their accesses to shared data with ebr_enter() and
+ * ebr_exit() without taking any lock. Writers unlink an object first and then
+ * hand it to ebr_retire() instead of free(). The object is freed once every
+ * thread that could still hold a reference to it has left its critical
+ * section.
+ *
+ * thr_init() has to be called before any of these functions.
+ *
+ * @author Zhan Chen (zhanc1)
+ * @author X.D. Zhai (xingdaz)
+ */
+#ifndef EBR_H
+#define EBR_H
+
+void ebr_enter(void);
+void ebr_exit(void);
+int ebr_retire(void *ptr);
+void ebr_flush(void);
+
+#endif /* EBR_H */
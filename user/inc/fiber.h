@@ -0,0 +1,62 @@
+/**
+ * @file fiber.h
+ * @brief This file defines the interface for fibers, threads that are
+ *        switched in user mode and multiplexed on a few worker threads.
+ *
+ * A fiber costs a small stack and a context switch of a few instructions,
+ * neither a thread_fork nor a kernel stack, so there can be a great many
+ * more of them than threads. fiber_init() starts the worker threads, each
+ * with a run queue of its own. A worker that runs out of fibers steals from
+ * the others before it goes to sleep.
+ *
+ *    fiber_init(4, 4096);
+ *    for (i = 0; i < 100000; i++)
+ *      fids[i] = fiber_create(serve, conns[i]);
+ *    for (i = 0; i < 100000; i++)
+ *      fiber_join(fids[i], NULL);
+ *    fiber_shutdown();
+ *
+ * Fibers block each other with fiber_mutex_t and fiber_cond_t, which switch
+ * to the next fiber rather than deschedule the worker. Anything else that
+ * blocks, a mutex_t, readline() or sleep() say, blocks the worker and every
+ * fiber queued on it along with it. fiber_mutex_lock(), fiber_cond_wait(),
+ * fiber_yield() and fiber_exit() are for fibers only, the rest may be called
+ * from threads as well, fiber_join() then blocks the calling thread.
+ *
+ * Fiber stacks don't grow. A fiber that overflows its stack is caught, with
+ * a panic, the next time it switches out if it got no further than the
+ * guard word at the bottom.
+ *
+ * @author Zhan Chen (zhanc1)
+ * @author X.D. Zhai (xingdaz)
+ */
+#ifndef FIBER_H
+#define FIBER_H
+
+#include <fiber_type.h>
+
+/* Worker threads fiber_init() starts, at most */
+#define FIBER_MAX_WORKERS 64
+/* Smallest fiber stack fiber_init() accepts */
+#define FIBER_MIN_STACK_SIZE 1024
+
+int fiber_init(int workers, unsigned int stack_size);
+int fiber_shutdown(void);
+int fiber_create(void *(*func)(void *), void *arg);
+int fiber_join(int fid, void **statusp);
+void fiber_exit(void *status);
+void fiber_yield(void);
+int fiber_self(void);
+
+int fiber_mutex_init(fiber_mutex_t *mp);
+void fiber_mutex_destroy(fiber_mutex_t *mp);
+void fiber_mutex_lock(fiber_mutex_t *mp);
+void fiber_mutex_unlock(fiber_mutex_t *mp);
+
+int fiber_cond_init(fiber_cond_t *cv);
+void fiber_cond_destroy(fiber_cond_t *cv);
+void fiber_cond_wait(fiber_cond_t *cv, fiber_mutex_t *mp);
+void fiber_cond_signal(fiber_cond_t *cv);
+void fiber_cond_broadcast(fiber_cond_t *cv);
+
+#endif /* FIBER_H */
@@ -0,0 +1,36 @@
+/**
+ * @file fiber_type.h
+ * @brief This file defines the types for the fiber mutex and condition
+ *        variable.
+ * @author Zhan Chen (zhanc1)
+ * @author X.D. Zhai (xingdaz)
+ */
+#ifndef _FIBER_TYPE_H
+#define _FIBER_TYPE_H
+
+#include <mutex_type.h> /* mutex_t */
+#include <list.h>       /* list_t */
+
+/**
+ * @brief A mutex that blocks the fiber, not the worker thread it runs on.
+ *
+ * Unlocking with fibers waiting hands the mutex straight to the first of
+ * them, locked stays set.
+ */
+typedef struct fiber_mutex {
+  mutex_t guard;      /* Kernel thread lock around the rest, held briefly */
+  int locked;         /* 1 when some fiber holds it */
+  list_t waiters;     /* Fibers waiting for it, first come first served */
+  int init;           /* 1 when it's initialized */
+} fiber_mutex_t;
+
+/**
+ * @brief A condition variable for fibers.
+ */
+typedef struct fiber_cond {
+  mutex_t guard;      /* Kernel thread lock around the queue */
+  list_t waiters;     /* Fibers waiting to be signaled */
+  int init;           /* 1 when it's initialized */
+} fiber_cond_t;
+
+#endif /* _FIBER_TYPE_H */
@@ -0,0 +1,23 @@
+/**
+ * @file latch.h
+ * @brief This file defines the interface for countdown latches.
+ *
+ * A latch is opened by a given number of latch_count_down() calls, after
+ * which latch_wait() returns immediately forever. It is typically used by a
+ * thread that needs to wait for a set of workers to finish their setup,
+ * without joining them.
+ *
+ * @author Zhan Chen (zhanc1)
+ * @author X.D. Zhai (xingdaz)
+ */
+#ifndef LATCH_H
+#define LATCH_H
+
+#include <latch_type.h>
+
+int latch_init(latch_t *l, int count);
+void latch_destroy(latch_t *l);
+void latch_count_down(latch_t *l);
+void latch_wait(latch_t *l);
+
+#endif /* LATCH_H */
@@ -0,0 +1,27 @@
+/**
+ * @file latch_type.h
+ * @brief This file defines the type for countdown latches.
+ * @author Zhan Chen (zhanc1)
+ * @author X.D. Zhai (xingdaz)
+ */
+#ifndef _LATCH_TYPE_H
+#define _LATCH_TYPE_H
+
+#include <mutex_type.h> /* mutex_t */
+#include <list.h>       /* list_t */
+
+/**
+ * @brief A one shot countdown latch.
+ *
+ * The count is decremented without taking any lock. Waiters that find it
+ * still positive put themselves in the queue, which is emptied in one go by
+ * whoever brings the count to zero.
+ */
+typedef struct latch {
+  volatile int count; /* Count downs still expected */
+  mutex_t qmutex;     /* Lock around the queue */
+  list_t queue;       /* Threads sleeping until the count reaches zero */
+  int init;           /* 1 when it's initialized */
+} latch_t;
+
+#endif /* _LATCH_TYPE_H */
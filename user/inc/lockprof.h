@@ -0,0 +1,24 @@
+/**
+ * @file lockprof.h
+ * @brief This file defines the interface for the lock contention profiler.
+ *
+ * Only a thread library built with THR_PROFILE set in config.mk keeps any
+ * numbers, the others print a note instead. Every mutex, condition variable,
+ * reader/writer lock and semaphore is known by its address and the place it
+ * was initialized from, and can be given a name on top:
+ *
+ *    mutex_init(&queue_lock);
+ *    lockprof_name(&queue_lock, "queue");
+ *    ...
+ *    lockprof_dump(10);
+ *
+ * @author Zhan Chen (zhanc1)
+ * @author X.D. Zhai (xingdaz)
+ */
+#ifndef LOCKPROF_H
+#define LOCKPROF_H
+
+void lockprof_name(void *lock, const char *name);
+void lockprof_dump(int top);
+
+#endif /* LOCKPROF_H */
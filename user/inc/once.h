@@ -0,0 +1,23 @@
+/**
+ * @file once.h
+ * @brief This file defines the interface for one time initialization.
+ *
+ * Lazily initialized state is guarded by a statically initialized once_t:
+ *
+ *    static once_t table_once = ONCE_INIT;
+ *
+ *    thr_once(&table_once, table_init);
+ *
+ * Works before thr_init() too, so the allocator can rely on it.
+ *
+ * @author Zhan Chen (zhanc1)
+ * @author X.D. Zhai (xingdaz)
+ */
+#ifndef ONCE_H
+#define ONCE_H
+
+#include <once_type.h>
+
+void thr_once(once_t *once, void (*init_routine)(void));
+
+#endif /* ONCE_H */
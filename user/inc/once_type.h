@@ -0,0 +1,25 @@
+/**
+ * @file once_type.h
+ * @brief This file defines the type for one time initialization.
+ * @author Zhan Chen (zhanc1)
+ * @author X.D. Zhai (xingdaz)
+ */
+#ifndef _ONCE_TYPE_H
+#define _ONCE_TYPE_H
+
+/**
+ * @brief State of a one time initialization.
+ *
+ * state is 0 before anybody started the initialization, the tid of the
+ * thread running it while it is in progress and ONCE_DONE afterwards.
+ */
+typedef struct once {
+  volatile int state;
+} once_t;
+
+#define ONCE_DONE (-1)
+
+/* Static initializer, once_t needs no init function */
+#define ONCE_INIT { 0 }
+
+#endif /* _ONCE_TYPE_H */
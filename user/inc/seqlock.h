@@ -0,0 +1,31 @@
+/**
+ * @file seqlock.h
+ * @brief This file defines the interface for sequence locks.
+ *
+ * Meant for small, frequently read data that can be copied out cheaply. A
+ * reader never blocks a writer:
+ *
+ *    do {
+ *      seq = seqlock_read_begin(&lock);
+ *      copy = shared;
+ *    } while (seqlock_read_retry(&lock, seq));
+ *
+ * The data read inside the loop may be inconsistent until the retry check
+ * passes, so it must not be dereferenced or acted upon before that.
+ *
+ * @author Zhan Chen (zhanc1)
+ * @author X.D. Zhai (xingdaz)
+ */
+#ifndef SEQLOCK_H
+#define SEQLOCK_H
+
+#include <seqlock_type.h>
+
+int seqlock_init(seqlock_t *sl);
+void seqlock_destroy(seqlock_t *sl);
+void seqlock_write_lock(seqlock_t *sl);
+void seqlock_write_unlock(seqlock_t *sl);
+int seqlock_read_begin(seqlock_t *sl);
+int seqlock_read_retry(seqlock_t *sl, int seq);
+
+#endif /* SEQLOCK_H */
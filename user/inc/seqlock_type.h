@@ -0,0 +1,25 @@
+/**
+ * @file seqlock_type.h
+ * @brief This file defines the type for sequence locks.
+ * @author Zhan Chen (zhanc1)
+ * @author X.D. Zhai (xingdaz)
+ */
+#ifndef _SEQLOCK_TYPE_H
+#define _SEQLOCK_TYPE_H
+
+#include <mutex_type.h> /* mutex_t */
+
+/**
+ * @brief A sequence counter guarded by a writer side mutex.
+ *
+ * Writers serialize on the mutex and bump the sequence number on the way in
+ * and on the way out. Readers take no lock at all, they retry whenever the
+ * sequence number was odd or changed while they were reading.
+ */
+typedef struct seqlock {
+  mutex_t writer;     /* Serializes the writers */
+  volatile int seq;   /* Odd while a writer is in its critical section */
+  int init;           /* 1 when it's initialized */
+} seqlock_t;
+
+#endif /* _SEQLOCK_TYPE_H */
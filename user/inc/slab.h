@@ -0,0 +1,40 @@
+/**
+ * @file slab.h
+ * @brief This file defines the interface for slab caches of fixed size
+ *        objects.
+ *
+ * Meant for objects of one type that come and go all the time. A cache is
+ * created once and lives as long as the task:
+ *
+ *    static slab_t *node_slab;
+ *
+ *    node_slab = slab_create(sizeof(node_t));
+ *    node = slab_alloc(node_slab);
+ *    ...
+ *    slab_free(node_slab, node);
+ *
+ * The first few caches created keep a handful of free objects per thread,
+ * so most calls don't take any lock at all once thr_init() has been called.
+ * Memory that went into a cache is never given back to malloc().
+ *
+ * A cache gets its objects from malloc() a couple of pages, or a handful of
+ * objects, at a time. slab_create_ex() takes a larger number of objects at
+ * a time instead, for caches of large objects that are allocated by the
+ * thousands, which would otherwise fill the heap with small chunks.
+ *
+ * @author Zhan Chen (zhanc1)
+ * @author X.D. Zhai (xingdaz)
+ */
+#ifndef SLAB_H
+#define SLAB_H
+
+#include <types.h>  /* size_t */
+
+typedef struct slab slab_t;
+
+slab_t *slab_create(size_t size);
+slab_t *slab_create_ex(size_t size, int per_chunk);
+void *slab_alloc(slab_t *slab);
+void slab_free(slab_t *slab, void *obj);
+
+#endif /* SLAB_H */
@@ -0,0 +1,22 @@
+/**
+ * @file thr_attr_type.h
+ * @brief This file defines the type for thread creation attributes.
+ * @author Zhan Chen (zhanc1)
+ * @author X.D. Zhai (xingdaz)
+ */
+#ifndef _THR_ATTR_TYPE_H
+#define _THR_ATTR_TYPE_H
+
+/**
+ * @brief Attributes thr_create_ex() creates a thread with.
+ *
+ * Filled in with thr_attr_init() and adjusted with the thr_attr_set*()
+ * functions, see thread_ex.h.
+ */
+typedef struct thr_attr {
+  unsigned int stack_size;  /* Stack size, 0 for the size given to thr_init() */
+  void *stack;              /* Lowest byte of a caller provided stack or NULL */
+  int detached;             /* 1 if the thread is reclaimed without a join */
+} thr_attr_t;
+
+#endif /* _THR_ATTR_TYPE_H */
@@ -0,0 +1,39 @@
+/**
+ * @file thread_ex.h
+ * @brief This file defines the thread library functions that go beyond the
+ *        interface in thread.h.
+ *
+ * thr_create_ex() creates a thread with per thread attributes, so a few
+ * threads with deep call chains don't force the stack size of all others:
+ *
+ *    thr_attr_t attr;
+ *
+ *    thr_attr_init(&attr);
+ *    thr_attr_setstacksize(&attr, 256 * 1024);
+ *    tid = thr_create_ex(parser, arg, &attr);
+ *
+ * A detached thread can't be joined, its resources are reclaimed by the
+ * library after it exits. A thread is detached either from the start through
+ * its attributes or later on with thr_detach(). A caller provided stack is never freed by the
+ * library and must stay valid until the thread has been joined, or, for a
+ * detached thread, for as long as the task runs.
+ *
+ * @author Zhan Chen (zhanc1)
+ * @author X.D. Zhai (xingdaz)
+ */
+#ifndef THREAD_EX_H
+#define THREAD_EX_H
+
+#include <thr_attr_type.h>
+
+/* Smallest caller provided stack thr_create_ex() accepts */
+#define THR_MIN_STACK_SIZE 1024
+
+int thr_attr_init(thr_attr_t *attr);
+int thr_attr_setstacksize(thr_attr_t *attr, unsigned int size);
+int thr_attr_setstack(thr_attr_t *attr, void *stack, unsigned int size);
+int thr_attr_setdetached(thr_attr_t *attr, int detached);
+int thr_create_ex(void *(*func)(void *), void *args, thr_attr_t *attr);
+int thr_detach(int tid);
+
+#endif /* THREAD_EX_H */
@@ -0,0 +1,42 @@
+/**
+ * @file trace.h
+ * @brief This file defines the interface for the event tracer.
+ *
+ * Only a thread library built with THR_TRACE set in config.mk records any
+ * events. Each thread writes its own ring of the last TRACE_EVENTS events,
+ * taking no lock and printing nothing, so tracing barely moves the schedule
+ * it is looking at. Once the interesting part is over the rings are printed
+ * with lprintf(), one event per line:
+ *
+ *    trace: <tid> <ticks> <type> <a> <b>
+ *
+ * with a and b in hex. tools/trace2json turns a log with these lines into a
+ * timeline for chrome://tracing or Perfetto. Both trace_dump() and
+ * trace_count() return -1 in a library without tracing.
+ *
+ * @author Zhan Chen (zhanc1)
+ * @author X.D. Zhai (xingdaz)
+ */
+#ifndef TRACE_H
+#define TRACE_H
+
+/* Event types, with what a and b hold */
+#define TRACE_CREATE    0   /* Created thread a */
+#define TRACE_EXIT      1   /* Exited with status a */
+#define TRACE_LOCK      2   /* Acquired lock a, of kind b */
+#define TRACE_UNLOCK    3   /* Released lock a, of kind b */
+#define TRACE_SLEEP     4   /* About to deschedule() on object a */
+#define TRACE_WAKE      5   /* Back from deschedule() on object a */
+#define TRACE_RUNNABLE  6   /* make_runnable() on thread a, for object b */
+#define TRACE_MALLOC    7   /* Got block a of b bytes */
+#define TRACE_FREE      8   /* Freed block a */
+
+/* Kinds of locks */
+#define TRACE_MUTEX     0
+#define TRACE_READ      1   /* rwlock held for reading */
+#define TRACE_WRITE     2   /* rwlock held for writing */
+
+int trace_dump(void);
+int trace_count(int type);
+
+#endif /* TRACE_H */
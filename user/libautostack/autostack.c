@@ -3,14 +3,13 @@
  * @brief Installs page fault handler.
  *  
  * It needs to allocate a small stack for the page fault handler. The esp3 is
- * 2 bytes away from the address where the kernel pushes the two arguments for 
- * the handler.
+ * the top of that stack, right above where the kernel pushes the ureg and the
+ * two arguments for the handler. The handler has to have room to panic() on
+ * it, which takes a lot more than the ureg.
  *
  *         esp3
  *          |
  *          V
- *          -----
- *          |   | 
  *     ----------
  *     |  ureg  |
  *     ----------
@@ -27,9 +26,16 @@
 #include <malloc.h>         /* malloc() */
 #include <syscall.h>        /* swexn() */
 #include "thr_internals.h"  /* _main_ebp */
-#include "swexn_handler.h"  /* SWEXN_STACK_SIZE, ESP3_OFFSET, 
-                               and root_swexn_handler() */
+#include "swexn_handler.h"  /* SWEXN_STACK_SIZE and 
+                               root_swexn_handler() */
 #include <simics.h>
+#include <memlib.h>         /* mem_set_max() */
+
+/* Address space below the root thread's stack that nothing else may take
+ * before thr_init() sets its limit, large blocks mapped from the top down
+ * in particular */
+#define ROOT_STACK_RESERVE  (16 * 1024 * 1024)
+
 /**
  * @brief Installs the page fault handler.
  *
@@ -41,10 +47,17 @@
  */
 void install_autostack(void *stack_high, void *stack_low) 
 {
+  /* Before the first malloc(), so that no block is ever in the way */
+  if ((char *) stack_high - (char *) stack_low < ROOT_STACK_RESERVE)
+    mem_set_max((char *) stack_high - ROOT_STACK_RESERVE);
+  else
+    mem_set_max(stack_low);
+
   /* Make room for the exception handler stack, never freed. At this point
    * we are still single threaded */
-  if (!(root_esp3 = malloc(SWEXN_STACK_SIZE + ESP3_OFFSET)))
+  if (!(root_esp3 = malloc(SWEXN_STACK_SIZE)))
     panic("memory_pressure\n");
+  root_esp3 = (char *) root_esp3 + SWEXN_STACK_SIZE;
   /* Populate root thread pagefault handler argument */
   if (!(root_pagefault_arg = malloc(sizeof(pagefault_handler_arg_t))))
     panic("memory pressure\n");
@@ -52,6 +65,7 @@ void install_autostack(void *stack_high, void *stack_low)
   root_pagefault_arg->stack_high = stack_high;
   root_pagefault_arg->stack_low = stack_low;
   root_pagefault_arg->fixed_size = 0;
+  root_pagefault_arg->esp3 = root_esp3;
   
   /* ureg is left as NULL to tell kernel it is the first registration. */
   if (swexn(root_esp3, root_thr_swexn_handler, 
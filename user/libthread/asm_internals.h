@@ -26,6 +26,22 @@
  */
 int atomic_inc(volatile int *m);
 
+/**
+ * @brief Atomically add a value, which may be negative, to another.
+ *
+ * Equivalent sequence of instructions are:
+ *
+ *    int old_val;
+ *    old_val = *m;
+ *    *m = *m + delta;
+ *    return old_val;
+ *
+ * @param m Pointer to value to be added to.
+ * @param delta Value to add.
+ * @return Old value stored at the address.
+ */
+int atomic_add(volatile int *m, int delta);
+
 /**
  * @brief Atomically move a data into an address.
  *
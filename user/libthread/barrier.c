@@ -0,0 +1,112 @@
+/**
+ * @file barrier.c
+ * @brief Implementation of the barrier APIs specified in user/inc/barrier.h
+ *
+ * Arrival is a single atomic decrement, so only the threads that really have
+ * to wait ever touch the queue lock. The sense a thread waits on is read
+ * before it decrements, when the round it belongs to can't have ended yet.
+ *
+ * The last thread to arrive refills the count before flipping the sense, so
+ * released threads may come around again immediately. The flip is done with
+ * the queue lock held and sleepers check the sense with the same lock held,
+ * so no wakeup gets lost, and every sleeper is woken exactly once.
+ *
+ * @author Zhan Chen (zhanc1)
+ * @author X.D. Zhai (xingdaz)
+ */
+
+/* Public APIs */
+#include <barrier.h>
+#include <stddef.h>         /* NULL */
+#include <barrier_type.h>   /* barrier_t */
+#include <syscall.h>        /* gettid() */
+#include <mutex.h>          /* mutex_init() and mutex_un/lock() */
+#include <assert.h>         /* assert() */
+
+/* Private APIs */
+#include "asm_internals.h"  /* atomic_add() */
+#include "thr_internals.h"  /* waiting_thr_data_t */
+#include "list.h"           /* list_init(), list_add_tail(), and
+                               list_remv_head() */
+#include "trace_internals.h"  /* TRACE() */
+
+/**
+ * @brief Initialize the barrier.
+ * @param b Pointer to allocated but uninitialized barrier_t.
+ * @param parties Number of threads that have to meet at the barrier.
+ * @return 0 on success and negative number on error.
+ */
+int barrier_init(barrier_t *b, int parties)
+{
+  if (!b || parties <= 0)
+    return -1;
+  if (mutex_init(&b->qmutex) < 0)
+    return -2;
+
+  b->parties = parties;
+  b->remaining = parties;
+  b->sense = 0;
+  list_init(&b->queue);
+  b->init = 1;
+  return 0;
+}
+
+/**
+ * @brief Deactivates the barrier.
+ *
+ * It is illegal to destroy the barrier while threads are waiting on it.
+ *
+ * @param b Pointer to initialized barrier_t.
+ */
+void barrier_destroy(barrier_t *b)
+{
+  mutex_lock(&b->qmutex);
+  assert(list_empty(&b->queue) && b->remaining == b->parties);
+  b->init = 0;
+  mutex_unlock(&b->qmutex);
+  mutex_destroy(&b->qmutex);
+}
+
+/**
+ * @brief Waits until all parties have arrived at the barrier.
+ * @param b Pointer to initialized barrier_t.
+ * @return BARRIER_SERIAL_THREAD to the last thread to arrive, 0 to others.
+ */
+int barrier_wait(barrier_t *b)
+{
+  waiting_thr_data_t data, *next_in_line;
+  list_ptr entry;
+  int sense;
+
+  assert(b->init);
+  sense = b->sense;
+
+  if (atomic_add(&b->remaining, -1) == 1) {
+    b->remaining = b->parties;
+    mutex_lock(&b->qmutex);
+    b->sense = !sense;
+    while ((entry = list_remv_head(&b->queue)) != NULL) {
+      next_in_line = LIST_ENTRY(entry, waiting_thr_data_t, list_entry);
+      TRACE(TRACE_RUNNABLE, next_in_line->tid, b);
+      waiter_wake(next_in_line);
+    }
+    mutex_unlock(&b->qmutex);
+    return BARRIER_SERIAL_THREAD;
+  }
+
+  data.tid = gettid();
+  data.about_to_be_runnable = 0;
+  data.woken = 0;
+
+  mutex_lock(&b->qmutex);
+  if (b->sense != sense) {
+    mutex_unlock(&b->qmutex);
+    return 0;
+  }
+  list_add_tail(&b->queue, &data.list_entry);
+  mutex_unlock(&b->qmutex);
+  TRACE(TRACE_SLEEP, b, 0);
+  waiter_sleep(&data);
+  TRACE(TRACE_WAKE, b, 0);
+  return 0;
+}
@@ -0,0 +1,373 @@
+/**
+ * @file coroutine.c
+ * @brief Implementation of the coroutine and channel APIs specified in
+ *        user/inc/coroutine.h
+ *
+ * A coroutine that has to wait puts itself in the channel's queue and
+ * returns CO_WAITING. Whoever takes it off that queue makes it ready, which
+ * may happen before it has even returned, on some other thread. Such a
+ * coroutine is marked CO_WOKEN and co_sched_run() puts it back in the ready
+ * queue as soon as the body returns, rather than leave it waiting.
+ *
+ * Waking a coroutine takes the scheduler lock with the channel lock held,
+ * never the other way around: bodies run without the scheduler lock.
+ *
+ * @author Zhan Chen (zhanc1)
+ * @author X.D. Zhai (xingdaz)
+ */
+
+/* Public APIs and types */
+#include <coroutine.h>
+#include <coroutine_type.h> /* co_t, co_sched_t and chan_t */
+#include <mutex.h>          /* mutex_init() and mutex_un/lock() */
+#include <cond.h>           /* cond_wait() and cond_signal() */
+#include <malloc.h>         /* malloc() and free() */
+#include <stddef.h>         /* NULL */
+#include <assert.h>         /* assert() */
+
+/* Private APIs */
+#include "list.h"           /* list_init(), list_add_tail() and
+                               list_remv_head() */
+
+/* Coroutine states */
+#define CO_READY        0   /* In the ready queue */
+#define CO_RUNNING      1   /* Its body is being called */
+#define CO_WOKEN        2   /* Running, and already woken up from the wait
+                               it is about to return for */
+#define CO_BLOCKED      3   /* In some channel's queue */
+#define CO_FINISHED     4
+
+/**
+ * @brief Initialize the scheduler.
+ * @param s Pointer to allocated but uninitialized co_sched_t.
+ * @return 0 on success and negative number on error.
+ */
+int co_sched_init(co_sched_t *s)
+{
+  if (!s)
+    return -1;
+  if (mutex_init(&s->lock) < 0 || cond_init(&s->work) < 0)
+    return -2;
+
+  list_init(&s->ready);
+  s->live = 0;
+  s->init = 1;
+  return 0;
+}
+
+/**
+ * @brief Deactivates the scheduler, whose coroutines have to be done.
+ * @param s Pointer to initialized co_sched_t.
+ */
+void co_sched_destroy(co_sched_t *s)
+{
+  mutex_lock(&s->lock);
+  assert(s->live == 0);
+  s->init = 0;
+  mutex_unlock(&s->lock);
+  cond_destroy(&s->work);
+  mutex_destroy(&s->lock);
+}
+
+/**
+ * @brief Makes a coroutine ready to run.
+ * @param co Coroutine that was just taken off a channel's queue.
+ */
+static void co_wake(co_t *co)
+{
+  co_sched_t *s = co->sched;
+
+  mutex_lock(&s->lock);
+  if (co->state == CO_RUNNING) {
+    co->state = CO_WOKEN;
+  } else {
+    assert(co->state == CO_BLOCKED);
+    co->state = CO_READY;
+    list_add_tail(&s->ready, &co->entry);
+    cond_signal(&s->work);
+  }
+  mutex_unlock(&s->lock);
+}
+
+/**
+ * @brief Starts a coroutine, which runs once some thread runs s.
+ * @param s Pointer to initialized co_sched_t.
+ * @param co Coroutine to start, stays in use until it is done.
+ * @param body What the coroutine runs, see coroutine.h.
+ * @param arg What the body finds in co->arg.
+ * @return 0 on success and negative number on error.
+ */
+int co_start(co_sched_t *s, co_t *co, int (*body)(co_t *), void *arg)
+{
+  if (!s || !co || !body)
+    return -1;
+  assert(s->init);
+
+  co->line = 0;
+  co->body = body;
+  co->arg = arg;
+  co->sched = s;
+  co->state = CO_READY;
+
+  mutex_lock(&s->lock);
+  s->live++;
+  list_add_tail(&s->ready, &co->entry);
+  cond_signal(&s->work);
+  mutex_unlock(&s->lock);
+  return 0;
+}
+
+/**
+ * @brief Runs the coroutines of s until all of them are done.
+ *
+ * The calling thread waits while every coroutine left waits on a channel.
+ * Several threads may run the same scheduler.
+ *
+ * @param s Pointer to initialized co_sched_t.
+ * @return 0 on success and negative number on error.
+ */
+int co_sched_run(co_sched_t *s)
+{
+  list_ptr entry;
+  co_t *co;
+  int ret;
+
+  if (!s)
+    return -1;
+  assert(s->init);
+
+  mutex_lock(&s->lock);
+  while (s->live > 0) {
+    if ((entry = list_remv_head(&s->ready)) == NULL) {
+      cond_wait(&s->work, &s->lock);
+      continue;
+    }
+    co = LIST_ENTRY(entry, co_t, entry);
+    co->state = CO_RUNNING;
+    mutex_unlock(&s->lock);
+    ret = co->body(co);
+    mutex_lock(&s->lock);
+
+    switch (ret) {
+    case CO_DONE:
+      co->state = CO_FINISHED;
+      /* The others running s go home too */
+      if (--s->live == 0)
+        cond_broadcast(&s->work);
+      break;
+    case CO_WAITING:
+      if (co->state == CO_RUNNING) {
+        co->state = CO_BLOCKED;
+        break;
+      }
+      /* Woken up already, fall through */
+    default:
+      co->state = CO_READY;
+      list_add_tail(&s->ready, &co->entry);
+      break;
+    }
+  }
+  mutex_unlock(&s->lock);
+  return 0;
+}
+
+/**
+ * @brief Initialize the channel.
+ * @param ch Pointer to allocated but uninitialized chan_t.
+ * @param cap Number of values it holds before senders have to wait.
+ * @return 0 on success and negative number on error.
+ */
+int chan_init(chan_t *ch, int cap)
+{
+  if (!ch || cap < 1)
+    return -1;
+  if ((ch->buf = malloc(cap * sizeof(void *))) == NULL)
+    return -2;
+  if (mutex_init(&ch->lock) < 0 || cond_init(&ch->nonempty) < 0 ||
+      cond_init(&ch->nonfull) < 0) {
+    free(ch->buf);
+    return -3;
+  }
+
+  ch->cap = cap;
+  ch->head = 0;
+  ch->count = 0;
+  ch->closed = 0;
+  list_init(&ch->co_recvq);
+  list_init(&ch->co_sendq);
+  ch->init = 1;
+  return 0;
+}
+
+/**
+ * @brief Deactivates the channel, nobody may wait on it.
+ * @param ch Pointer to initialized chan_t.
+ */
+void chan_destroy(chan_t *ch)
+{
+  mutex_lock(&ch->lock);
+  assert(list_empty(&ch->co_recvq) && list_empty(&ch->co_sendq));
+  ch->init = 0;
+  mutex_unlock(&ch->lock);
+  cond_destroy(&ch->nonfull);
+  cond_destroy(&ch->nonempty);
+  mutex_destroy(&ch->lock);
+  free(ch->buf);
+}
+
+/**
+ * @brief Wakes up one waiter in a coroutine queue, or else one thread
+ *        waiting on the condition variable. With ch->lock held.
+ */
+static void wake_one(list_ptr co_queue, cond_t *threads)
+{
+  list_ptr entry;
+
+  if ((entry = list_remv_head(co_queue)) != NULL)
+    co_wake(LIST_ENTRY(entry, co_t, entry));
+  else
+    cond_signal(threads);
+}
+
+/**
+ * @brief Puts val in the ring, with ch->lock held and room in it.
+ */
+static void put(chan_t *ch, void *val)
+{
+  ch->buf[(ch->head + ch->count) % ch->cap] = val;
+  ch->count++;
+  wake_one(&ch->co_recvq, &ch->nonempty);
+}
+
+/**
+ * @brief Takes the oldest value off the ring, with ch->lock held and a
+ *        value in it.
+ */
+static void *take(chan_t *ch)
+{
+  void *val = ch->buf[ch->head];
+
+  ch->head = (ch->head + 1) % ch->cap;
+  ch->count--;
+  wake_one(&ch->co_sendq, &ch->nonfull);
+  return val;
+}
+
+/**
+ * @brief Sends val on the channel, waiting for room if need be.
+ * @param ch Pointer to initialized chan_t.
+ * @param val Value to send.
+ * @return 0 on success, CHAN_CLOSED if the channel is closed.
+ */
+int chan_send(chan_t *ch, void *val)
+{
+  assert(ch->init);
+  mutex_lock(&ch->lock);
+  while (ch->count == ch->cap && !ch->closed)
+    cond_wait(&ch->nonfull, &ch->lock);
+  if (ch->closed) {
+    mutex_unlock(&ch->lock);
+    return CHAN_CLOSED;
+  }
+  put(ch, val);
+  mutex_unlock(&ch->lock);
+  return 0;
+}
+
+/**
+ * @brief Receives a value from the channel, waiting for one if need be.
+ * @param ch Pointer to initialized chan_t.
+ * @param valp Where to put the value.
+ * @return 0 on success, CHAN_CLOSED if the channel is closed and empty.
+ */
+int chan_recv(chan_t *ch, void **valp)
+{
+  assert(ch->init);
+  mutex_lock(&ch->lock);
+  while (ch->count == 0 && !ch->closed)
+    cond_wait(&ch->nonempty, &ch->lock);
+  if (ch->count == 0) {
+    mutex_unlock(&ch->lock);
+    return CHAN_CLOSED;
+  }
+  *valp = take(ch);
+  mutex_unlock(&ch->lock);
+  return 0;
+}
+
+/**
+ * @brief Sends val on the channel if there is room.
+ * @param ch Pointer to initialized chan_t.
+ * @param val Value to send.
+ * @param co Coroutine to queue on the channel if there is no room, NULL
+ *        for none.
+ * @return 0 on success, CHAN_CLOSED if the channel is closed, CHAN_AGAIN if
+ *         there was no room.
+ */
+int chan_try_send(chan_t *ch, void *val, co_t *co)
+{
+  int ret = 0;
+
+  assert(ch->init);
+  mutex_lock(&ch->lock);
+  if (ch->closed) {
+    ret = CHAN_CLOSED;
+  } else if (ch->count == ch->cap) {
+    if (co)
+      list_add_tail(&ch->co_sendq, &co->entry);
+    ret = CHAN_AGAIN;
+  } else {
+    put(ch, val);
+  }
+  mutex_unlock(&ch->lock);
+  return ret;
+}
+
+/**
+ * @brief Receives a value from the channel if there is one.
+ * @param ch Pointer to initialized chan_t.
+ * @param valp Where to put the value.
+ * @param co Coroutine to queue on the channel if it is empty, NULL for
+ *        none.
+ * @return 0 on success, CHAN_CLOSED if the channel is closed and empty,
+ *         CHAN_AGAIN if it is empty.
+ */
+int chan_try_recv(chan_t *ch, void **valp, co_t *co)
+{
+  int ret = 0;
+
+  assert(ch->init);
+  mutex_lock(&ch->lock);
+  if (ch->count > 0) {
+    *valp = take(ch);
+  } else if (ch->closed) {
+    ret = CHAN_CLOSED;
+  } else {
+    if (co)
+      list_add_tail(&ch->co_recvq, &co->entry);
+    ret = CHAN_AGAIN;
+  }
+  mutex_unlock(&ch->lock);
+  return ret;
+}
+
+/**
+ * @brief Closes the channel. Values already in it can still be received,
+ *        every waiter is woken up.
+ * @param ch Pointer to initialized chan_t.
+ */
+void chan_close(chan_t *ch)
+{
+  list_ptr entry;
+
+  assert(ch->init);
+  mutex_lock(&ch->lock);
+  ch->closed = 1;
+  while ((entry = list_remv_head(&ch->co_recvq)) != NULL)
+    co_wake(LIST_ENTRY(entry, co_t, entry));
+  while ((entry = list_remv_head(&ch->co_sendq)) != NULL)
+    co_wake(LIST_ENTRY(entry, co_t, entry));
+  cond_broadcast(&ch->nonempty);
+  cond_broadcast(&ch->nonfull);
+  mutex_unlock(&ch->lock);
+}
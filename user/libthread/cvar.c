@@ -12,7 +12,7 @@
 
 /* Public APIs */
 #include <cond.h>
-#include <syscall.h>        /* deschedule() and make_runnable() */
+#include <syscall.h>        /* gettid() */
 #include <mutex.h>          /* mutex_init() and mutex_un/lock() */
 #include <assert.h>         /* assert() */
 #include <cond_type.h>      /* cont_t */
@@ -21,6 +21,8 @@
 #include "thr_internals.h"  /* waiting_thr_data_t */
 #include "list.h"           /* list_init(), list_add_tail(), and 
                                list_remv_head() */
+#include "lockprof_internals.h" /* prof_register() and prof_acquired() */
+#include "trace_internals.h"  /* TRACE() */
 
 /**
  * @brief Initialize the data structure.
@@ -42,6 +44,7 @@ int cond_init(cond_t *cv)
 
   list_init(&cv->queue);
   cv->init = 1;
+  prof_register(cv, PROF_COND, PROF_SITE());
   return 0;
 }
 
@@ -73,8 +76,10 @@ void cond_destroy(cond_t *cv)
  */
 void cond_wait(cond_t *cv, mutex_t *mp) {
   waiting_thr_data_t data;
+  unsigned int start = PROF_TICKS();
   data.tid = gettid();
   data.about_to_be_runnable = 0;
+  data.woken = 0;
 
   /* It is ok that we are inserting an address on the stack b/c the stack will 
    * only be cleaned up _after_ the thread wakes up at which point the address
@@ -84,8 +89,11 @@ void cond_wait(cond_t *cv, mutex_t *mp) {
   list_add_tail(&cv->queue, &data.list_entry);
   mutex_unlock(mp);
   mutex_unlock(&cv->qmutex);
-  deschedule(&data.about_to_be_runnable);
+  TRACE(TRACE_SLEEP, cv, 0);
+  waiter_sleep(&data);
+  TRACE(TRACE_WAKE, cv, 0);
   mutex_lock(mp);
+  prof_acquired(cv, PROF_COND, 1, PROF_TICKS() - start);
 }
 
 /**
@@ -106,8 +114,8 @@ void cond_signal(cond_t *cv) {
 
   if (entry) {
     next_in_line = LIST_ENTRY(entry, waiting_thr_data_t, list_entry);
-    next_in_line->about_to_be_runnable = 1;
-    make_runnable(next_in_line->tid);
+    TRACE(TRACE_RUNNABLE, next_in_line->tid, cv);
+    waiter_wake(next_in_line);
   }
 }
 
@@ -125,8 +133,8 @@ void cond_broadcast(cond_t *cv) {
 
   while(entry) {
     next_in_line = LIST_ENTRY(entry, waiting_thr_data_t, list_entry);
-    next_in_line->about_to_be_runnable = 1;
-    make_runnable(next_in_line->tid);
+    TRACE(TRACE_RUNNABLE, next_in_line->tid, cv);
+    waiter_wake(next_in_line);
     entry = list_remv_head(&cv->queue);
   };
 
@@ -0,0 +1,263 @@
+/**
+ * @file ebr.c
+ * @brief Implementation of the epoch based reclamation API specified in
+ *        user/inc/ebr.h
+ *
+ * There is one global epoch counter. A reader entering a critical section
+ * announces the epoch it observed in its own record. The global epoch only
+ * moves forward when every reader inside a critical section has announced the
+ * current epoch. So a pointer retired while the global epoch was e can only
+ * be held by readers that announced e or earlier, and all of them are gone by
+ * the time the global epoch reaches e + 2.
+ *
+ * Retired pointers are collected in per thread bags, so the common path of
+ * ebr_retire() takes no lock at all. A full bag is sealed with the current
+ * epoch and appended to the global limbo list, which is therefore in epoch
+ * order. Whoever seals a bag also tries to advance the epoch and frees every
+ * bag that has aged enough, one trip into the allocator per bag.
+ *
+ * @author Zhan Chen (zhanc1)
+ * @author X.D. Zhai (xingdaz)
+ */
+
+/* Public APIs */
+#include <ebr.h>
+#include <stddef.h>             /* NULL */
+#include <stdlib.h>             /* panic() */
+#include <malloc.h>             /* malloc() and free() */
+#include <mutex.h>              /* mutex_init(), mutex_lock(), mutex_unlock() */
+#include <assert.h>             /* assert() */
+#include <list.h>               /* list_t */
+
+/* Private APIs */
+#include "asm_internals.h"      /* xchg() */
+#include "malloc_internals.h"   /* batch_free() */
+#include "thr_internals.h"      /* tcb_t and get_tcb() */
+#include "ebr_internals.h"      /* ebr_record_t and ebr_bag_t */
+
+/* A sealed bag can be freed once the global epoch is this far ahead of it */
+#define EBR_EPOCH_LAG   2
+
+/**
+ * @brief Global epoch state.
+ */
+static struct {
+  unsigned int epoch; /* The global epoch, only advanced with lock held */
+  mutex_t lock;       /* Lock around the registry and the limbo list */
+  list_t records;     /* Dummy head of the registered ebr_record_t */
+  list_t limbo;       /* Dummy head of the sealed bags, oldest first */
+} ebr;
+
+int ebr_init(void)
+{
+  if (mutex_init(&ebr.lock) < 0)
+    return -1;
+  ebr.epoch = 0;
+  list_init(&ebr.records);
+  list_init(&ebr.limbo);
+  return 0;
+}
+
+/**
+ * @brief Gets the calling thread's record, registering it on first use.
+ * @return Pointer to the calling thread's record. Panic if out of memory.
+ */
+static ebr_record_t *ebr_self(void)
+{
+  tcb_t *tcb = get_tcb();
+  ebr_record_t *rec = tcb->ebr;
+
+  if (rec)
+    return rec;
+
+  if (!(rec = (ebr_record_t *) malloc(sizeof(ebr_record_t))))
+    panic("ebr: can't register thread %d\n", tcb->tid);
+  rec->state = 0;
+  rec->nesting = 0;
+  rec->bag = NULL;
+  rec->spare = NULL;
+  mutex_lock(&ebr.lock);
+  list_add_tail(&ebr.records, &rec->rec_entry);
+  mutex_unlock(&ebr.lock);
+  tcb->ebr = rec;
+  return rec;
+}
+
+/**
+ * @brief Moves the global epoch forward if every active reader caught up.
+ *
+ * Must be called with ebr.lock held.
+ */
+static void ebr_try_advance(void)
+{
+  ebr_record_t *rec;
+  list_ptr entry;
+  unsigned int current = (ebr.epoch << 1) | 1;
+
+  for (entry = ebr.records.next; entry != &ebr.records; entry = entry->next) {
+    rec = LIST_ENTRY(entry, ebr_record_t, rec_entry);
+    if (rec->state != 0 && rec->state != current)
+      return;
+  }
+  ebr.epoch++;
+}
+
+/**
+ * @brief Seals the bag being filled and hands it over to the limbo list.
+ *
+ * The epoch is read under the lock so the limbo list stays in epoch order.
+ *
+ * @param rec Pointer to the calling thread's record.
+ */
+static void ebr_seal(ebr_record_t *rec)
+{
+  ebr_bag_t *bag = rec->bag;
+
+  rec->bag = NULL;
+  mutex_lock(&ebr.lock);
+  bag->epoch = ebr.epoch;
+  list_add_tail(&ebr.limbo, &bag->bag_entry);
+  mutex_unlock(&ebr.lock);
+}
+
+/**
+ * @brief Tries to advance the epoch and frees every bag that aged enough.
+ *
+ * Aged bags are unlinked under the lock but freed outside of it. The first
+ * emptied bag is kept as the caller's spare so the next batch doesn't need
+ * to go through malloc().
+ *
+ * @param rec Pointer to the calling thread's record, NULL if there is none.
+ */
+static void ebr_collect(ebr_record_t *rec)
+{
+  ebr_bag_t *bag;
+  list_ptr entry;
+  list_t aged;
+
+  list_init(&aged);
+  mutex_lock(&ebr.lock);
+  ebr_try_advance();
+  while (!list_empty(&ebr.limbo)) {
+    bag = LIST_ENTRY(ebr.limbo.next, ebr_bag_t, bag_entry);
+    /* Limbo is in epoch order, everything after this one is younger */
+    if (ebr.epoch - bag->epoch < EBR_EPOCH_LAG)
+      break;
+    list_add_tail(&aged, list_remv(&bag->bag_entry));
+  }
+  mutex_unlock(&ebr.lock);
+
+  while ((entry = list_remv_head(&aged)) != NULL) {
+    bag = LIST_ENTRY(entry, ebr_bag_t, bag_entry);
+    batch_free(bag->ptrs, bag->count);
+    if (rec && !rec->spare)
+      rec->spare = bag;
+    else
+      free(bag);
+  }
+}
+
+/**
+ * @brief Marks the start of a read side critical section.
+ *
+ * Critical sections can nest, only the outermost one announces an epoch.
+ * xchg() is a full barrier, so the announcement is visible to the other
+ * threads before any shared pointer is read.
+ */
+void ebr_enter(void)
+{
+  ebr_record_t *rec = ebr_self();
+
+  if (rec->nesting++ == 0)
+    xchg((int *) &rec->state, (int) ((ebr.epoch << 1) | 1));
+}
+
+/**
+ * @brief Marks the end of a read side critical section.
+ *
+ * No pointer obtained inside the critical section may be used afterwards.
+ */
+void ebr_exit(void)
+{
+  ebr_record_t *rec = get_tcb()->ebr;
+
+  assert(rec != NULL && rec->nesting > 0);
+  if (--rec->nesting == 0)
+    rec->state = 0;
+}
+
+/**
+ * @brief Frees ptr once no reader can hold a reference to it anymore.
+ *
+ * The caller must have made ptr unreachable for new readers already. It is
+ * legal to retire from inside a critical section.
+ *
+ * @param ptr Pointer previously returned by malloc(). NULL is ignored.
+ * @return 0 on success, negative number if the pointer could not be queued,
+ *         in which case the caller still owns it.
+ */
+int ebr_retire(void *ptr)
+{
+  ebr_record_t *rec;
+
+  if (!ptr)
+    return 0;
+
+  rec = ebr_self();
+  if (!rec->bag) {
+    if (rec->spare) {
+      rec->bag = rec->spare;
+      rec->spare = NULL;
+    } else if (!(rec->bag = (ebr_bag_t *) malloc(sizeof(ebr_bag_t)))) {
+      return -1;
+    }
+    rec->bag->count = 0;
+  }
+
+  rec->bag->ptrs[rec->bag->count++] = ptr;
+  if (rec->bag->count == EBR_BAG_SIZE) {
+    ebr_seal(rec);
+    ebr_collect(rec);
+  }
+  return 0;
+}
+
+/**
+ * @brief Hands over a partially filled bag and pushes the epoch forward.
+ *
+ * Everything the calling thread retired is freed before returning unless
+ * some other thread is still inside a critical section.
+ */
+void ebr_flush(void)
+{
+  ebr_record_t *rec = ebr_self();
+  int i;
+
+  if (rec->bag && rec->bag->count)
+    ebr_seal(rec);
+  for (i = 0; i < EBR_EPOCH_LAG; i++)
+    ebr_collect(rec);
+}
+
+void ebr_thread_exit(tcb_t *tcb)
+{
+  ebr_record_t *rec = tcb->ebr;
+
+  if (!rec)
+    return;
+
+  assert(rec->nesting == 0);
+  if (rec->bag && rec->bag->count)
+    ebr_seal(rec);
+  else
+    free(rec->bag);
+
+  mutex_lock(&ebr.lock);
+  list_remv(&rec->rec_entry);
+  mutex_unlock(&ebr.lock);
+  tcb->ebr = NULL;
+
+  free(rec->spare);
+  free(rec);
+  ebr_collect(NULL);
+}
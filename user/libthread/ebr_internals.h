@@ -0,0 +1,58 @@
+/**
+ * @file ebr_internals.h
+ * @brief Definitions of the epoch based reclamation internals.
+ * @author Zhan Chen (zhanc1)
+ * @author X.D. Zhai (xingdaz)
+ */
+
+#ifndef _EBR_INTERNALS_H_
+#define _EBR_INTERNALS_H_
+
+#include <list.h>             /* list_t */
+#include "thr_internals.h"    /* tcb_t */
+
+#define EBR_BAG_SIZE  64      /* Retired pointers handed over per batch */
+
+/**
+ * @brief A batch of retired pointers.
+ *
+ * Once full, the bag is sealed with the global epoch and appended to the limbo
+ * list. Sealed bags are only freed after the global epoch has moved two steps
+ * past their seal.
+ */
+typedef struct ebr_bag {
+  unsigned int epoch;         /* Global epoch at the time the bag was sealed */
+  int count;                  /* Number of pointers in ptrs */
+  void *ptrs[EBR_BAG_SIZE];
+  list_t bag_entry;           /* Entry in the limbo list */
+} ebr_bag_t;
+
+/**
+ * @brief Per thread epoch record, hung off the TCB.
+ */
+typedef struct ebr_record {
+  unsigned int state;         /* 0 when outside any critical section,
+                                 (epoch << 1) | 1 otherwise */
+  int nesting;                /* Depth of nested ebr_enter() calls */
+  ebr_bag_t *bag;             /* Bag currently being filled */
+  ebr_bag_t *spare;           /* Emptied bag kept around for reuse */
+  list_t rec_entry;           /* Entry in the record registry */
+} ebr_record_t;
+
+/**
+ * @brief Initializes the global epoch state. Called once from thr_init().
+ * @return 0 on success, negative number on error.
+ */
+int ebr_init(void);
+
+/**
+ * @brief Unregisters an exiting thread's record.
+ *
+ * Whatever the thread has retired is handed over to the limbo list so it gets
+ * freed by the surviving threads.
+ *
+ * @param tcb Pointer to the exiting thread's TCB.
+ */
+void ebr_thread_exit(tcb_t *tcb);
+
+#endif /* _EBR_INTERNALS_H_ */
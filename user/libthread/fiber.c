@@ -0,0 +1,733 @@
+/**
+ * @file fiber.c
+ * @brief Implementation of the fiber APIs specified in user/inc/fiber.h
+ *
+ * Every worker thread runs a loop that takes a fiber off its run queue, or
+ * off another worker's, and switches to it with fiber_switch(). The fiber
+ * runs until it yields, blocks or exits, each of which switches back to the
+ * worker loop. Never from one fiber straight to the next: a fiber that
+ * blocks is already in some wait queue, and could be woken up and taken by
+ * another worker before its context is saved. So the fiber leaves what is
+ * left to do in its worker, to unlock the wait queue say, and the worker
+ * does it once the switch is over.
+ *
+ * A fiber runs on the worker's TCB. get_tcb() finds it since the frames of
+ * the fiber lead back to the worker loop's. The stack of a fiber that never
+ * ran is laid out as if fiber_switch() had been called from the start of
+ * fiber_start(), whose caller's frame has the link to the worker loop's
+ * %ebp as saved %ebp. The link is set anew every time the fiber is run.
+ *
+ *                 Higher Address
+ *              --------------------   <-- stack_high
+ *              |       NULL       |
+ *              --------------------
+ *          +-->|       link       +---> worker_main()'s %ebp
+ *          |   --------------------
+ *          |   |       NULL       |   fiber_start() doesn't return
+ *          |   --------------------
+ *          |   |   fiber_start    |
+ *          |   --------------------
+ *          +---+--- saved %ebp    |
+ *              --------------------
+ *              |  %ebx %esi %edi  |
+ *              --------------------   <-- esp
+ *              .                  .
+ *              .                  .
+ *              --------------------
+ *              |   FIBER_GUARD    |
+ *              --------------------   <-- stack
+ *
+ * Fibers are found by id in a hash table. Fibers and their stacks come from
+ * slab caches, malloc() would have to walk a heap of a great many blocks
+ * for each. A fiber's stack is freed as soon as it exits, the rest once it
+ * is joined or the fibers are shut down.
+ *
+ * @author Zhan Chen (zhanc1)
+ * @author X.D. Zhai (xingdaz)
+ */
+
+/* Public APIs and types */
+#include <fiber.h>
+#include <fiber_type.h>     /* fiber_mutex_t and fiber_cond_t */
+#include <thread.h>         /* thr_create() and thr_join() */
+#include <mutex.h>          /* mutex_init() and mutex_un/lock() */
+#include <cond.h>           /* cond_wait() and cond_signal() */
+#include <stdlib.h>         /* calloc(), free() and panic() */
+#include <slab.h>           /* slab_create(), slab_alloc() and slab_free() */
+#include <stddef.h>         /* NULL */
+#include <assert.h>         /* assert() */
+
+/* Private APIs */
+#include "asm_internals.h"  /* atomic_inc() */
+#include "thr_internals.h"  /* get_tcb(), get_ebp() and fiber_switch() */
+#include "list.h"           /* list_init(), list_add_tail(), list_remv() and
+                               list_remv_head() */
+
+#define FIBER_BUCKETS   1024        /* Of the fiber table, a power of 2 */
+#define FIBER_GUARD     0xf1be55ed  /* At the bottom of every fiber stack */
+#define STACKS_PER_CHUNK 64         /* Stacks taken from malloc() at once */
+#define STACK_SLABS     8           /* Stack sizes fiber_init() can be given
+                                       in the task's lifetime, at most */
+
+/* What the worker does once the fiber it ran has switched out */
+#define AFTER_UNLOCK    0           /* Unlock after_lock, the fiber blocked */
+#define AFTER_YIELD     1           /* Queue the fiber again */
+#define AFTER_EXIT      2           /* Free the stack, wake up the joiner */
+
+struct fiber_worker;
+
+/**
+ * @brief Fiber Control Block.
+ */
+typedef struct fiber {
+  int id;
+  void *esp;              /* Saved context while it doesn't run */
+  void *stack;            /* Lowest address, where the guard is */
+  void *stack_high;
+  void *(*func)(void *);
+  void *arg;
+  void *ret;              /* What it exited with */
+  int exited;
+  int joined;             /* Indicate if it has been joined by somebody */
+  struct fiber *joiner;   /* Fiber waiting in fiber_join() for it, if any */
+  struct fiber_worker *worker; /* Runs, ran or is queued on */
+  list_t run_entry;       /* In a run queue or a wait queue */
+  list_t table_entry;     /* In its bucket of the fiber table */
+} fiber_t;
+
+/**
+ * @brief A worker thread and its run queue.
+ */
+typedef struct fiber_worker {
+  mutex_t lock;           /* Lock around the run queue and idle */
+  cond_t work;            /* Signaled when it is idle and gets a fiber */
+  list_t runq;            /* Fibers ready to run */
+  volatile int idle;      /* 1 while waiting on work */
+  int tid;
+  void *esp;              /* Worker loop's context while a fiber runs */
+  fiber_t *current;       /* Fiber running on it, NULL if none */
+  int after;              /* One of the above AFTER_x */
+  mutex_t *after_lock;    /* For AFTER_UNLOCK */
+} fiber_worker_t;
+
+/**
+ * @brief Global state of the fibers.
+ */
+static struct {
+  fiber_worker_t *workers; /* NULL until fiber_init() */
+  int nworkers;
+  unsigned int stack_size;
+  slab_t *stack_slab;     /* Of stack_size objects */
+  int next_worker;        /* Where fibers created by threads go, in turn */
+  mutex_t lock;           /* Lock around the rest */
+  cond_t exited;          /* Broadcast when a fiber exits */
+  list_t table[FIBER_BUCKETS]; /* Fibers not joined yet, by id */
+  int next_id;
+  int live;               /* Fibers that haven't exited */
+  volatile int stopping;  /* Set by fiber_shutdown() */
+} fstate;
+
+static slab_t *fiber_slab;
+
+/**
+ * @brief Slab caches of fiber stacks, one per stack size used so far.
+ */
+static struct {
+  unsigned int size;
+  slab_t *slab;
+} stack_slabs[STACK_SLABS];
+
+/**
+ * @brief Gets the fiber running on the calling worker.
+ * @return The calling fiber, NULL if called from a thread.
+ */
+static fiber_t *self(void)
+{
+  fiber_worker_t *w;
+
+  if (!fstate.workers)
+    return NULL;
+  w = get_tcb()->fiber;
+  return w ? w->current : NULL;
+}
+
+/**
+ * @brief Puts the fiber in the run queue of the worker it last ran on.
+ *
+ * If that worker is busy with a backlog already, an idle worker is woken up
+ * to steal from it.
+ *
+ * @param f Fiber that isn't running nor in any queue.
+ */
+static void ready(fiber_t *f)
+{
+  fiber_worker_t *w = f->worker;
+  int i, backlog;
+
+  mutex_lock(&w->lock);
+  backlog = !list_empty(&w->runq);
+  list_add_tail(&w->runq, &f->run_entry);
+  if (w->idle)
+    cond_signal(&w->work);
+  mutex_unlock(&w->lock);
+  if (!backlog)
+    return;
+
+  for (i = 0; i < fstate.nworkers; i++) {
+    w = &fstate.workers[i];
+    if (w->idle) {
+      mutex_lock(&w->lock);
+      if (w->idle)
+        cond_signal(&w->work);
+      mutex_unlock(&w->lock);
+      return;
+    }
+  }
+}
+
+/**
+ * @brief Takes a fiber off the run queue of some other worker.
+ * @param w The calling worker.
+ * @return The fiber, NULL if every queue looked empty.
+ */
+static fiber_t *steal(fiber_worker_t *w)
+{
+  fiber_worker_t *victim;
+  list_ptr entry = NULL;
+  int i, me = w - fstate.workers;
+
+  for (i = 1; i < fstate.nworkers && !entry; i++) {
+    victim = &fstate.workers[(me + i) % fstate.nworkers];
+    /* Peek without the lock, a miss only costs a fiber some waiting */
+    if (list_empty(&victim->runq))
+      continue;
+    mutex_lock(&victim->lock);
+    entry = list_remv_head(&victim->runq);
+    mutex_unlock(&victim->lock);
+  }
+  return LIST_ENTRY(entry, fiber_t, run_entry);
+}
+
+/**
+ * @brief Gets the next fiber for the worker to run, waiting for one if need
+ *        be.
+ * @param w The calling worker.
+ * @return The fiber, NULL once the fibers are shut down.
+ */
+static fiber_t *next_fiber(fiber_worker_t *w)
+{
+  list_ptr entry;
+  fiber_t *f;
+
+  mutex_lock(&w->lock);
+  while ((entry = list_remv_head(&w->runq)) == NULL) {
+    mutex_unlock(&w->lock);
+    if ((f = steal(w)) != NULL)
+      return f;
+    mutex_lock(&w->lock);
+    if (list_empty(&w->runq)) {
+      if (fstate.stopping) {
+        mutex_unlock(&w->lock);
+        return NULL;
+      }
+      w->idle = 1;
+      cond_wait(&w->work, &w->lock);
+      w->idle = 0;
+    }
+  }
+  mutex_unlock(&w->lock);
+  return LIST_ENTRY(entry, fiber_t, run_entry);
+}
+
+/**
+ * @brief Marks an exited fiber as such, from the worker it ran on.
+ * @param f Fiber that has switched out for good.
+ */
+static void reap(fiber_t *f)
+{
+  slab_free(fstate.stack_slab, f->stack);
+  f->stack = NULL;
+
+  mutex_lock(&fstate.lock);
+  f->exited = 1;
+  fstate.live--;
+  if (f->joiner)
+    ready(f->joiner);
+  cond_broadcast(&fstate.exited);
+  mutex_unlock(&fstate.lock);
+}
+
+/**
+ * @brief Body of the worker threads.
+ * @param arg Its fiber_worker_t.
+ * @return NULL once the fibers are shut down.
+ */
+static void *worker_main(void *arg)
+{
+  fiber_worker_t *w = arg;
+  fiber_t *f;
+
+  get_tcb()->fiber = w;
+  while ((f = next_fiber(w)) != NULL) {
+    f->worker = w;
+    ((void **) f->stack_high)[-2] = get_ebp();
+    w->current = f;
+    fiber_switch(&w->esp, f->esp);
+    w->current = NULL;
+
+    if (f->stack && *(unsigned int *) f->stack != FIBER_GUARD)
+      panic("fiber %d overflowed its stack", f->id);
+    switch (w->after) {
+    case AFTER_UNLOCK:
+      mutex_unlock(w->after_lock);
+      break;
+    case AFTER_YIELD:
+      ready(f);
+      break;
+    case AFTER_EXIT:
+      reap(f);
+      break;
+    }
+  }
+  get_tcb()->fiber = NULL;
+  return NULL;
+}
+
+/**
+ * @brief Switches from the calling fiber back to its worker loop.
+ * @param f The calling fiber.
+ * @param after What the worker is to do once the switch is over.
+ * @param lock Lock to unlock for AFTER_UNLOCK.
+ */
+static void switch_out(fiber_t *f, int after, mutex_t *lock)
+{
+  fiber_worker_t *w = f->worker;
+
+  w->after = after;
+  w->after_lock = lock;
+  fiber_switch(&f->esp, w->esp);
+}
+
+/**
+ * @brief First thing a fiber runs, see the stack diagram above.
+ */
+static void fiber_start(void)
+{
+  fiber_t *f = self();
+
+  fiber_exit(f->func(f->arg));
+}
+
+/**
+ * @brief Starts the worker threads. Only valid after thr_init().
+ * @param workers Number of worker threads, the number of processors the
+ *        fibers are to use.
+ * @param stack_size Size of every fiber stack, it doesn't grow.
+ * @return 0 on success and negative number on error.
+ */
+int fiber_init(int workers, unsigned int stack_size)
+{
+  fiber_worker_t *w;
+  int i;
+
+  if (fstate.workers || workers < 1 || workers > FIBER_MAX_WORKERS ||
+      stack_size < FIBER_MIN_STACK_SIZE)
+    return -1;
+  stack_size &= STACK_ALIGNMENT_MASK;
+  if (!fiber_slab && (fiber_slab = slab_create(sizeof(fiber_t))) == NULL)
+    return -2;
+  for (i = 0; i < STACK_SLABS && stack_slabs[i].slab &&
+              stack_slabs[i].size != stack_size; i++)
+    continue;
+  if (i == STACK_SLABS)
+    return -2;
+  if (!stack_slabs[i].slab) {
+    stack_slabs[i].slab = slab_create_ex(stack_size, STACKS_PER_CHUNK);
+    if (stack_slabs[i].slab == NULL)
+      return -2;
+    stack_slabs[i].size = stack_size;
+  }
+  fstate.stack_size = stack_size;
+  fstate.stack_slab = stack_slabs[i].slab;
+
+  if (mutex_init(&fstate.lock) < 0 || cond_init(&fstate.exited) < 0)
+    return -2;
+  for (i = 0; i < FIBER_BUCKETS; i++)
+    list_init(&fstate.table[i]);
+  if ((fstate.workers = calloc(workers, sizeof(fiber_worker_t))) == NULL)
+    return -2;
+  fstate.live = 0;
+  fstate.stopping = 0;
+
+  for (i = 0; i < workers; i++) {
+    w = &fstate.workers[i];
+    if (mutex_init(&w->lock) < 0 || cond_init(&w->work) < 0)
+      break;
+    list_init(&w->runq);
+    if ((w->tid = thr_create(worker_main, w)) < 0)
+      break;
+    fstate.nworkers++;
+  }
+  if (fstate.nworkers < workers) {
+    fiber_shutdown();
+    return -3;
+  }
+  return 0;
+}
+
+/**
+ * @brief Waits until every fiber has exited, then stops the workers.
+ *
+ * Fibers that weren't joined are reclaimed. fiber_init() may be called again
+ * afterwards.
+ *
+ * @return 0 on success and negative number on error.
+ */
+int fiber_shutdown(void)
+{
+  fiber_worker_t *w;
+  list_ptr entry;
+  int i;
+
+  if (!fstate.workers || self())
+    return -1;
+
+  mutex_lock(&fstate.lock);
+  while (fstate.live > 0)
+    cond_wait(&fstate.exited, &fstate.lock);
+  fstate.stopping = 1;
+  mutex_unlock(&fstate.lock);
+
+  for (i = 0; i < fstate.nworkers; i++) {
+    w = &fstate.workers[i];
+    mutex_lock(&w->lock);
+    cond_signal(&w->work);
+    mutex_unlock(&w->lock);
+  }
+  for (i = 0; i < fstate.nworkers; i++) {
+    w = &fstate.workers[i];
+    thr_join(w->tid, NULL);
+    cond_destroy(&w->work);
+    mutex_destroy(&w->lock);
+  }
+
+  for (i = 0; i < FIBER_BUCKETS; i++) {
+    while ((entry = list_remv_head(&fstate.table[i])) != NULL)
+      slab_free(fiber_slab, LIST_ENTRY(entry, fiber_t, table_entry));
+  }
+  cond_destroy(&fstate.exited);
+  mutex_destroy(&fstate.lock);
+  free(fstate.workers);
+  fstate.workers = NULL;
+  fstate.nworkers = 0;
+  return 0;
+}
+
+/**
+ * @brief Creates a fiber, which runs func(arg) on some worker.
+ *
+ * A fiber created by a fiber starts out on the same worker.
+ *
+ * @param func Body of the fiber, returning from it is fiber_exit().
+ * @param arg Argument to func.
+ * @return Positive fiber id on success and negative number on error.
+ */
+int fiber_create(void *(*func)(void *), void *arg)
+{
+  fiber_t *f, *me = self();
+  void **sp;
+  int fid;
+
+  if (!fstate.workers || !func)
+    return -1;
+  if ((f = slab_alloc(fiber_slab)) == NULL)
+    return -2;
+  if ((f->stack = slab_alloc(fstate.stack_slab)) == NULL) {
+    slab_free(fiber_slab, f);
+    return -2;
+  }
+  f->stack_high = (char *) f->stack + fstate.stack_size;
+  *(unsigned int *) f->stack = FIBER_GUARD;
+
+  /* Please refer to the stack diagram above */
+  sp = f->stack_high;
+  *--sp = NULL;
+  *--sp = NULL;
+  *--sp = NULL;
+  *--sp = (void *) fiber_start;
+  *--sp = (void **) f->stack_high - 2;
+  *--sp = NULL;
+  *--sp = NULL;
+  *--sp = NULL;
+  f->esp = sp;
+
+  f->func = func;
+  f->arg = arg;
+  f->ret = NULL;
+  f->exited = 0;
+  f->joined = 0;
+  f->joiner = NULL;
+  if (me)
+    f->worker = me->worker;
+  else
+    f->worker = &fstate.workers[(unsigned int)
+                                atomic_inc(&fstate.next_worker) %
+                                fstate.nworkers];
+
+  mutex_lock(&fstate.lock);
+  fid = f->id = ++fstate.next_id;
+  list_add_tail(&fstate.table[fid & (FIBER_BUCKETS - 1)], &f->table_entry);
+  fstate.live++;
+  mutex_unlock(&fstate.lock);
+
+  /* f may be gone by the time this returns */
+  ready(f);
+  return fid;
+}
+
+/**
+ * @brief Looks a fiber up in the table, with fstate.lock held.
+ * @param fid Fiber id.
+ * @return The fiber, NULL if there is no such fiber.
+ */
+static fiber_t *lookup(int fid)
+{
+  list_ptr head = &fstate.table[fid & (FIBER_BUCKETS - 1)];
+  list_ptr entry;
+  fiber_t *f;
+
+  for (entry = head->next; entry != head; entry = entry->next) {
+    f = LIST_ENTRY(entry, fiber_t, table_entry);
+    if (f->id == fid)
+      return f;
+  }
+  return NULL;
+}
+
+/**
+ * @brief Waits for a fiber to exit and reclaims it.
+ *
+ * A fiber waits by switching to the next one, a thread by waiting on a
+ * condition variable.
+ *
+ * @param fid Fiber to wait for.
+ * @param statusp Where to put what it exited with, may be NULL.
+ * @return 0 on success and negative number on error.
+ */
+int fiber_join(int fid, void **statusp)
+{
+  fiber_t *f, *me = self();
+
+  if (!fstate.workers)
+    return -1;
+
+  mutex_lock(&fstate.lock);
+  if ((f = lookup(fid)) == NULL || f == me || f->joined) {
+    mutex_unlock(&fstate.lock);
+    return -2;
+  }
+  f->joined = 1;
+  if (me && !f->exited) {
+    /* Readied by reap() */
+    f->joiner = me;
+    switch_out(me, AFTER_UNLOCK, &fstate.lock);
+    mutex_lock(&fstate.lock);
+  }
+  while (!f->exited)
+    cond_wait(&fstate.exited, &fstate.lock);
+  list_remv(&f->table_entry);
+  mutex_unlock(&fstate.lock);
+
+  if (statusp)
+    *statusp = f->ret;
+  slab_free(fiber_slab, f);
+  return 0;
+}
+
+/**
+ * @brief Exits the calling fiber.
+ * @param status What fiber_join() hands out.
+ */
+void fiber_exit(void *status)
+{
+  fiber_t *f = self();
+
+  assert(f);
+  f->ret = status;
+  switch_out(f, AFTER_EXIT, NULL);
+  panic("fiber %d ran after it exited", f->id);
+}
+
+/**
+ * @brief Lets the fibers queued on the calling fiber's worker run first.
+ */
+void fiber_yield(void)
+{
+  fiber_t *f = self();
+
+  assert(f);
+  switch_out(f, AFTER_YIELD, NULL);
+}
+
+/**
+ * @brief Gets the id of the calling fiber.
+ * @return Fiber id, 0 if called from a thread.
+ */
+int fiber_self(void)
+{
+  fiber_t *f = self();
+
+  return f ? f->id : 0;
+}
+
+/**
+ * @brief Initialize the fiber mutex.
+ * @param mp Pointer to allocated but uninitialized fiber_mutex_t.
+ * @return 0 on success and negative number on error.
+ */
+int fiber_mutex_init(fiber_mutex_t *mp)
+{
+  if (!mp)
+    return -1;
+  if (mutex_init(&mp->guard) < 0)
+    return -2;
+
+  mp->locked = 0;
+  list_init(&mp->waiters);
+  mp->init = 1;
+  return 0;
+}
+
+/**
+ * @brief Deactivates the fiber mutex, which has to be unlocked.
+ * @param mp Pointer to initialized fiber_mutex_t.
+ */
+void fiber_mutex_destroy(fiber_mutex_t *mp)
+{
+  mutex_lock(&mp->guard);
+  assert(!mp->locked && list_empty(&mp->waiters));
+  mp->init = 0;
+  mutex_unlock(&mp->guard);
+  mutex_destroy(&mp->guard);
+}
+
+/**
+ * @brief Locks the fiber mutex, switching to other fibers while it is held
+ *        by somebody else.
+ * @param mp Pointer to initialized fiber_mutex_t.
+ */
+void fiber_mutex_lock(fiber_mutex_t *mp)
+{
+  fiber_t *me = self();
+
+  assert(mp->init && me);
+  mutex_lock(&mp->guard);
+  if (!mp->locked) {
+    mp->locked = 1;
+    mutex_unlock(&mp->guard);
+    return;
+  }
+  /* Readied by fiber_mutex_unlock(), which leaves it locked for us */
+  list_add_tail(&mp->waiters, &me->run_entry);
+  switch_out(me, AFTER_UNLOCK, &mp->guard);
+}
+
+/**
+ * @brief Unlocks the fiber mutex, handing it to the first waiter if any.
+ * @param mp Pointer to initialized and locked fiber_mutex_t.
+ */
+void fiber_mutex_unlock(fiber_mutex_t *mp)
+{
+  list_ptr entry;
+
+  assert(mp->init && mp->locked);
+  mutex_lock(&mp->guard);
+  if ((entry = list_remv_head(&mp->waiters)) == NULL)
+    mp->locked = 0;
+  mutex_unlock(&mp->guard);
+  if (entry)
+    ready(LIST_ENTRY(entry, fiber_t, run_entry));
+}
+
+/**
+ * @brief Initialize the fiber condition variable.
+ * @param cv Pointer to allocated but uninitialized fiber_cond_t.
+ * @return 0 on success and negative number on error.
+ */
+int fiber_cond_init(fiber_cond_t *cv)
+{
+  if (!cv)
+    return -1;
+  if (mutex_init(&cv->guard) < 0)
+    return -2;
+
+  list_init(&cv->waiters);
+  cv->init = 1;
+  return 0;
+}
+
+/**
+ * @brief Deactivates the fiber condition variable, nobody may wait on it.
+ * @param cv Pointer to initialized fiber_cond_t.
+ */
+void fiber_cond_destroy(fiber_cond_t *cv)
+{
+  mutex_lock(&cv->guard);
+  assert(list_empty(&cv->waiters));
+  cv->init = 0;
+  mutex_unlock(&cv->guard);
+  mutex_destroy(&cv->guard);
+}
+
+/**
+ * @brief Unlocks mp and waits to be signaled, then locks mp again.
+ *
+ * The calling fiber is in the queue before mp is unlocked, and the queue
+ * stays locked until its worker has switched away from it, so neither a
+ * signal nor a resumption comes too early.
+ *
+ * @param cv Pointer to initialized fiber_cond_t.
+ * @param mp Pointer to fiber_mutex_t locked by the calling fiber.
+ */
+void fiber_cond_wait(fiber_cond_t *cv, fiber_mutex_t *mp)
+{
+  fiber_t *me = self();
+
+  assert(cv->init && me);
+  mutex_lock(&cv->guard);
+  list_add_tail(&cv->waiters, &me->run_entry);
+  fiber_mutex_unlock(mp);
+  switch_out(me, AFTER_UNLOCK, &cv->guard);
+  fiber_mutex_lock(mp);
+}
+
+/**
+ * @brief Wakes up the first fiber waiting on the condition variable.
+ * @param cv Pointer to initialized fiber_cond_t.
+ */
+void fiber_cond_signal(fiber_cond_t *cv)
+{
+  list_ptr entry;
+
+  assert(cv->init);
+  mutex_lock(&cv->guard);
+  entry = list_remv_head(&cv->waiters);
+  mutex_unlock(&cv->guard);
+  if (entry)
+    ready(LIST_ENTRY(entry, fiber_t, run_entry));
+}
+
+/**
+ * @brief Wakes up every fiber waiting on the condition variable.
+ * @param cv Pointer to initialized fiber_cond_t.
+ */
+void fiber_cond_broadcast(fiber_cond_t *cv)
+{
+  list_ptr entry;
+
+  assert(cv->init);
+  mutex_lock(&cv->guard);
+  while ((entry = list_remv_head(&cv->waiters)) != NULL)
+    ready(LIST_ENTRY(entry, fiber_t, run_entry));
+  mutex_unlock(&cv->guard);
+}
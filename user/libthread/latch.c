@@ -0,0 +1,118 @@
+/**
+ * @file latch.c
+ * @brief Implementation of the countdown latch APIs specified in
+ *        user/inc/latch.h
+ *
+ * Counting down and waiting on an open latch take no lock. The thread that
+ * brings the count to zero takes the queue lock once and wakes every sleeper.
+ * Sleepers check the count with the same lock held, so no wakeup gets lost.
+ *
+ * @author Zhan Chen (zhanc1)
+ * @author X.D. Zhai (xingdaz)
+ */
+
+/* Public APIs */
+#include <latch.h>
+#include <stddef.h>         /* NULL */
+#include <latch_type.h>     /* latch_t */
+#include <syscall.h>        /* gettid() */
+#include <mutex.h>          /* mutex_init() and mutex_un/lock() */
+#include <assert.h>         /* assert() */
+
+/* Private APIs */
+#include "asm_internals.h"  /* atomic_add() */
+#include "thr_internals.h"  /* waiting_thr_data_t */
+#include "list.h"           /* list_init(), list_add_tail(), and
+                               list_remv_head() */
+#include "trace_internals.h"  /* TRACE() */
+
+/**
+ * @brief Initialize the latch.
+ * @param l Pointer to allocated but uninitialized latch_t.
+ * @param count Number of latch_count_down() calls that open the latch.
+ * @return 0 on success and negative number on error.
+ */
+int latch_init(latch_t *l, int count)
+{
+  if (!l || count < 0)
+    return -1;
+  if (mutex_init(&l->qmutex) < 0)
+    return -2;
+
+  l->count = count;
+  list_init(&l->queue);
+  l->init = 1;
+  return 0;
+}
+
+/**
+ * @brief Deactivates the latch.
+ *
+ * It is illegal to destroy the latch while threads are waiting on it.
+ *
+ * @param l Pointer to initialized latch_t.
+ */
+void latch_destroy(latch_t *l)
+{
+  mutex_lock(&l->qmutex);
+  assert(list_empty(&l->queue));
+  l->init = 0;
+  mutex_unlock(&l->qmutex);
+  mutex_destroy(&l->qmutex);
+}
+
+/**
+ * @brief Counts the latch down, releasing the waiters when it hits zero.
+ *
+ * Counting down an open latch is illegal.
+ *
+ * @param l Pointer to initialized latch_t.
+ */
+void latch_count_down(latch_t *l)
+{
+  waiting_thr_data_t *next_in_line;
+  list_ptr entry;
+  int old;
+
+  assert(l->init);
+  old = atomic_add(&l->count, -1);
+  assert(old > 0);
+  if (old != 1)
+    return;
+
+  mutex_lock(&l->qmutex);
+  while ((entry = list_remv_head(&l->queue)) != NULL) {
+    next_in_line = LIST_ENTRY(entry, waiting_thr_data_t, list_entry);
+    TRACE(TRACE_RUNNABLE, next_in_line->tid, l);
+    waiter_wake(next_in_line);
+  }
+  mutex_unlock(&l->qmutex);
+}
+
+/**
+ * @brief Waits until the latch is open.
+ * @param l Pointer to initialized latch_t.
+ */
+void latch_wait(latch_t *l)
+{
+  waiting_thr_data_t data;
+
+  assert(l->init);
+  if (l->count == 0)
+    return;
+
+  data.tid = gettid();
+  data.about_to_be_runnable = 0;
+  data.woken = 0;
+
+  mutex_lock(&l->qmutex);
+  if (l->count == 0) {
+    mutex_unlock(&l->qmutex);
+    return;
+  }
+  list_add_tail(&l->queue, &data.list_entry);
+  mutex_unlock(&l->qmutex);
+  TRACE(TRACE_SLEEP, l, 0);
+  waiter_sleep(&data);
+  TRACE(TRACE_WAKE, l, 0);
+}
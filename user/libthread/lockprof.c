@@ -0,0 +1,187 @@
+/**
+ * @file lockprof.c
+ * @brief Implementation of the lock contention profiler APIs specified in
+ *        user/inc/lockprof.h
+ *
+ * The profile of a lock lives in a table on the side, found by hashing the
+ * lock's address and kind, so the lock types look the same either way and
+ * programs don't have to be rebuilt along with the library. The kind keeps
+ * a condition variable apart from the mutex at the start of it. A lock gets its slot when
+ * it is initialized, which also notes who initialized it. Locks initialized
+ * after the table filled up go unprofiled, and are counted as such.
+ *
+ * A lock is contended when a thread has to wait for it. Waiting is counted
+ * in yield() or deschedule() calls, and in ticks, though the clock is only
+ * read when there is some waiting to do. Condition variables and semaphores
+ * count every wait as contended.
+ *
+ * Without THR_PROFILE all that is left is a dump saying so.
+ *
+ * @author Zhan Chen (zhanc1)
+ * @author X.D. Zhai (xingdaz)
+ */
+
+#include <lockprof.h>
+#include <stdio.h>          /* printf() */
+#include <stddef.h>         /* NULL */
+#include "lockprof_internals.h"
+#include "asm_internals.h"  /* atomic_add() and cmpxchg() */
+
+#ifdef THR_PROFILE
+
+#define PROF_MAX_LOCKS  512   /* Locks profiled at most, a power of two */
+
+/**
+ * @brief Profile of a lock.
+ */
+typedef struct prof {
+  void *lock;                 /* Address of the lock, NULL if unused */
+  int kind;                   /* PROF_MUTEX and friends */
+  void *site;                 /* Return address of its init call */
+  const char *name;           /* Given by lockprof_name(), or NULL */
+  volatile int acquired;      /* Times it was acquired, or waited on */
+  volatile int contended;     /* Times that took any waiting */
+  volatile int sleeps;        /* yield() or deschedule() calls */
+  volatile int ticks;         /* Ticks spent waiting */
+} prof_t;
+
+static prof_t profs[PROF_MAX_LOCKS];
+static volatile int dropped = 0;
+
+static const char *kind_names[] = { "mutex", "cond", "rwlock", "sem" };
+
+/**
+ * @brief Finds the slot of a lock, or claims a free one if claim is set.
+ * @return The slot, NULL if there is none.
+ */
+static prof_t *prof_find(void *lock, int kind, int claim)
+{
+  unsigned int i, h = ((unsigned int) lock >> 2) * 2654435761u + kind;
+  prof_t *prof;
+
+  for (i = 0; i < PROF_MAX_LOCKS; i++) {
+    prof = &profs[(h + i) & (PROF_MAX_LOCKS - 1)];
+    if (prof->lock == lock && prof->kind == kind)
+      return prof;
+    if (prof->lock == NULL) {
+      if (!claim)
+        return NULL;
+      if (cmpxchg((int *) &prof->lock, 0, (int) lock)) {
+        prof->kind = kind;
+        return prof;
+      }
+    }
+  }
+  return NULL;
+}
+
+/**
+ * @brief Starts profiling lock, from scratch if its address was used by
+ *        some other lock before.
+ * @param lock Address of the lock.
+ * @param kind PROF_MUTEX, PROF_COND, PROF_RWLOCK or PROF_SEM.
+ * @param site Where it is initialized.
+ */
+void prof_register(void *lock, int kind, void *site)
+{
+  prof_t *prof;
+
+  if ((prof = prof_find(lock, kind, 1)) == NULL) {
+    atomic_add(&dropped, 1);
+    return;
+  }
+  prof->site = site;
+  prof->name = NULL;
+  prof->acquired = prof->contended = prof->sleeps = prof->ticks = 0;
+}
+
+/**
+ * @brief Notes that lock was acquired, or waited on.
+ * @param lock Address of the lock.
+ * @param kind What lock is.
+ * @param sleeps yield() or deschedule() calls it took, 0 if uncontended.
+ * @param ticks Ticks spent waiting.
+ */
+void prof_acquired(void *lock, int kind, int sleeps, unsigned int ticks)
+{
+  prof_t *prof;
+
+  if ((prof = prof_find(lock, kind, 0)) == NULL)
+    return;
+  atomic_add(&prof->acquired, 1);
+  if (sleeps > 0) {
+    atomic_add(&prof->contended, 1);
+    atomic_add(&prof->sleeps, sleeps);
+    atomic_add(&prof->ticks, ticks);
+  }
+}
+
+/**
+ * @brief Names a lock in the dump, along with the mutex inside it.
+ * @param lock Address of an initialized lock.
+ * @param name String that outlives the lock.
+ */
+void lockprof_name(void *lock, const char *name)
+{
+  prof_t *prof;
+  int kind;
+
+  for (kind = PROF_MUTEX; kind <= PROF_SEM; kind++) {
+    if ((prof = prof_find(lock, kind, 0)) != NULL)
+      prof->name = name;
+  }
+}
+
+/**
+ * @brief Prints the most contended locks, the ones most waited for first.
+ *
+ * Meant for a quiet moment, the numbers of locks in use may be off by a
+ * little.
+ *
+ * @param top How many to print at most.
+ */
+void lockprof_dump(int top)
+{
+  static char printed[PROF_MAX_LOCKS];
+  prof_t *prof, *best;
+  int i, n;
+
+  printf("lockprof: %8s %10s %10s %10s  %-6s %s\n", "ticks", "contended",
+         "acquired", "sleeps", "kind", "lock");
+  for (i = 0; i < PROF_MAX_LOCKS; i++)
+    printed[i] = 0;
+
+  for (n = 0; n < top; n++) {
+    best = NULL;
+    for (i = 0; i < PROF_MAX_LOCKS; i++) {
+      prof = &profs[i];
+      if (!prof->lock || printed[i] || prof->contended == 0)
+        continue;
+      if (!best || prof->ticks > best->ticks ||
+          (prof->ticks == best->ticks && prof->contended > best->contended))
+        best = prof;
+    }
+    if (!best)
+      break;
+    printed[best - profs] = 1;
+    printf("lockprof: %8d %10d %10d %10d  %-6s %p from %p %s\n",
+           best->ticks, best->contended, best->acquired, best->sleeps,
+           kind_names[best->kind], best->lock, best->site,
+           best->name ? best->name : "");
+  }
+  if (dropped)
+    printf("lockprof: %d locks not profiled, table full\n", dropped);
+}
+
+#else
+
+void lockprof_name(void *lock, const char *name)
+{
+}
+
+void lockprof_dump(int top)
+{
+  printf("lockprof: not built in, set THR_PROFILE in config.mk\n");
+}
+
+#endif /* THR_PROFILE */
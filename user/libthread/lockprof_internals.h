@@ -0,0 +1,42 @@
+/**
+ * @file lockprof_internals.h
+ * @brief Hooks of the lock contention profiler, see lockprof.c.
+ *
+ * Without THR_PROFILE the hooks are empty and cost nothing.
+ *
+ * @author Zhan Chen (zhanc1)
+ * @author X.D. Zhai (xingdaz)
+ */
+
+#ifndef _LOCKPROF_INTERNALS_H_
+#define _LOCKPROF_INTERNALS_H_
+
+#include <syscall.h>          /* get_ticks() */
+
+/* Kinds of locks */
+#define PROF_MUTEX    0
+#define PROF_COND     1
+#define PROF_RWLOCK   2
+#define PROF_SEM      3
+
+#ifdef THR_PROFILE
+
+void prof_register(void *lock, int kind, void *site);
+void prof_acquired(void *lock, int kind, int sleeps, unsigned int ticks);
+
+/** @brief Starts the clock on a wait, 0 if not profiling. */
+#define PROF_TICKS()  get_ticks()
+
+/** @brief Where the function using it was called from. */
+#define PROF_SITE()   __builtin_return_address(0)
+
+#else
+
+#define prof_register(lock, kind, site)   ((void) 0)
+#define prof_acquired(lock, kind, sleeps, ticks) ((void) (ticks))
+#define PROF_TICKS()  0
+#define PROF_SITE()   NULL
+
+#endif /* THR_PROFILE */
+
+#endif /* _LOCKPROF_INTERNALS_H_ */
@@ -1,6 +1,27 @@
 /**
  * @file malloc.c
  * @brief Thread safe versions of malloc and its variant functions.
+ *
+ * Memory comes from NUM_ARENAS independent heaps, each behind a lock of its
+ * own. Arena 0 is the heap right above the program, the one the _malloc()
+ * family works on, and it serves everything until thr_init() is done. From
+ * then on every thread is given an arena round-robin the first time it
+ * allocates. The other arenas are created on first use, each in a range of
+ * ARENA_SIZE bytes of address space reserved above the heap, and fall back
+ * on arena 0 once their range is full. Large requests always go to arena 0,
+ * the only one that maps them on their own.
+ *
+ * A block goes back to the arena whose range it lies in, arena 0 for all
+ * the others. A thread freeing a block of some other arena doesn't take its
+ * lock, it pushes the block onto the arena's list of remote frees instead.
+ * The list is worked off whenever the arena is locked next, or as soon as
+ * REMOTE_BATCH blocks have piled up on it. Large blocks are the exception:
+ * freeing one only unmaps it, and waiting would keep its pages around.
+ *
+ * The heaps count what goes on in them under their locks, which makes the
+ * numbers per arena rather than per thread but costs next to nothing. The
+ * time spent waiting for a lock is only taken when it is busy to begin with.
+ *
  * @author Zhan Chen (zhanc1)
  * @author X.D. Zhai (xingdaz)
  */
@@ -8,90 +29,476 @@
 #include <malloc.h>
 #include <types.h>          /* size_t */
 #include <stddef.h>         /* NULL */
+#include <syscall.h>        /* PAGE_SIZE and get_ticks() */
+#include <stdio.h>          /* printf() */
+#include <string.h>         /* memcpy() */
 #include <mutex.h>          /* mutex_t, mutex_lock(), and mutex_unlock() */
-#include <asm_internals.h>  /* cmpxchg */
-#include <syscall.h>        /* yield */
+#include <once.h>           /* thr_once() */
+#include <memlib.h>         /* mem_reserve() and mem_set_max() */
+#include <mm_malloc.h>      /* mm_heap_t, mm_malloc(), mm_calloc(),
+                               LARGE_SIZE and GET_MAPPED() */
+#include "asm_internals.h"  /* atomic_add(), xchg() and cmpxchg() */
+#include "thr_internals.h"  /* get_tcb() */
+#include "malloc_internals.h" /* batch_free() */
+#include "trace_internals.h"  /* TRACE() */
 
-static mutex_t big_lock;    /* The big lock around all the following funcs */
-static int thread_safe = 0;
+#define NUM_ARENAS    4
+#define ARENA_SIZE    (16 * 1024 * 1024)  /* Address space of each arena */
+#define REMOTE_BATCH  32    /* Remote frees an arena puts up with */
+#define CACHE_LINE    64    /* Arenas don't share lines with anything else */
 
 /**
- * @brief Acquire the big lock or yield to the thread holding onto the lock 
+ * @brief An arena.
  */
-inline static void thread_safe_entry()
+typedef struct arena {
+  mutex_t lock;             /* Lock around the heap */
+  mm_heap_t heap;           /* Blocks, unused for arena 0 */
+  mem_heap_t mem;           /* Memory of the blocks, unused for arena 0 */
+  char *lo, *hi;            /* Range the arena lives in, NULL for arena 0 */
+  void *volatile remote;    /* Blocks freed by threads of other arenas,
+                               linked through their first word */
+  volatile int nremote;     /* Roughly the length of remote */
+  unsigned int lock_waits;  /* Times the lock was busy */
+  unsigned int lock_ticks;  /* Ticks spent waiting for it */
+} arena_t;
+
+static arena_t main_arena;
+static once_t main_arena_once = ONCE_INIT;
+static arena_t *volatile arenas[NUM_ARENAS] = { &main_arena };
+static volatile int next_arena = 0;
+static int arenas_enabled = 0;
+
+/**
+ * @brief Initialize the lock of arena 0, run through thr_once().
+ */
+static void main_arena_init(void)
 {
-  int tid;
-  if (thread_safe == 0) {
-    tid = gettid();
-    if (cmpxchg(&thread_safe, 0, tid)) {
-      mutex_init(&big_lock);
-    } else {
-      yield(thread_safe);
+  mutex_init(&main_arena.lock);
+}
+
+/**
+ * @brief Allocate from the heap of an arena whose lock is held.
+ */
+static void *heap_malloc(arena_t *arena, size_t size)
+{
+  if (arena == &main_arena)
+    return _malloc(size);
+  return mm_malloc(&arena->heap, size);
+}
+
+/**
+ * @brief Free into the heap of an arena whose lock is held.
+ */
+static void heap_free(arena_t *arena, void *buf)
+{
+  if (arena == &main_arena)
+    _free(buf);
+  else
+    mm_free(&arena->heap, buf);
+}
+
+/**
+ * @brief Frees everything other threads left on the arena's remote list.
+ *
+ * Must be called with the arena's lock held.
+ */
+static void drain(arena_t *arena)
+{
+  void *buf, *next;
+
+  if (!arena->remote)
+    return;
+  xchg((int *) &arena->nremote, 0);
+  for (buf = (void *) xchg((int *) &arena->remote, 0); buf; buf = next) {
+    next = *(void **) buf;
+    heap_free(arena, buf);
+  }
+}
+
+/**
+ * @brief Acquire the lock of an arena and catch up on its remote frees.
+ */
+inline static void arena_enter(arena_t *arena)
+{
+  unsigned int start = 0;
+  int busy;
+
+  thr_once(&main_arena_once, main_arena_init);
+  /* Somebody holds it or is in line for it */
+  if ((busy = arena->lock.next != arena->lock.owner))
+    start = get_ticks();
+  mutex_lock(&arena->lock);
+  if (busy) {
+    arena->lock_waits++;
+    arena->lock_ticks += get_ticks() - start;
+  }
+  drain(arena);
+}
+
+/**
+ * @brief Release the lock of an arena and let others play.
+ */
+inline static void arena_exit(arena_t *arena)
+{
+  mutex_unlock(&arena->lock);
+}
+
+/**
+ * @brief Creates arena i unless some other thread did already.
+ *
+ * If it can't be had arena i stays empty, and is tried again by the next
+ * thread it falls to.
+ */
+static void create_arena(int i)
+{
+  arena_t *arena;
+
+  arena_enter(&main_arena);
+  if (!arenas[i] && (arena = _memalign(CACHE_LINE, (sizeof(arena_t) +
+          CACHE_LINE - 1) & ~(CACHE_LINE - 1))) != NULL) {
+    if ((arena->lo = mem_reserve(ARENA_SIZE)) != NULL &&
+        mutex_init(&arena->lock) == 0) {
+      arena->hi = arena->lo + ARENA_SIZE;
+      arena->remote = NULL;
+      arena->nremote = 0;
+      arena->lock_waits = arena->lock_ticks = 0;
+      mem_heap_init(&arena->mem, arena->lo, arena->hi);
+      if (mm_init(&arena->heap, &arena->mem, 0) == 0)
+        arenas[i] = arena;
     }
+    if (!arenas[i])
+      _free(arena);
+  }
+  arena_exit(&main_arena);
+}
+
+/**
+ * @brief Gets the calling thread's arena, picking one on first use.
+ */
+static arena_t *my_arena(void)
+{
+  tcb_t *tcb;
+  int i;
+
+  if (!arenas_enabled)
+    return &main_arena;
+  tcb = get_tcb();
+  if (!tcb->arena) {
+    i = (unsigned int) atomic_add(&next_arena, 1) % NUM_ARENAS;
+    if (!arenas[i])
+      create_arena(i);
+    tcb->arena = arenas[i] ? arenas[i] : &main_arena;
+  }
+  return tcb->arena;
+}
+
+/**
+ * @brief Gets the arena buf came from.
+ */
+static arena_t *owner_arena(void *buf)
+{
+  arena_t *arena;
+  int i;
+
+  for (i = 1; i < NUM_ARENAS; i++) {
+    arena = arenas[i];
+    if (arena && (char *) buf >= arena->lo && (char *) buf < arena->hi)
+      return arena;
+  }
+  return &main_arena;
+}
+
+/**
+ * @brief Tells whether buf is a large block with pages of its own.
+ */
+static int is_mapped(void *buf)
+{
+  return GET_MAPPED(HDRP(buf)) != 0;
+}
+
+/**
+ * @brief Leaves buf for its arena to free, or frees the whole batch if
+ *        enough have piled up.
+ */
+static void remote_free(arena_t *arena, void *buf)
+{
+  void *head;
+
+  do {
+    head = arena->remote;
+    *(void **) buf = head;
+  } while (!cmpxchg((int *) &arena->remote, (int) head, (int) buf));
+
+  if (atomic_add(&arena->nremote, 1) + 1 >= REMOTE_BATCH) {
+    arena_enter(arena);
+    arena_exit(arena);
   }
-  mutex_lock(&big_lock);
 }
 
 /**
- * @brief Release the lock and let others play.
+ * @brief Allocate from an arena, from arena 0 if that arena is full.
  */
-inline static void thread_safe_exit()
+static void *arena_malloc(arena_t *arena, size_t size)
 {
-  mutex_unlock(&big_lock);
+  void *ret;
+  arena_enter(arena);
+  ret = heap_malloc(arena, size);
+  arena_exit(arena);
+  if (ret == NULL && arena != &main_arena)
+    ret = arena_malloc(&main_arena, size);
+  return ret;
+}
+
+/**
+ * @brief Adds the stats of one heap to the ones of others.
+ */
+static void add_stats(malloc_stats_t *sum, malloc_stats_t *stats)
+{
+  int i;
+
+  for (i = 0; i < MALLOC_CLASSES; i++) {
+    sum->allocs[i] += stats->allocs[i];
+    sum->frees[i] += stats->frees[i];
+  }
+  sum->searches += stats->searches;
+  sum->probes += stats->probes;
+  sum->live += stats->live;
+  sum->committed += stats->committed;
+  sum->mapped += stats->mapped;
+  sum->free_bytes += stats->free_bytes;
+  sum->free_blocks += stats->free_blocks;
+  if (stats->largest_free > sum->largest_free)
+    sum->largest_free = stats->largest_free;
+}
+
+void malloc_enable_arenas(void)
+{
+  arenas_enabled = 1;
 }
 
 int double_malloc(void **dest1, size_t __size1, void **dest2, size_t __size2)
 {
+  arena_t *arena = my_arena();
   void *ret1, *ret2;
   int ret = 0;
-  thread_safe_entry();
-  ret1 = _malloc(__size1);
+  arena_enter(arena);
+  ret1 = heap_malloc(arena, __size1);
   if (ret1 != NULL) {
-    ret2 = _malloc(__size2);
+    ret2 = heap_malloc(arena, __size2);
     if (ret2 != NULL) {
       *dest1 = ret1;
       *dest2 = ret2;
     } else {
-      _free(ret1);
+      heap_free(arena, ret1);
       ret = -2;
     }
   } else {
     ret = -1;
   }
-  thread_safe_exit();
+  arena_exit(arena);
   return ret;
 }
 
 void *malloc(size_t __size)
 {
-  void *ret;
-  thread_safe_entry();
-  ret = _malloc(__size);
-  thread_safe_exit();
+  void *ret = arena_malloc(__size >= LARGE_SIZE ? &main_arena : my_arena(),
+                           __size);
+  TRACE(TRACE_MALLOC, ret, __size);
   return ret;
 }
 
 void *calloc(size_t __nelt, size_t __eltsize)
 {
+  size_t size = __nelt * __eltsize;
+  arena_t *arena = size >= LARGE_SIZE ? &main_arena : my_arena();
+  void *ret;
+
+  arena_enter(arena);
+  if (arena == &main_arena)
+    ret = _calloc(__nelt, __eltsize);
+  else
+    ret = mm_calloc(&arena->heap, size);
+  arena_exit(arena);
+  if (ret == NULL && arena != &main_arena) {
+    arena_enter(&main_arena);
+    ret = _calloc(__nelt, __eltsize);
+    arena_exit(&main_arena);
+  }
+  TRACE(TRACE_MALLOC, ret, size);
+  return ret;
+}
+
+void *memalign(size_t __alignment, size_t __size)
+{
+  arena_t *arena = __size >= LARGE_SIZE ? &main_arena : my_arena();
   void *ret;
-  thread_safe_entry();
-  ret = _calloc(__nelt, __eltsize);
-  thread_safe_exit();
+
+  arena_enter(arena);
+  if (arena == &main_arena)
+    ret = _memalign(__alignment, __size);
+  else
+    ret = mm_memalign(&arena->heap, __alignment, __size);
+  arena_exit(arena);
+  if (ret == NULL && arena != &main_arena) {
+    arena_enter(&main_arena);
+    ret = _memalign(__alignment, __size);
+    arena_exit(&main_arena);
+  }
+  TRACE(TRACE_MALLOC, ret, __size);
   return ret;
 }
 
+void *valloc(size_t __size)
+{
+  return memalign(PAGE_SIZE, __size);
+}
+
 void *realloc(void *__buf, size_t __new_size)
 {
+  arena_t *arena;
   void *ret;
-  thread_safe_entry();
-  ret = _realloc(__buf, __new_size);
-  thread_safe_exit();
+
+  if (__buf == NULL)
+    return malloc(__new_size);
+
+  /* Stays in the arena it came from, unless that one is full */
+  arena = owner_arena(__buf);
+  arena_enter(arena);
+  if (arena == &main_arena)
+    ret = _realloc(__buf, __new_size);
+  else
+    ret = mm_realloc(&arena->heap, __buf, __new_size);
+  arena_exit(arena);
+
+  /* A block resized in place, or left alone, is still the same block */
+  if (ret != NULL) {
+    if (ret != __buf)
+      TRACE(TRACE_FREE, __buf, 0);
+  } else if (__new_size != 0 && arena != &main_arena &&
+             (ret = arena_malloc(&main_arena, __new_size)) != NULL) {
+    memcpy(ret, __buf, (size_t) mm_size(__buf) < __new_size ?
+           (size_t) mm_size(__buf) : __new_size);
+    free(__buf);
+  }
+  if (ret != NULL && ret != __buf)
+    TRACE(TRACE_MALLOC, ret, __new_size);
   return ret;
 }
 
+void malloc_set_trim_threshold(size_t __threshold)
+{
+  arena_enter(&main_arena);
+  _malloc_set_trim_threshold(__threshold);
+  arena_exit(&main_arena);
+}
+
+int malloc_trim(void)
+{
+  arena_t *arena;
+  int i, ret = 0;
+  for (i = 0; i < NUM_ARENAS; i++) {
+    if ((arena = arenas[i]) == NULL)
+      continue;
+    arena_enter(arena);
+    if (arena == &main_arena)
+      ret += _malloc_trim();
+    else
+      ret += mm_trim(&arena->heap);
+    arena_exit(arena);
+  }
+  return ret;
+}
+
+void malloc_stats(malloc_stats_t *__stats)
+{
+  arena_t *arena;
+  int i;
+
+  memset(__stats, 0, sizeof(*__stats));
+  for (i = 0; i < NUM_ARENAS; i++) {
+    if ((arena = arenas[i]) == NULL)
+      continue;
+    arena_enter(arena);
+    if (arena == &main_arena) {
+      malloc_stats_t main_stats;
+      _malloc_stats(&main_stats);
+      add_stats(__stats, &main_stats);
+    } else {
+      mm_stats(&arena->heap, __stats);
+    }
+    __stats->lock_waits += arena->lock_waits;
+    __stats->lock_ticks += arena->lock_ticks;
+    arena_exit(arena);
+  }
+}
+
+void malloc_report(void)
+{
+  malloc_stats_t stats;
+
+  malloc_stats(&stats);
+  mm_report(&stats);
+}
+
+void *reserve_range(int size)
+{
+  void *ret;
+  arena_enter(&main_arena);
+  ret = mem_reserve(size);
+  arena_exit(&main_arena);
+  return ret;
+}
+
+int limit_heap(void *max_addr)
+{
+  int ret;
+  arena_enter(&main_arena);
+  ret = mem_set_max(max_addr);
+  arena_exit(&main_arena);
+  return ret;
+}
+
+void batch_free(void **bufs, int count)
+{
+  arena_t *arena = arenas_enabled ? get_tcb()->arena : &main_arena;
+  int i;
+
+  /* Ours in one go, the rest after letting go of our lock, since handing
+   * them over may take the lock of their arena */
+  if (arena) {
+    arena_enter(arena);
+    for (i = 0; i < count; i++) {
+      if (bufs[i] && owner_arena(bufs[i]) == arena) {
+        heap_free(arena, bufs[i]);
+        bufs[i] = NULL;
+      }
+    }
+    arena_exit(arena);
+  }
+  for (i = 0; i < count; i++) {
+    if (bufs[i] && is_mapped(bufs[i])) {
+      arena_enter(&main_arena);
+      heap_free(&main_arena, bufs[i]);
+      arena_exit(&main_arena);
+    } else if (bufs[i]) {
+      remote_free(owner_arena(bufs[i]), bufs[i]);
+    }
+  }
+}
+
 void free(void *__buf)
 {
-  thread_safe_entry();
-  _free(__buf);
-  thread_safe_exit();
+  arena_t *arena;
+
+  if (__buf == NULL)
+    return;
+  TRACE(TRACE_FREE, __buf, 0);
+  arena = owner_arena(__buf);
+  if (arenas_enabled && arena != get_tcb()->arena && !is_mapped(__buf)) {
+    remote_free(arena, __buf);
+    return;
+  }
+  arena_enter(arena);
+  heap_free(arena, __buf);
+  arena_exit(arena);
 }
@@ -16,4 +16,43 @@
  */
 int double_malloc(void **dest1, size_t __size1, void **dest2, size_t __size2);
 
+/**
+ * @brief Free a batch of blocks in a single critical section.
+ *
+ * Used by the epoch based reclamation where retired blocks are released in
+ * groups, so the lock of the calling thread's arena is taken once per batch
+ * instead of once per block. Blocks of other arenas are handed over to them.
+ * NULL entries are skipped.
+ *
+ * @param bufs Array of blocks to be freed, left with all entries NULL.
+ * @param count Number of entries in bufs.
+ */
+void batch_free(void **bufs, int count);
+
+/**
+ * @brief Reserve address space above the heap, see mem_reserve().
+ *
+ * Goes through the allocator's lock because the heap's limit is shared with
+ * mem_sbrk().
+ *
+ * @param size Bytes of address space, rounded up to whole pages.
+ * @return Lowest address of the range, NULL if the heap is in the way.
+ */
+void *reserve_range(int size);
+
+/**
+ * @brief Keep the heap below max_addr, see mem_set_max().
+ * @param max_addr Address the heap must not grow past.
+ * @return 0 on success, negative if the heap is already past it.
+ */
+int limit_heap(void *max_addr);
+
+/**
+ * @brief Lets threads allocate from arenas of their own.
+ *
+ * Called once thr_init() has made get_tcb() work, before that everything
+ * comes from arena 0.
+ */
+void malloc_enable_arenas(void);
+
 #endif /* _MALLOC_INTERNALS_H_ */
@@ -21,6 +21,8 @@
 
 /* Private APIs */
 #include "asm_internals.h"  /* atomic_inc, xchg*/
+#include "lockprof_internals.h" /* prof_register() and prof_acquired() */
+#include "trace_internals.h"  /* TRACE() */
 
 /**
  * @brief Initialize the mutex object. 
@@ -39,6 +41,7 @@ int mutex_init(mutex_t *mp)
   mp->next = mp->owner = 0;
   mp->locked = 0;
   mp->init = 1;
+  prof_register(mp, PROF_MUTEX, PROF_SITE());
   return 0;
 }
 
@@ -66,13 +69,19 @@ void mutex_destroy(mutex_t *mp) {
  * @param mp Pointer to initialized mutex object.
  */
 void mutex_lock(mutex_t *mp) {
-  int ticket;
+  int ticket, sleeps = 0;
+  unsigned int start = 0;
   ticket = atomic_inc(&(mp->next));
   assert(mp->init == 1);
+  if (ticket != mp->owner)
+    start = PROF_TICKS();
   while (ticket != mp->owner) {
     yield(-1);
+    sleeps++;
   }
   mp->locked = 1;
+  prof_acquired(mp, PROF_MUTEX, sleeps, sleeps ? PROF_TICKS() - start : 0);
+  TRACE(TRACE_LOCK, mp, TRACE_MUTEX);
 }
 
 /**
@@ -84,7 +93,9 @@ void mutex_lock(mutex_t *mp) {
  * @param mp Pointer to initialized mutex object.
  */
 void mutex_unlock(mutex_t *mp) {
-  int old_lock = xchg(&(mp->locked), 0);
+  int old_lock;
+  TRACE(TRACE_UNLOCK, mp, TRACE_MUTEX);
+  old_lock = xchg(&(mp->locked), 0);
   assert(mp->init == 1);
   assert(old_lock == 1);
   mp->owner++;
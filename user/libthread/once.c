@@ -0,0 +1,49 @@
+/**
+ * @file once.c
+ * @brief Implementation of the one time initialization API specified in
+ *        user/inc/once.h
+ *
+ * The first caller claims the once_t by swapping its tid in with cmpxchg()
+ * and runs the initialization. Everybody else arriving in the meantime
+ * yields to that thread until it publishes ONCE_DONE. After that the cost
+ * is a single load and compare.
+ *
+ * @author Zhan Chen (zhanc1)
+ * @author X.D. Zhai (xingdaz)
+ */
+
+/* Public APIs */
+#include <once.h>
+#include <once_type.h>      /* once_t */
+#include <syscall.h>        /* gettid() and yield() */
+
+/* Private APIs */
+#include "asm_internals.h"  /* cmpxchg() and xchg() */
+
+/**
+ * @brief Runs init_routine exactly once for a given once_t.
+ *
+ * No caller returns before init_routine has returned. init_routine must not
+ * call thr_once() on the same once_t.
+ *
+ * @param once Pointer to once_t initialized with ONCE_INIT.
+ * @param init_routine Function that does the initialization.
+ */
+void thr_once(once_t *once, void (*init_routine)(void))
+{
+  int owner;
+
+  if (once->state == ONCE_DONE)
+    return;
+
+  if (cmpxchg((int *) &once->state, 0, gettid())) {
+    init_routine();
+    /* xchg() is a full barrier, the initialization is visible before the
+     * fast path can observe ONCE_DONE */
+    xchg((int *) &once->state, ONCE_DONE);
+    return;
+  }
+
+  while ((owner = once->state) != ONCE_DONE)
+    yield(owner);
+}
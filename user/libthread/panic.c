@@ -24,6 +24,7 @@
 #include <stdlib.h>
 #include <simics.h>
 #include <syscall.h>
+#include <string.h>
 /*
  * This function is called by the assert() macro defined in assert.h;
  * it's also a nice simple general-purpose panic function.
@@ -32,7 +33,7 @@ void panic(const char *fmt, ...)
 {
   /* Points to each unnamed argument in turn */
 	va_list vl;
-	char buf[80];
+	char buf[256];
 
   /* Initializes vl to point at the first unnamed argument */
 	va_start(vl, fmt);
@@ -40,10 +41,10 @@ void panic(const char *fmt, ...)
 	va_end(vl); /* Cleans up when done */
 	lprintf(buf);
 
-	va_start(vl, fmt);
-	vprintf(fmt, vl);
-	va_end(vl);
-	printf("\n");
+	/* Not through printf(): the thread's stdout buffer is found by way of
+	 * its stack, which may well be what went wrong */
+	print(strlen(buf), buf);
+	print(1, "\n");
 
 	while (1) {
 		// exact authorship uncertain, popularized by Heinlein
@@ -17,9 +17,11 @@
 #include <rwlock.h>
 #include <rwlock_type.h>    /* rwlock_t */
 #include <assert.h>         /* assert() */
-#include <syscall.h>        /* deschedule() and make_runnable() */
+#include <syscall.h>        /* gettid() */
 #include <list.h>           /* list_init, list_add_tail, and list_remv_head */
 #include "thr_internals.h"  /* waiting_thr_data_t */
+#include "lockprof_internals.h" /* prof_register() and prof_acquired() */
+#include "trace_internals.h"  /* TRACE() */
 
 /**
  * @brief Initialize rwlock data structure.
@@ -38,6 +40,7 @@ int rwlock_init(rwlock_t *rwlock)
   list_init(&rwlock->queue);
   rwlock->holder = 0;
   rwlock->init = 1;
+  prof_register(rwlock, PROF_RWLOCK, PROF_SITE());
   return 0;
 }
 
@@ -52,14 +55,21 @@ int rwlock_init(rwlock_t *rwlock)
  */
 static void reader_lock(rwlock_t *rwlock, waiting_thr_data_t *waiting_data)
 {
+  unsigned int start;
+
   if (!list_empty(&rwlock->queue) || rwlock->holder < 0) {
+    start = PROF_TICKS();
     list_add_tail(&rwlock->queue, &waiting_data->list_entry);
     mutex_unlock(&rwlock->data);
-    deschedule(&waiting_data->about_to_be_runnable);
+    TRACE(TRACE_SLEEP, rwlock, 0);
+    waiter_sleep(waiting_data);
+    TRACE(TRACE_WAKE, rwlock, 0);
+    prof_acquired(rwlock, PROF_RWLOCK, 1, PROF_TICKS() - start);
     return;
   } else {
     rwlock->holder++;
     mutex_unlock(&rwlock->data);
+    prof_acquired(rwlock, PROF_RWLOCK, 0, 0);
     return;
   }
 }
@@ -75,14 +85,21 @@ static void reader_lock(rwlock_t *rwlock, waiting_thr_data_t *waiting_data)
  */
 static void writer_lock(rwlock_t *rwlock, waiting_thr_data_t *waiting_data)
 {
+  unsigned int start;
+
   if (!list_empty(&rwlock->queue) || rwlock->holder != 0) {
+    start = PROF_TICKS();
     list_add_tail(&rwlock->queue, &waiting_data->list_entry);
     mutex_unlock(&rwlock->data);
-    deschedule(&waiting_data->about_to_be_runnable);
+    TRACE(TRACE_SLEEP, rwlock, 0);
+    waiter_sleep(waiting_data);
+    TRACE(TRACE_WAKE, rwlock, 0);
+    prof_acquired(rwlock, PROF_RWLOCK, 1, PROF_TICKS() - start);
     return;
   } else {
     rwlock->holder = -waiting_data->tid;
     mutex_unlock(&rwlock->data);
+    prof_acquired(rwlock, PROF_RWLOCK, 0, 0);
     return;
   }
 }
@@ -97,6 +114,7 @@ void rwlock_lock(rwlock_t *rwlock, int type)
   waiting_thr_data_t data;
   data.tid = gettid();
   data.about_to_be_runnable = 0;
+  data.woken = 0;
   data.type = type;
 
   mutex_lock(&rwlock->data);
@@ -104,8 +122,10 @@ void rwlock_lock(rwlock_t *rwlock, int type)
   assert(type == RWLOCK_READ || type == RWLOCK_WRITE);
   if (type == RWLOCK_READ) {
     reader_lock(rwlock, &data);
+    TRACE(TRACE_LOCK, rwlock, TRACE_READ);
   } else {
     writer_lock(rwlock, &data);
+    TRACE(TRACE_LOCK, rwlock, TRACE_WRITE);
   }
 }
 
@@ -139,9 +159,30 @@ static void reader_unlock(rwlock_t *rwlock)
     entry = list_remv_head(&rwlock->queue);
     next_in_line = LIST_ENTRY(entry, waiting_thr_data_t, list_entry);
     assert(next_in_line->type == RWLOCK_WRITE);
-    next_in_line->about_to_be_runnable = 1;
     rwlock->holder = -next_in_line->tid;
-    make_runnable(next_in_line->tid);
+    TRACE(TRACE_RUNNABLE, next_in_line->tid, rwlock);
+    waiter_wake(next_in_line);
+  }
+}
+
+/**
+ * @brief Wakes up the readers at the head of the queue, up to the first
+ *        writer, which stays in line.
+ * @param rwlock Pointer to initialized rwlock whose data mutex is held.
+ */
+static void wake_readers(rwlock_t *rwlock)
+{
+  waiting_thr_data_t *next_in_line;
+
+  while (!list_empty(&rwlock->queue)) {
+    next_in_line = LIST_ENTRY(rwlock->queue.next, waiting_thr_data_t,
+                              list_entry);
+    if (next_in_line->type != RWLOCK_READ)
+      return;
+    list_remv_head(&rwlock->queue);
+    rwlock->holder++;
+    TRACE(TRACE_RUNNABLE, next_in_line->tid, rwlock);
+    waiter_wake(next_in_line);
   }
 }
 
@@ -171,20 +212,17 @@ static void writer_unlock(rwlock_t *rwlock)
 
   /* Wake up one writer */
   if (next_in_line->type == RWLOCK_WRITE) {
-    rwlock->holder = -gettid();;
-    next_in_line->about_to_be_runnable = 1;
-    make_runnable(next_in_line->tid);
+    rwlock->holder = -next_in_line->tid;
+    TRACE(TRACE_RUNNABLE, next_in_line->tid, rwlock);
+    waiter_wake(next_in_line);
     return;
   }
 
   /* Or all readers */
-  while (next_in_line && next_in_line->type == RWLOCK_READ) {
-    next_in_line->about_to_be_runnable = 1;
-    rwlock->holder++;
-    make_runnable(next_in_line->tid);
-    entry = list_remv_head(&rwlock->queue);
-    next_in_line = LIST_ENTRY(entry, waiting_thr_data_t, list_entry);
-  }
+  rwlock->holder++;
+  TRACE(TRACE_RUNNABLE, next_in_line->tid, rwlock);
+  waiter_wake(next_in_line);
+  wake_readers(rwlock);
 }
 
 /**
@@ -197,8 +235,10 @@ void rwlock_unlock(rwlock_t *rwlock)
   assert(rwlock->init);	
   assert(rwlock->holder != 0);
   if (rwlock->holder < 0) {
+    TRACE(TRACE_UNLOCK, rwlock, TRACE_WRITE);
     writer_unlock(rwlock);
   } else {
+    TRACE(TRACE_UNLOCK, rwlock, TRACE_READ);
     reader_unlock(rwlock);
   }
   mutex_unlock(&rwlock->data);
@@ -228,24 +268,15 @@ void rwlock_destroy(rwlock_t *rwlock)
  */
 void rwlock_downgrade(rwlock_t *rwlock)
 {
-  waiting_thr_data_t *next_in_line;	
-  list_ptr entry;
-
   mutex_lock(&rwlock->data);
   assert(rwlock->init);	
   assert(-rwlock->holder == gettid());
+  TRACE(TRACE_UNLOCK, rwlock, TRACE_WRITE);
+  TRACE(TRACE_LOCK, rwlock, TRACE_READ);
   rwlock->holder = 1;
 
   /* Wake up all other waiting readers */
-  entry = list_remv_head(&rwlock->queue);
-  next_in_line = LIST_ENTRY(entry, waiting_thr_data_t, list_entry);
-  while (next_in_line && next_in_line->type == RWLOCK_READ) {
-    next_in_line->about_to_be_runnable = 1;
-    rwlock->holder++;
-    make_runnable(next_in_line->tid);
-    entry = list_remv_head(&rwlock->queue);
-    next_in_line = LIST_ENTRY(entry, waiting_thr_data_t, list_entry);
-  }	
+  wake_readers(rwlock);
 
   mutex_unlock(&rwlock->data);
 }
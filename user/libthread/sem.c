@@ -10,6 +10,7 @@
 #include <mutex.h>      /* mutex_init(), mutex_lock() and mutex_unlock() */
 #include <cond.h>       /* cond_wait() and cond_signal() */
 #include <assert.h>     /* assert() */
+#include "lockprof_internals.h" /* prof_register() and prof_acquired() */
 
 /**
  * @brief Initialize semaphore struct.
@@ -29,6 +30,7 @@ int sem_init(sem_t *sem, int count)
   sem->cnt = count;
   sem->init = 1;
   sem->waiting = 0;
+  prof_register(sem, PROF_SEM, PROF_SITE());
   return 0;
 }
 
@@ -38,15 +40,22 @@ int sem_init(sem_t *sem, int count)
  */
 void sem_wait(sem_t *sem)
 {  
+  unsigned int start = 0;
+  int sleeps = 0;
+
   mutex_lock(&sem->sem_data);
   assert(sem->init);
+  if (sem->cnt <= 0)
+    start = PROF_TICKS();
   while (sem->cnt <= 0) {
     sem->waiting++;
     cond_wait(&sem->none_neg, &sem->sem_data);
+    sleeps++;
   }
   sem->waiting--;
   sem->cnt--;
   mutex_unlock(&sem->sem_data);
+  prof_acquired(sem, PROF_SEM, sleeps, sleeps ? PROF_TICKS() - start : 0);
 }
 
 /**
@@ -0,0 +1,111 @@
+/**
+ * @file seqlock.c
+ * @brief Implementation of the sequence lock APIs specified in
+ *        user/inc/seqlock.h
+ *
+ * The sequence number is only ever changed with atomic_inc(), whose locked
+ * xadd is a full barrier. So all the stores of a writer become visible in
+ * between the two increments, and x86 doesn't reorder loads with other loads,
+ * which is all the readers need.
+ *
+ * @author Zhan Chen (zhanc1)
+ * @author X.D. Zhai (xingdaz)
+ */
+
+/* Public APIs */
+#include <seqlock.h>
+#include <seqlock_type.h>   /* seqlock_t */
+#include <mutex.h>          /* mutex_init(), mutex_lock() and mutex_unlock() */
+#include <syscall.h>        /* yield() */
+#include <assert.h>         /* assert() */
+
+/* Private APIs */
+#include "asm_internals.h"  /* atomic_inc() */
+
+/**
+ * @brief Initialize the sequence lock.
+ * @param sl Pointer to allocated but uninitialized seqlock_t.
+ * @return 0 on success and negative number on error.
+ */
+int seqlock_init(seqlock_t *sl)
+{
+  if (!sl)
+    return -1;
+  if (mutex_init(&sl->writer) < 0)
+    return -2;
+
+  sl->seq = 0;
+  sl->init = 1;
+  return 0;
+}
+
+/**
+ * @brief Deactivates the sequence lock.
+ *
+ * It is illegal to destroy the lock while a writer is holding it.
+ *
+ * @param sl Pointer to initialized seqlock_t.
+ */
+void seqlock_destroy(seqlock_t *sl)
+{
+  mutex_lock(&sl->writer);
+  assert((sl->seq & 1) == 0);
+  sl->init = 0;
+  mutex_unlock(&sl->writer);
+  mutex_destroy(&sl->writer);
+}
+
+/**
+ * @brief Enters the writer critical section.
+ *
+ * Readers that are in the middle of a read will retry from here on.
+ *
+ * @param sl Pointer to initialized seqlock_t.
+ */
+void seqlock_write_lock(seqlock_t *sl)
+{
+  mutex_lock(&sl->writer);
+  assert(sl->init);
+  atomic_inc(&sl->seq);
+}
+
+/**
+ * @brief Leaves the writer critical section.
+ * @param sl Pointer to initialized seqlock_t held by the calling thread.
+ */
+void seqlock_write_unlock(seqlock_t *sl)
+{
+  assert(sl->seq & 1);
+  atomic_inc(&sl->seq);
+  mutex_unlock(&sl->writer);
+}
+
+/**
+ * @brief Starts an optimistic read.
+ *
+ * If a writer is in its critical section there is no point in reading, so
+ * we yield to let it finish.
+ *
+ * @param sl Pointer to initialized seqlock_t.
+ * @return Sequence number to be handed to seqlock_read_retry().
+ */
+int seqlock_read_begin(seqlock_t *sl)
+{
+  int seq;
+
+  assert(sl->init);
+  while ((seq = sl->seq) & 1)
+    yield(-1);
+  return seq;
+}
+
+/**
+ * @brief Checks whether an optimistic read has to be redone.
+ * @param sl Pointer to initialized seqlock_t.
+ * @param seq Value returned by the matching seqlock_read_begin().
+ * @return Non zero if a writer got in the way and the read must be retried.
+ */
+int seqlock_read_retry(seqlock_t *sl, int seq)
+{
+  return sl->seq != seq;
+}
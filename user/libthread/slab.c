@@ -0,0 +1,187 @@
+/**
+ * @file slab.c
+ * @brief Implementation of the slab caches defined in slab.h.
+ *
+ * Every cache has a shared list of free objects behind a mutex, linked
+ * through their first word, and gets more objects by carving up a chunk from
+ * malloc() whenever that list runs dry. On top of that the first SLAB_FRONTS
+ * caches get a front cache in every TCB, see slab_internals.h. A thread
+ * creating and joining threads in a loop keeps handing the same few TCBs
+ * back and forth through its own front cache without taking any lock.
+ *
+ * @author Zhan Chen (zhanc1)
+ * @author X.D. Zhai (xingdaz)
+ */
+
+#include <slab.h>
+#include <stddef.h>           /* NULL */
+#include <malloc.h>           /* malloc() */
+#include <mutex.h>            /* mutex_t, mutex_lock(), and mutex_unlock() */
+#include <syscall.h>          /* PAGE_SIZE */
+#include "asm_internals.h"    /* atomic_add() */
+#include "thr_internals.h"    /* tcb_t and get_tcb() */
+#include "slab_internals.h"   /* slab_mag_t */
+
+/* Bytes of objects carved out of a chunk at once, at least SLAB_MAG_SIZE
+ * objects */
+#define SLAB_CHUNK_SIZE       (2 * PAGE_SIZE)
+
+/* Objects are aligned like malloc() aligns them */
+#define SLAB_ALIGN            8
+
+/**
+ * @brief A slab cache.
+ */
+struct slab {
+  size_t size;      /* Object size, rounded up to SLAB_ALIGN */
+  int per_chunk;    /* Number of objects carved out of each chunk */
+  int front;        /* Index of the front cache in the TCB, -1 if none */
+  mutex_t lock;     /* Lock around free */
+  void *free;       /* Shared list of free objects */
+};
+
+static volatile int next_front = 0;
+static slab_t *fronts[SLAB_FRONTS];   /* Cache each front index belongs to */
+static int fronts_enabled = 0;
+
+/**
+ * @brief Gets the calling thread's front cache for slab.
+ * @return Pointer to the front cache, NULL if there is none.
+ */
+static slab_mag_t *front(slab_t *slab)
+{
+  if (!fronts_enabled || slab->front < 0)
+    return NULL;
+  return &get_tcb()->slab_mags[slab->front];
+}
+
+/**
+ * @brief Carves a new chunk up into free objects.
+ *
+ * Must be called with slab->lock held.
+ *
+ * @return 0 on success, negative if out of memory.
+ */
+static int grow(slab_t *slab)
+{
+  char *chunk;
+  int i;
+
+  if ((chunk = malloc(slab->size * slab->per_chunk)) == NULL)
+    return -1;
+  for (i = 0; i < slab->per_chunk; i++, chunk += slab->size) {
+    *(void **) chunk = slab->free;
+    slab->free = chunk;
+  }
+  return 0;
+}
+
+slab_t *slab_create(size_t size)
+{
+  return slab_create_ex(size, 0);
+}
+
+slab_t *slab_create_ex(size_t size, int per_chunk)
+{
+  slab_t *slab;
+  int front;
+
+  if (size == 0 || per_chunk < 0 || (slab = (slab_t *) malloc(sizeof(slab_t))) == NULL)
+    return NULL;
+  if (mutex_init(&slab->lock) < 0) {
+    free(slab);
+    return NULL;
+  }
+  if (size < sizeof(void *))
+    size = sizeof(void *);
+  slab->size = (size + SLAB_ALIGN - 1) / SLAB_ALIGN * SLAB_ALIGN;
+  slab->per_chunk = SLAB_CHUNK_SIZE / slab->size;
+  if (slab->per_chunk < per_chunk)
+    slab->per_chunk = per_chunk;
+  if (slab->per_chunk < SLAB_MAG_SIZE)
+    slab->per_chunk = SLAB_MAG_SIZE;
+  slab->free = NULL;
+  front = atomic_add(&next_front, 1);
+  slab->front = -1;
+  if (front < SLAB_FRONTS) {
+    fronts[front] = slab;
+    slab->front = front;
+  }
+  return slab;
+}
+
+void *slab_alloc(slab_t *slab)
+{
+  slab_mag_t *mag = front(slab);
+  void *obj;
+
+  if (mag && mag->count > 0)
+    return mag->objs[--mag->count];
+
+  mutex_lock(&slab->lock);
+  if (!slab->free && grow(slab) < 0) {
+    mutex_unlock(&slab->lock);
+    return NULL;
+  }
+  obj = slab->free;
+  slab->free = *(void **) obj;
+
+  /* Take a few more while we are at it */
+  while (mag && mag->count < SLAB_MAG_SIZE / 2 && slab->free) {
+    mag->objs[mag->count++] = slab->free;
+    slab->free = *(void **) slab->free;
+  }
+  mutex_unlock(&slab->lock);
+  return obj;
+}
+
+void slab_free(slab_t *slab, void *obj)
+{
+  slab_mag_t *mag;
+
+  if (!obj)
+    return;
+  mag = front(slab);
+  if (mag && mag->count < SLAB_MAG_SIZE) {
+    mag->objs[mag->count++] = obj;
+    return;
+  }
+
+  /* Front cache is full, make room for the next few as well */
+  mutex_lock(&slab->lock);
+  *(void **) obj = slab->free;
+  slab->free = obj;
+  while (mag && mag->count > SLAB_MAG_SIZE / 2) {
+    obj = mag->objs[--mag->count];
+    *(void **) obj = slab->free;
+    slab->free = obj;
+  }
+  mutex_unlock(&slab->lock);
+}
+
+void slab_enable_fronts(void)
+{
+  fronts_enabled = 1;
+}
+
+void slab_thread_exit(tcb_t *tcb)
+{
+  slab_mag_t *mag;
+  slab_t *slab;
+  void *obj;
+  int i;
+
+  for (i = 0; i < SLAB_FRONTS; i++) {
+    mag = &tcb->slab_mags[i];
+    if (mag->count == 0)
+      continue;
+    slab = fronts[i];
+    mutex_lock(&slab->lock);
+    while (mag->count > 0) {
+      obj = mag->objs[--mag->count];
+      *(void **) obj = slab->free;
+      slab->free = obj;
+    }
+    mutex_unlock(&slab->lock);
+  }
+}
@@ -0,0 +1,46 @@
+/**
+ * @file slab_internals.h
+ * @brief Definitions of the per-thread front caches of the slab caches.
+ * @author Zhan Chen (zhanc1)
+ * @author X.D. Zhai (xingdaz)
+ */
+
+#ifndef _SLAB_INTERNALS_H_
+#define _SLAB_INTERNALS_H_
+
+/* Number of caches that get a front cache in every thread */
+#define SLAB_FRONTS           4
+
+/* Number of free objects a front cache holds */
+#define SLAB_MAG_SIZE         8
+
+/**
+ * @brief A thread's front cache for one slab cache.
+ *
+ * Only ever touched by the thread it belongs to, so it needs no lock. Half
+ * of it goes back to the shared part of the cache when it overflows, and
+ * half of it is refilled at once when it runs dry.
+ */
+typedef struct slab_mag {
+  int count;                  /* Number of objects in objs */
+  void *objs[SLAB_MAG_SIZE];  /* Free objects, the last one is handed out
+                                 first */
+} slab_mag_t;
+
+struct _tcb;
+
+/**
+ * @brief Lets slab_alloc() and slab_free() use the front caches.
+ *
+ * Called once thr_init() has made get_tcb() work, before that everything
+ * goes through the shared part of the caches.
+ */
+void slab_enable_fronts(void);
+
+/**
+ * @brief Empties the front caches of an exiting thread.
+ * @param tcb Pointer to the calling thread's TCB.
+ */
+void slab_thread_exit(struct _tcb *tcb);
+
+#endif /* _SLAB_INTERNALS_H_ */
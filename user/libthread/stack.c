@@ -0,0 +1,164 @@
+/**
+ * @file stack.c
+ * @brief Implementation of the peer thread stack allocator defined in
+ *        stack_internals.h
+ *
+ * Stacks are never returned to the heap. A stack that is given back goes
+ * into a small cache with its pages still committed, so a new thread of the
+ * same size starts out warm. Once the cache is full, stacks have all their
+ * pages removed and wait on the free list until a thread of the same size
+ * needs one, so memory is only ever held by live threads and the cache.
+ *
+ * Pages are removed with the same granularity they were added with, since
+ * remove_pages() only takes whole new_pages() allocations: the first one
+ * covers the top page of the stack and the exception stack, each one after
+ * that whatever the page fault handler committed for one fault. Those are
+ * not kept track of, every page is tried instead and remove_pages() turns
+ * down the ones that don't start an allocation.
+ *
+ * @author Zhan Chen (zhanc1)
+ * @author X.D. Zhai (xingdaz)
+ */
+
+/* Public APIs */
+#include <syscall.h>          /* PAGE_SIZE, new_pages(), remove_pages() */
+#include <stddef.h>           /* NULL */
+#include <malloc.h>           /* malloc() and free() */
+#include <mutex.h>            /* mutex_init(), mutex_lock(), mutex_unlock() */
+#include <list.h>             /* list_t */
+
+/* Private APIs */
+#include "malloc_internals.h" /* reserve_range() and limit_heap() */
+#include "stack_internals.h"  /* thr_stack_t */
+
+/**
+ * @brief Global stack allocator state.
+ */
+static struct {
+  mutex_t lock;       /* Lock around the lists */
+  list_t cache;       /* Dummy head of the committed stacks */
+  int cache_count;    /* Number of stacks in cache */
+  list_t free;        /* Dummy head of the stacks with nothing committed */
+} stacks;
+
+int stack_init(void *ceiling)
+{
+  if (mutex_init(&stacks.lock) < 0)
+    return -1;
+  if (limit_heap(ceiling) < 0)
+    return -2;
+
+  list_init(&stacks.cache);
+  list_init(&stacks.free);
+  stacks.cache_count = 0;
+  return 0;
+}
+
+/**
+ * @brief Takes a stack of the given size out of a list.
+ *
+ * Must be called with stacks.lock held.
+ *
+ * @param list Dummy head of the list to search.
+ * @param size Size of the stack.
+ * @return Pointer to the stack, NULL if there is none.
+ */
+static thr_stack_t *take(list_t *list, unsigned int size)
+{
+  list_ptr entry;
+  thr_stack_t *stack;
+
+  for (entry = list->next; entry != list; entry = entry->next) {
+    stack = LIST_ENTRY(entry, thr_stack_t, stack_entry);
+    if (stack->size == size) {
+      list_remv(entry);
+      return stack;
+    }
+  }
+  return NULL;
+}
+
+/**
+ * @brief Commits the top page of the stack and the exception stack.
+ * @param stack Pointer to a stack with nothing committed.
+ * @return 0 on success, negative number on error.
+ */
+static int commit(thr_stack_t *stack)
+{
+  char *top_page = (char *) stack->pf.stack_high - PAGE_SIZE;
+
+  if (new_pages(top_page, 2 * PAGE_SIZE) < 0)
+    return -1;
+  stack->pf.stack_low = top_page;
+  return 0;
+}
+
+/**
+ * @brief Removes every page of the stack, in the units they were added in.
+ * @param stack Pointer to a stack with its top page committed.
+ */
+static void decommit(thr_stack_t *stack)
+{
+  char *page = stack->pf.stack_low;
+  char *top_page = (char *) stack->pf.stack_high - PAGE_SIZE;
+
+  for (; page < top_page; page += PAGE_SIZE)
+    remove_pages(page);
+  remove_pages(top_page);
+  stack->pf.stack_low = stack->pf.stack_high;
+}
+
+thr_stack_t *stack_get(unsigned int size)
+{
+  thr_stack_t *stack;
+
+  mutex_lock(&stacks.lock);
+  if ((stack = take(&stacks.cache, size)) != NULL) {
+    stacks.cache_count--;
+    mutex_unlock(&stacks.lock);
+    return stack;
+  }
+  stack = take(&stacks.free, size);
+  mutex_unlock(&stacks.lock);
+
+  if (!stack) {
+    if ((stack = (thr_stack_t *) malloc(sizeof(thr_stack_t))) == NULL)
+      return NULL;
+    /* One more page on top for the exception stack, one at the bottom for
+     * the guard */
+    if ((stack->low = reserve_range(size + 2 * PAGE_SIZE)) == NULL) {
+      free(stack);
+      return NULL;
+    }
+    stack->size = size;
+    stack->pf.stack_high = (char *) stack->low + PAGE_SIZE + size;
+    stack->pf.stack_low = stack->pf.stack_high;
+    stack->pf.fixed_size = size;
+    stack->pf.esp3 = (char *) stack->pf.stack_high + PAGE_SIZE;
+  }
+
+  if (commit(stack) < 0) {
+    mutex_lock(&stacks.lock);
+    list_add_tail(&stacks.free, &stack->stack_entry);
+    mutex_unlock(&stacks.lock);
+    return NULL;
+  }
+  return stack;
+}
+
+void stack_put(thr_stack_t *stack)
+{
+  mutex_lock(&stacks.lock);
+  if (stacks.cache_count < STACK_CACHE_SIZE) {
+    stacks.cache_count++;
+    list_add_tail(&stacks.cache, &stack->stack_entry);
+    mutex_unlock(&stacks.lock);
+    return;
+  }
+  mutex_unlock(&stacks.lock);
+
+  decommit(stack);
+  mutex_lock(&stacks.lock);
+  list_add_tail(&stacks.free, &stack->stack_entry);
+  mutex_unlock(&stacks.lock);
+}
@@ -0,0 +1,73 @@
+/**
+ * @file stack_internals.h
+ * @brief Definitions of the peer thread stack allocator.
+ * @author Zhan Chen (zhanc1)
+ * @author X.D. Zhai (xingdaz)
+ */
+
+#ifndef _STACK_INTERNALS_H_
+#define _STACK_INTERNALS_H_
+
+#include <list.h>             /* list_t */
+#include "swexn_handler.h"    /* pagefault_handler_arg_t */
+
+/* Number of stacks of exited threads kept committed for new threads */
+#define STACK_CACHE_SIZE      16
+
+/**
+ * @brief A peer thread stack.
+ *
+ * Each stack is a range of address space reserved above the heap. The top
+ * page of the range is the thread's exception stack, right below it is the
+ * stack proper, of which only the top page is committed up front. The rest
+ * is committed by the page fault handler, which gets pf as its argument,
+ * down to whatever page faulted, up to size bytes. The bottom page of the range is a
+ * guard that is never mapped, so running off the end of the stack faults
+ * instead of scribbling over the exception stack of the next one down.
+ *
+ *                 Higher Address
+ *              -------------------- <-- pf.esp3
+ *              | exception stack  |
+ *              -------------------- <-- pf.stack_high
+ *              |    committed     |
+ *              -------------------- <-- pf.stack_low
+ *              |                  |
+ *              |   not mapped     |
+ *              |                  |
+ *              --------------------
+ *              |   guard page     |
+ *              -------------------- <-- low
+ *                 Lower Address
+ */
+typedef struct thr_stack {
+  void *low;                  /* Lowest byte of the reserved range */
+  unsigned int size;          /* Size of the stack proper, whole pages */
+  pagefault_handler_arg_t pf; /* Committed part and growth limit */
+  list_t stack_entry;         /* Entry in the cache or the free list */
+} thr_stack_t;
+
+/**
+ * @brief Sets up the stack allocator.
+ *
+ * Stacks are reserved downwards from ceiling, and the heap is kept below
+ * them from here on.
+ *
+ * @param ceiling Highest address a peer stack may take.
+ * @return 0 on success, negative number on error.
+ */
+int stack_init(void *ceiling);
+
+/**
+ * @brief Gets a stack with its top page and exception stack committed.
+ * @param size Size of the stack, multiples of PAGE_SIZE.
+ * @return Pointer to the stack, NULL if out of memory or address space.
+ */
+thr_stack_t *stack_get(unsigned int size);
+
+/**
+ * @brief Gives back a stack no thread is running on anymore.
+ * @param stack Pointer to a stack from stack_get().
+ */
+void stack_put(thr_stack_t *stack);
+
+#endif /* _STACK_INTERNALS_H_ */
@@ -7,8 +7,6 @@
  */
 #include <stdlib.h>         /* panic() */
 #include <syscall.h>        /* swexn() */
-#include <memlib.h>         /* set_brk() */
-#include <simics.h>
 #include "swexn_handler.h"  /* pagefault_handler_arg_t */
 
 /**
@@ -18,53 +16,98 @@
  * it first enters the handler, we assume that the kernel is being reasonable
  * and aligned the stack_low with the page boundary. Afterwards, it will be
  * aligned too because the extension amount is multiples of PAGE_SIZE.
+ *
+ * Until thr_init(), a stack grows one STACK_EXTENSION at a time, for faults
+ * no further than MAX_OFFSET below it. After, every stack has its limit and
+ * the address space down to it is reserved, so a fault anywhere above the
+ * limit commits everything from the faulting page up in one new_pages(),
+ * however large the frame that got it there.
+ *
+ * A fault in the page right below the limit is an overflow. That is what the
+ * guard page below every stack is there to catch, no matter how much of the
+ * stack is committed by then. Anything further down is no stack's business,
+ * say a NULL pointer.
  * 
- * @param stack_low Pointer to current lowest byte of main thread stack.
+ * @param arg Pointer to the faulting thread's pagefault_handler_arg_t.
+ * @param ureg Pointer to register set.
+ * @return 0 if the stack was extended, PF_NOT_STACK if the fault has nothing
+ *         to do with the stack, PF_OVERFLOW if the stack outgrew its limit
+ *         and PF_NO_MEMORY if no new page could be had.
  */
 static int pagefault(void *arg, ureg_t *ureg)
 {
-  void *new_stack_low;
-  unsigned int stack_fixed_size, old_stack_size;
+  char *stack_low, *new_stack_low, *limit;
+  unsigned int stack_fixed_size;
   pagefault_handler_arg_t *root_stack_data;
 
   /* Make sure we can handle the page fault */
   root_stack_data = (pagefault_handler_arg_t *) arg;
   stack_fixed_size = root_stack_data->fixed_size;
+  stack_low = (char *) root_stack_data->stack_low;
 
   /* Failure: non-present fault to indicate possible read/write privilege 
-   * violation, or faulting address not in reasonable range */
-  if (ureg->error_code & 0x1 ||
-      ureg->cr2 >= (unsigned int) root_stack_data->stack_low ||
-      MAX_OFFSET < (unsigned int) root_stack_data->stack_low - ureg->cr2) {
-    panic("Pagefault handler segmentation fault %p\n", (void *)ureg->cr2);
-  }
+   * violation, or faulting address above the stack */
+  if (ureg->error_code & 0x1 || ureg->cr2 >= (unsigned int) stack_low)
+    return PF_NOT_STACK;
 
-  old_stack_size = (char *) root_stack_data->stack_high - 
-    (char *) root_stack_data->stack_low;
-
-  /* Failure: Outgrown the declared stack. Single threaded application won't
-   * run into this problem. Multi-threaded because in thr_init(),
-   * stack_fixed_size will be set to none zero. */
-  if (stack_fixed_size != 0 && old_stack_size >= stack_fixed_size)
-    return -2;
+  if (stack_fixed_size == 0) {
+    /* Failure: faulting address not in reasonable range */
+    if (MAX_OFFSET < (unsigned int) stack_low - ureg->cr2)
+      return PF_NOT_STACK;
+    new_stack_low = stack_low - STACK_EXTENSION;
+  } else {
+    /* Single threaded application won't run into a limit. Multi-threaded
+     * because in thr_init(), stack_fixed_size will be set to none zero. The
+     * root thread's stack may be past it already. */
+    limit = (char *) root_stack_data->stack_high - stack_fixed_size;
+    if (limit > stack_low)
+      limit = stack_low;
+    if (ureg->cr2 < (unsigned int) limit) {
+      /* Failure: Outgrown the declared stack, into the guard page */
+      if (ureg->cr2 >= (unsigned int) (limit - PAGE_SIZE))
+        return PF_OVERFLOW;
+      /* Failure: faulting address nowhere near the stack */
+      return PF_NOT_STACK;
+    }
+    new_stack_low = (char *) (ureg->cr2 & ~(PAGE_SIZE - 1));
+  }
 
-  new_stack_low = (void *)((char *) root_stack_data->stack_low - 
-      STACK_EXTENSION);
   /* Failure: Can't allocate new pages. */
-  if (new_pages(new_stack_low, STACK_EXTENSION) < 0)
-    return -3;
+  if (new_pages(new_stack_low, stack_low - new_stack_low) < 0)
+    return PF_NO_MEMORY;
 
   /* Sucess: Update global stack data */
   root_stack_data->stack_low = new_stack_low;
   return 0;
 }
 
+/**
+ * @brief Kills the task with a message saying which thread died of what.
+ * @param pagefault_ret What pagefault() made of the exception, PF_NOT_STACK
+ *        if it wasn't a page fault.
+ * @param ureg Pointer to register set.
+ */
+static void report(int pagefault_ret, ureg_t *ureg)
+{
+  switch (pagefault_ret) {
+    case PF_OVERFLOW:
+      panic("Thread %d overflowed its stack at %p, eip %p\n", gettid(),
+            (void *) ureg->cr2, (void *) ureg->eip);
+    case PF_NO_MEMORY:
+      panic("Thread %d out of memory growing its stack at %p, eip %p\n",
+            gettid(), (void *) ureg->cr2, (void *) ureg->eip);
+    default:
+      panic("Thread %d exception %d at %p, eip %p\n", gettid(),
+            ureg->cause, (void *) ureg->cr2, (void *) ureg->eip);
+  }
+}
+
 void root_thr_swexn_handler(void *arg, ureg_t *ureg) 
 {
   /* Important: arg here is an opaque data type. When this handler was
    * registered by install_autostack(), root_pagefault_arg was passed in. It 
    * is a global variable, points to a pagefault_handler_arg_t on the heap. */
-  int pagefault_ret = -1;
+  int pagefault_ret = PF_NOT_STACK;
   if (ureg->cause == SWEXN_CAUSE_PAGEFAULT) {
     pagefault_ret = pagefault(arg, ureg); 
   }
@@ -73,5 +116,23 @@ void root_thr_swexn_handler(void *arg, ureg_t *ureg)
   if (pagefault_ret >= 0)
     swexn(root_esp3, root_thr_swexn_handler, arg, ureg);
   else
-    panic("Root thread pagefault handler exception.\n");
+    report(pagefault_ret, ureg);
+}
+
+void peer_thr_swexn_handler(void *arg, ureg_t *ureg)
+{
+  /* Any kind of other software exception will cause the whole task to
+   * vanish. The error is, most of the time, irrecoverable b/c the thread
+   * could be holding locks, in the middle of modifying shared data structure
+   * or working on to produce a result that other thread may be depending
+   * on. */
+  pagefault_handler_arg_t *stack_data = (pagefault_handler_arg_t *) arg;
+  int pagefault_ret = PF_NOT_STACK;
+
+  if (stack_data && ureg->cause == SWEXN_CAUSE_PAGEFAULT)
+    pagefault_ret = pagefault(arg, ureg);
+  if (pagefault_ret >= 0)
+    swexn(stack_data->esp3, peer_thr_swexn_handler, arg, ureg);
+  else
+    report(pagefault_ret, ureg);
 }
@@ -10,10 +10,14 @@
 
 #include <ureg.h> /* ureg_t */
 
-#define ESP3_OFFSET         2
-#define SWEXN_STACK_SIZE    64
+#define SWEXN_STACK_SIZE    PAGE_SIZE
 #define STACK_EXTENSION     PAGE_SIZE
-#define MAX_OFFSET          (16 * PAGE_SIZE)
+#define MAX_OFFSET          (16 * PAGE_SIZE) /* Before thr_init() */
+
+/* What the page fault handler made of a fault it couldn't fix */
+#define PF_NOT_STACK        (-1)  /* Not a stack access */
+#define PF_OVERFLOW         (-2)  /* Stack outgrew its limit */
+#define PF_NO_MEMORY        (-3)  /* new_pages() failed */
 
 /**
  * @brief Structure that holds the data for root thread's pagefault handler's
@@ -27,9 +31,10 @@ typedef struct pagefault_handler_arg {
   unsigned int fixed_size;  /* Initialized to zero to indicate auto growth. 
                                None zero to inidcate thr_init() has been 
                                called and there is a limit to stack growth */
+  void *esp3;               /* Exception stack the handler is registered on */
 } pagefault_handler_arg_t;
 
-/* Global pointer to swexn handler's stack pointer */
+/* Global pointer to the top of root thread's swexn handler's stack */
 void *root_esp3;
 
 /* Global pointer to root thread's page fault handler argument */
@@ -42,4 +47,17 @@ pagefault_handler_arg_t *root_pagefault_arg;
  */
 void root_thr_swexn_handler(void *arg, ureg_t *ureg);
 
+/**
+ * @brief Peer thread's software exception handler.
+ *
+ * Grows the thread's stack on page faults below it, just like the root
+ * thread's, anything else kills the whole task with a message naming the
+ * thread, the faulting address and the instruction.
+ *
+ * @param arg Pointer to the thread's pagefault_handler_arg_t, NULL if its
+ *        stack can't grow.
+ * @param ureg Pointer to register set.
+ */
+void peer_thr_swexn_handler(void *arg, ureg_t *ureg);
+
 #endif /* _SWEXN_HANDLER_H_ */
@@ -10,6 +10,9 @@
 
 #include <list.h>   /* list_t */
 #include <cond.h>   /* cond_t */
+#include <syscall.h> /* deschedule(), make_runnable() and yield() */
+#include "slab_internals.h" /* slab_mag_t */
+#include <stdout.h> /* stdout_buf_t */
 
 #define STATUS_RUNNING        0
 #define STATUS_RUNNABLE       1
@@ -20,6 +23,12 @@
 /* Global pointer to _main()'s ebp */
 void **_main_ebp;
 
+struct ebr_record;
+struct thr_stack;
+struct arena;
+struct trace_ring;
+struct fiber_worker;
+
 /**
  * @brief Thread Control Block.
  */
@@ -32,6 +41,19 @@ typedef struct _tcb {
   list_t tcb_entry;   /* List entry used to find the previous and next tcb */
   void *stack_high;   /* Limits of the stack */
   void *stack_low;
+  struct thr_stack *stack; /* Stack from stack_get(), NULL if it isn't ours */
+  void *stack_alloc;  /* Block to free along with the TCB */
+  int detached;       /* Reclaimed after exit without being joined */
+  volatile int vanished; /* Set by the thread once it stops touching its stack
+                            and TCB on its way out */
+  volatile int started; /* Set by the invoking thread once it is done waking
+                           the thread up in thr_create() */
+  struct ebr_record *ebr; /* Epoch record, allocated on first ebr_enter() */
+  slab_mag_t slab_mags[SLAB_FRONTS]; /* Front caches of the slab caches */
+  struct arena *arena; /* Malloc arena, picked on first malloc() */
+  struct trace_ring *trace; /* Event ring, taken on first event */
+  struct fiber_worker *fiber; /* Set if it is a fiber worker, see fiber.c */
+  stdout_buf_t out;   /* What printf() and co. haven't printed yet */
 } tcb_t;
 
 /**
@@ -46,10 +68,37 @@ typedef struct waiting_thr_data {
    * deschedule itself will atomically check this variable. If it is none
    * zero, i.e. it will runnable soon, then it will not deschedule itself. */
   int about_to_be_runnable;
+  /* Set once the waker is done with make_runnable(). Till then the waiting
+   * thread doesn't go on, lest the make_runnable() hit a later deschedule()
+   * of it instead. */
+  volatile int woken;
   list_t list_entry;
   int type; /* Only applicable to rwlock, indicates reader of writer */
 } waiting_thr_data_t;
 
+/**
+ * @brief Puts the calling thread to sleep until waiter_wake() on its data.
+ * @param data Waiting data of the calling thread, already in some queue.
+ */
+static inline void waiter_sleep(waiting_thr_data_t *data)
+{
+  deschedule(&data->about_to_be_runnable);
+  while (!data->woken)
+    yield(-1);
+}
+
+/**
+ * @brief Wakes up a thread from waiter_sleep(), its data already off the
+ *        queue. The data is gone once this returns.
+ * @param data Waiting data of the thread to wake up.
+ */
+static inline void waiter_wake(waiting_thr_data_t *data)
+{
+  data->about_to_be_runnable = 1;
+  make_runnable(data->tid);
+  data->woken = 1;
+}
+
 /**
  * @brief System call wrapper for thread_fork.
  * @param esp Top of the peer thread stack.
@@ -68,6 +117,37 @@ int thread_fork_wrapper(void *esp, tcb_t *tcb);
  */
 void peer_thread_init(tcb_t *tcb);
 
+/**
+ * @brief Backtrace through %ebp to get to pointer to TCB.
+ *
+ * Only valid after thr_init() has been called.
+ *
+ * @return Pointer to the calling thread's TCB.
+ */
+tcb_t *get_tcb();
+
+/**
+ * @brief Sets *vanished and traps into vanish() without using the stack.
+ *
+ * As soon as *vanished is set some other thread may free the stack and the
+ * TCB of the calling thread, so nothing after the store may touch memory.
+ *
+ * @param vanished Pointer to the vanished flag in the calling thread's TCB.
+ */
+void thread_vanish(volatile int *vanished);
+
+/**
+ * @brief Saves the callee saved registers on the stack, the stack pointer
+ *        in *save_esp, and goes on with the context saved at esp.
+ *
+ * Returns once some other fiber_switch() goes back to *save_esp.
+ *
+ * @param save_esp Where to save the calling context.
+ * @param esp Context to switch to, saved by fiber_switch() or laid out as
+ *        in fiber.c.
+ */
+void fiber_switch(void **save_esp, void *esp);
+
 /**
  * @brief Default return point. 
  */
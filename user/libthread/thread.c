@@ -5,12 +5,13 @@
  * Here is the life cycle of a thread, from creation, to exiting, and to 
  * joining.
  *
- * 1. Malloc space for stack and TCB. Size of the stack is rounded up to 
- *    multiples of `PAGE_SIZE`. `stack_high` is aligned to 4 byte. Though 
- *    highly unlikely, there might be some unused space as padding before TCB
- *    as a result of the alignment. That will only happen if page size is not
- *    multiples of 2 in which case `malloc()` doesn't return 4 byte aligned 
- *    address.
+ * 1. Take a TCB from its slab cache and get a stack from `stack_get()`, see
+ *    `stack.c`.
+ *    Size of the stack is rounded up to multiples of `PAGE_SIZE`, and only
+ *    its top page is committed. `stack_high` is aligned to 4 byte, which
+ *    only makes a difference for stacks provided by the caller. The TCB is
+ *    drawn on top of the stack below, though it can live anywhere, the
+ *    `%ebp` chain is what leads to it.
  * 2. Populate the data field in TCB.
  * 3. Setup calling stack for `thread_fork_wrapper()`. Please reference
  *    `asm.S`. When in `thread_fork_wrapper()`, and before 
@@ -146,8 +147,12 @@
  *     it can start looking for that particular TID starting from the head
  *     entry located in the shared gstate structure. When found, it will
  *     use the offset to locate the first byte of TCB and access the ret of
- *     that thread. Lastly, it will free the TCB, completely cleans up the
- *     joined thread's mess.
+ *     that thread. Lastly, once the thread has set its vanished flag on the
+ *     way into `vanish()`, it will free the stack and the TCB, completely
+ *     cleans up the joined thread's mess. Detached threads are cleaned up
+ *     the same way by the next `thr_create_ex()` or `thr_exit()`. A few
+ *     stacks are kept in a cache along with their TCB for the next threads
+ *     of the same stack size.
  *
  * @author Zhan Chen (zhanc1)
  * @author X.D. Zhai (xingdaz)
@@ -158,16 +163,24 @@
 #include <syscall.h>          /* PAGE_SIZE, swexn(), panic() */
 #include <stddef.h>           /* NULL */
 #include <assert.h>           /* assert() */
-#include <malloc.h>           /* malloc() */
 #include <cond.h>             /* cond_t, cond_wait(), and cond_signal() */
 #include <list.h>             /* list_t */
 #include <mutex.h>            /* mutex_t, mutex_lock(), and mutex_unlock() */
+#include <thread_ex.h>        /* thr_attr_t and thr_create_ex() */
+#include <slab.h>             /* slab_t, slab_alloc() and slab_free() */
+#include <stdout.h>           /* stdout_set_hook() and stdout_flush() */
 
 /* Private APIs */
-#include "malloc_internals.h" /* double_malloc() */
 #include "thr_internals.h"    /* tcb_t, thread_fork_wrapper(), 
                                  peer_thread_init(), and _main_ebp */
-#include "swexn_handler.h"    /* root_pagefault_arg */
+#include "swexn_handler.h"    /* root_pagefault_arg and
+                                 peer_thr_swexn_handler() */
+#include "ebr_internals.h"    /* ebr_init() and ebr_thread_exit() */
+#include "stack_internals.h"  /* stack_init(), stack_get() and stack_put() */
+#include "slab_internals.h"   /* slab_enable_fronts() and slab_thread_exit() */
+#include "malloc_internals.h" /* malloc_enable_arenas() */
+#include "trace_internals.h"  /* TRACE(), trace_enable() and
+                                 trace_thread_exit() */
 
 /**
  * @brief Global data structure root thread keeps.
@@ -175,31 +188,19 @@
 struct {
   unsigned int stack_size;  /* Declared stack size for each peer thread */
   list_t tcb_list;          /* Dummy head into the list of TCB  */
+  list_t detached_list;     /* Exited detached threads yet to be reclaimed */
   mutex_t tcb_lock;         /* Lock to this data strucure */
   int root_tid;             /* Root thread's TID */
+  slab_t *tcb_slab;         /* Cache of TCBs */
+  slab_t *exn_stack_slab;   /* Cache of exception stacks for threads running
+                               on a stack provided by the caller */
 } gstate;
 
-/**
- * @brief Exception handler for each peer thread.
- *
- * Any kind of software exception will cause the whole task to vanish. The 
- * error is, most of the time, irrecoverable b/c the thread could be holding 
- * locks, in the middle of modifying shared data structure or working on to 
- * produce a result that other thread may be depending on. 
- *
- * @param arg Pointer to argument structure. Not used here.
- * @param ureg Pointer to ureg structure. Not used here.
- */
-static void peer_thr_swexn_handler(void *arg, ureg_t *ureg)
-{
-  panic("Peer thread encountered general protection fault.\n");
-}
-
 /**
  * @brief Backtrace through %ebp to get to pointer to TCB. 
  * @return Pointer to TCB. Panic if failure.
  */
-static tcb_t *get_tcb() 
+tcb_t *get_tcb() 
 {
   void **ebp;
   ebp = get_ebp();
@@ -212,6 +213,14 @@ static tcb_t *get_tcb()
   return *(tcb_t **)ebp;
 }
 
+/**
+ * @brief Hands stdout.c the buffer of the calling thread.
+ */
+static stdout_buf_t *thread_stdout(void)
+{
+  return &get_tcb()->out;
+}
+
 /**
  * @brief If a thread doesn't call thr_exit(), it will eventually land here.
  * @param Never returns.
@@ -228,16 +237,25 @@ void default_exit(void *ret)
  *
  * New thread deschedule's itself first, waiting for its TID to be filled in
  * by the invoking thread. Upon wake up, it registers an exception handler 
- * that kills the whole task if any kind of software exception is encountered
- * in the future. 
+ * that grows its stack on demand and kills the whole task if any other kind
+ * of software exception is encountered in the future. 
  *
  * @param tcb Pointer to its TCB.
  */
 void peer_thread_init(tcb_t *tcb) {
-  void *handler_esp3;
+  int ret;
   deschedule(&tcb->tid);
-  handler_esp3 = malloc(SWEXN_STACK_SIZE + ESP3_OFFSET);
-  if (swexn(handler_esp3, peer_thr_swexn_handler, NULL, NULL) < 0)
+  /* Not waiting for thr_create() to be done with make_runnable() could let
+   * it wake us up from some later deschedule() instead */
+  while (!tcb->started)
+    yield(-1);
+  if (tcb->stack)
+    ret = swexn(tcb->stack->pf.esp3, peer_thr_swexn_handler,
+                &tcb->stack->pf, NULL);
+  else
+    ret = swexn((char *) tcb->stack_alloc + SWEXN_STACK_SIZE,
+                peer_thr_swexn_handler, NULL, NULL);
+  if (ret < 0)
     thr_exit((void *) -1);
 }
 
@@ -309,17 +327,34 @@ void peer_thread_init(tcb_t *tcb) {
  */
 int thr_init(unsigned int size) {
   void **ebp;
+  char *ceiling;
+  int i;
 
   /* Quit f***ing w/ me */
   if (!size)
     return -1;
   if(mutex_init(&gstate.tcb_lock) < 0)
     return -2;
+  if(ebr_init() < 0)
+    return -5;
+
+  /* Peer stacks go right below the furthest root thread's stack may grow,
+   * with a page in between */
+  ceiling = (char *) root_pagefault_arg->stack_high -
+    (size + PAGE_SIZE - 1) / PAGE_SIZE * PAGE_SIZE;
+  if (ceiling > (char *) root_pagefault_arg->stack_low)
+    ceiling = root_pagefault_arg->stack_low;
+  if (stack_init(ceiling - PAGE_SIZE) < 0)
+    return -6;
+  if ((gstate.tcb_slab = slab_create(sizeof(tcb_t))) == NULL ||
+      (gstate.exn_stack_slab = slab_create(SWEXN_STACK_SIZE)) == NULL)
+    return -3;
   gstate.stack_size = size;
   list_init(&gstate.tcb_list);
+  list_init(&gstate.detached_list);
 
   /* Insert the root thread's TCB into the list */
-  tcb_t *root_tcb = (tcb_t *) malloc(sizeof(tcb_t));
+  tcb_t *root_tcb = (tcb_t *) slab_alloc(gstate.tcb_slab);
   if(root_tcb == NULL)
     return -3;
   if(cond_init(&root_tcb->exited) < 0)
@@ -334,6 +369,19 @@ int thr_init(unsigned int size) {
   root_tcb->joined = FALSE;
   root_tcb->status = STATUS_RUNNING;
   root_tcb->stack_low = root_tcb;
+  root_tcb->stack = NULL;
+  root_tcb->stack_alloc = NULL;
+  root_tcb->detached = FALSE;
+  root_tcb->vanished = 0;
+  root_tcb->started = 1;
+  root_tcb->ebr = NULL;
+  for (i = 0; i < SLAB_FRONTS; i++)
+    root_tcb->slab_mags[i].count = 0;
+  root_tcb->arena = NULL;
+  root_tcb->trace = NULL;
+  root_tcb->fiber = NULL;
+  root_tcb->out.len = 0;
+  root_tcb->out.lines = 0;
   list_init(&root_tcb->tcb_entry);
   list_add_tail(&gstate.tcb_list, &root_tcb->tcb_entry);
 
@@ -345,6 +393,145 @@ int thr_init(unsigned int size) {
   *(ebp++) = root_tcb;
   *(ebp) = default_exit_entry;
 
+  /* get_tcb() works from here on */
+  slab_enable_fronts();
+  malloc_enable_arenas();
+  trace_enable();
+  stdout_set_hook(thread_stdout);
+  return 0;
+}
+
+/**
+ * @brief Frees the stack and the TCB of a thread that has vanished.
+ *
+ * The thread sets its vanished flag right before the trap, from then on it
+ * doesn't touch either of them anymore. Yielding to it gets it there sooner.
+ *
+ * @param tcb Pointer to the TCB of an exited thread, no longer in any list.
+ */
+static void reclaim_thread(tcb_t *tcb)
+{
+  while (!tcb->vanished)
+    yield(tcb->tid);
+  if (tcb->stack)
+    stack_put(tcb->stack);
+  slab_free(gstate.exn_stack_slab, tcb->stack_alloc);
+  slab_free(gstate.tcb_slab, tcb);
+}
+
+/**
+ * @brief Looks up the TCB of a thread in the list of TCBs.
+ *
+ * Must be called with tcb_lock held.
+ *
+ * @param tid tid of the thread.
+ * @return Pointer to the TCB, NULL if not found.
+ */
+static tcb_t *find_tcb(int tid)
+{
+  list_ptr entry;
+  tcb_t *tcb;
+
+  for (entry = gstate.tcb_list.next; entry != &gstate.tcb_list;
+       entry = entry->next) {
+    tcb = LIST_ENTRY(entry, tcb_t, tcb_entry);
+    if (tcb->tid == tid)
+      return tcb;
+  }
+  return NULL;
+}
+
+/**
+ * @brief Reclaims every detached thread that has vanished by now.
+ */
+static void reap_detached(void)
+{
+  list_t done;
+  list_ptr entry, next;
+  tcb_t *tcb;
+
+  list_init(&done);
+  mutex_lock(&gstate.tcb_lock);
+  for (entry = gstate.detached_list.next; entry != &gstate.detached_list;
+       entry = next) {
+    next = entry->next;
+    tcb = LIST_ENTRY(entry, tcb_t, tcb_entry);
+    if (tcb->vanished)
+      list_add_tail(&done, list_remv(entry));
+  }
+  mutex_unlock(&gstate.tcb_lock);
+
+  while ((entry = list_remv_head(&done)) != NULL)
+    reclaim_thread(LIST_ENTRY(entry, tcb_t, tcb_entry));
+}
+
+/**
+ * @brief Fills in the default attributes.
+ *
+ * The defaults give the same thread thr_create() would: a joinable thread
+ * with a library allocated stack of the size given to thr_init().
+ *
+ * @param attr Pointer to attributes to be initialized.
+ * @return 0 on success, negative number on error.
+ */
+int thr_attr_init(thr_attr_t *attr)
+{
+  if (!attr)
+    return -1;
+
+  attr->stack_size = 0;
+  attr->stack = NULL;
+  attr->detached = FALSE;
+  return 0;
+}
+
+/**
+ * @brief Sets the size of the stack the library allocates for the thread.
+ * @param attr Pointer to initialized attributes.
+ * @param size Stack size in bytes, rounded up to multiples of PAGE_SIZE.
+ * @return 0 on success, negative number on error.
+ */
+int thr_attr_setstacksize(thr_attr_t *attr, unsigned int size)
+{
+  if (!attr || !size)
+    return -1;
+
+  attr->stack_size = size;
+  attr->stack = NULL;
+  return 0;
+}
+
+/**
+ * @brief Makes the thread run on a stack provided by the caller.
+ * @param attr Pointer to initialized attributes.
+ * @param stack Lowest byte of the stack.
+ * @param size Size of the stack in bytes, at least THR_MIN_STACK_SIZE.
+ * @return 0 on success, negative number on error.
+ */
+int thr_attr_setstack(thr_attr_t *attr, void *stack, unsigned int size)
+{
+  if (!attr || !stack)
+    return -1;
+  if (size < THR_MIN_STACK_SIZE)
+    return -2;
+
+  attr->stack_size = size;
+  attr->stack = stack;
+  return 0;
+}
+
+/**
+ * @brief Chooses whether the thread is reclaimed without being joined.
+ * @param attr Pointer to initialized attributes.
+ * @param detached Non zero for a detached thread.
+ * @return 0 on success, negative number on error.
+ */
+int thr_attr_setdetached(thr_attr_t *attr, int detached)
+{
+  if (!attr)
+    return -1;
+
+  attr->detached = detached ? TRUE : FALSE;
   return 0;
 }
 
@@ -355,24 +542,66 @@ int thr_init(unsigned int size) {
  * @return New thread's TID.
  */
 int thr_create(void *(*func)(void *), void *args) {
+  return thr_create_ex(func, args, NULL);
+}
+
+/**
+ * @brief Creates a new thread to run func with the given attributes.
+ *
+ * With a library allocated stack the TCB is allocated right along with it,
+ * a caller provided stack gets a TCB of its own.
+ *
+ * @param func Pointer to the thread function body.
+ * @param args Opaque data type.
+ * @param attr Pointer to initialized attributes, NULL for the defaults.
+ * @return New thread's TID, negative number on error.
+ */
+int thr_create_ex(void *(*func)(void *), void *args, thr_attr_t *attr) {
   unsigned int stack_size;
-  int thr_tid;
+  int thr_tid, i;
   void *stack_low, *stack_high, *thr_esp;
   tcb_t *thr_tcb;
+  thr_attr_t defaults;
 
   /* Validate input */
   if (!func)
     return -1;
+  if (!attr) {
+    thr_attr_init(&defaults);
+    attr = &defaults;
+  }
 
-  /* Round up stack_size to to be multiples of PAGE_SIZE */ 
-  stack_size = (gstate.stack_size + PAGE_SIZE - 1) / (PAGE_SIZE) * PAGE_SIZE;
+  /* Make the memory of detached threads that are gone available again */
+  reap_detached();
 
-  /* Double malloc gurantees TCB will be on top of the stack cause they are
-   * invoked in the same critical section. */
-  if (double_malloc((void *) &stack_low, stack_size, 
-        (void *) &thr_tcb, sizeof(tcb_t)) < 0)
+  if ((thr_tcb = (tcb_t *) slab_alloc(gstate.tcb_slab)) == NULL)
     return -2;
 
+  if (attr->stack) {
+    /* Can't grow a stack that isn't ours, the exception handler only gets
+     * a stack to panic() on */
+    stack_size = attr->stack_size;
+    stack_low = attr->stack;
+    thr_tcb->stack = NULL;
+    if ((thr_tcb->stack_alloc = slab_alloc(gstate.exn_stack_slab)) == NULL) {
+      slab_free(gstate.tcb_slab, thr_tcb);
+      return -2;
+    }
+  } else {
+    stack_size = attr->stack_size ? attr->stack_size : gstate.stack_size;
+
+    /* Round up stack_size to to be multiples of PAGE_SIZE */ 
+    stack_size = (stack_size + PAGE_SIZE - 1) / (PAGE_SIZE) * PAGE_SIZE;
+
+    /* Only the top page is committed, the rest on demand */
+    if ((thr_tcb->stack = stack_get(stack_size)) == NULL) {
+      slab_free(gstate.tcb_slab, thr_tcb);
+      return -2;
+    }
+    stack_low = (char *) thr_tcb->stack->pf.stack_high - stack_size;
+    thr_tcb->stack_alloc = NULL;
+  }
+
   /* Peer thread's %esp has to be 4 byte aligned */
   stack_high = (void *)((int) ((char *) stack_low + stack_size) & 
       STACK_ALIGNMENT_MASK);
@@ -381,14 +610,31 @@ int thr_create(void *(*func)(void *), void *args) {
   /* Populate peer threat's TCB */
   /* We are assuming that we will not get tid 0. Therefore, we can use it as 
    * an indicator to see if it is safe to deschedule itself. */
-  if (cond_init(&thr_tcb->exited) < 0)
+  if (cond_init(&thr_tcb->exited) < 0) {
+    if (thr_tcb->stack)
+      stack_put(thr_tcb->stack);
+    slab_free(gstate.exn_stack_slab, thr_tcb->stack_alloc);
+    slab_free(gstate.tcb_slab, thr_tcb);
     return -3;
+  }
   thr_tcb->tid = 0; 
   thr_tcb->status = STATUS_RUNNING;
-  thr_tcb->joined = FALSE;
+  thr_tcb->detached = attr->detached;
+  /* Nobody gets to join a detached thread */
+  thr_tcb->joined = attr->detached;
+  thr_tcb->vanished = 0;
+  thr_tcb->started = 0;
   list_init(&thr_tcb->tcb_entry);
   thr_tcb->stack_high = stack_high;
   thr_tcb->stack_low = stack_low;
+  thr_tcb->ebr = NULL;
+  for (i = 0; i < SLAB_FRONTS; i++)
+    thr_tcb->slab_mags[i].count = 0;
+  thr_tcb->arena = NULL;
+  thr_tcb->trace = NULL;
+  thr_tcb->fiber = NULL;
+  thr_tcb->out.len = 0;
+  thr_tcb->out.lines = 0;
 
   /* Prepare the calling stack for thread_fork. */
   thr_esp -= 4;
@@ -403,8 +649,10 @@ int thr_create(void *(*func)(void *), void *args) {
   /* Trap into the system call */
   thr_tid = thread_fork_wrapper(thr_esp, thr_tcb);
   if(thr_tid < 0){
-    free(stack_low);
-    free(thr_tcb);
+    if (thr_tcb->stack)
+      stack_put(thr_tcb->stack);
+    slab_free(gstate.exn_stack_slab, thr_tcb->stack_alloc);
+    slab_free(gstate.tcb_slab, thr_tcb);
     return -4;
   }
 
@@ -415,7 +663,9 @@ int thr_create(void *(*func)(void *), void *args) {
   mutex_lock(&gstate.tcb_lock);
   list_add_tail(&gstate.tcb_list, &thr_tcb->tcb_entry);
   mutex_unlock(&gstate.tcb_lock);
+  TRACE(TRACE_CREATE, thr_tid, 0);
   make_runnable(thr_tid);
+  thr_tcb->started = 1;
   return thr_tid;
 }
 
@@ -427,21 +677,10 @@ int thr_create(void *(*func)(void *), void *args) {
  */
 int thr_join(int tid, void **statusp) {
   tcb_t *tcb;
-  list_ptr entry;
   int ret;
 
-  entry = &gstate.tcb_list;
   mutex_lock(&gstate.tcb_lock);
-
-  for (entry = entry->next; entry != &gstate.tcb_list; entry = entry->next) {
-    tcb = LIST_ENTRY(entry, tcb_t, tcb_entry);
-    if (tcb->tid == tid) {
-      break;
-    }
-    /* Need to make sure that in the event that we haven't found the tid,
-     * tcb is NULL */
-    tcb = NULL;
-  }
+  tcb = find_tcb(tid);
 
   /* Failure: Haven't found it, go home */
   if (!tcb) {
@@ -465,15 +704,54 @@ int thr_join(int tid, void **statusp) {
   if (statusp)
     *statusp = tcb->ret;
 
-  /* Housekeeping */
-  list_remv(entry);
-  free(tcb);
+  /* Housekeeping, the thread may still be on its way to vanish() */
+  list_remv(&tcb->tcb_entry);
+  mutex_unlock(&gstate.tcb_lock);
+  reclaim_thread(tcb);
+  return ret;
 
 Exit:
   mutex_unlock(&gstate.tcb_lock);
   return ret;
 }
 
+/**
+ * @brief Makes a thread reclaim itself when it exits, instead of waiting for
+ *        a thr_join() that will never come.
+ *
+ * If the thread has exited already it is reclaimed right away.
+ *
+ * @param tid tid of the thread to detach.
+ * @return 0 on success, -1 if the thread is detached already or some thread
+ *         is joining it, -2 if there is no such thread.
+ */
+int thr_detach(int tid)
+{
+  tcb_t *tcb;
+
+  mutex_lock(&gstate.tcb_lock);
+  if ((tcb = find_tcb(tid)) == NULL) {
+    mutex_unlock(&gstate.tcb_lock);
+    return -2;
+  }
+  if (tcb->joined == TRUE) {
+    mutex_unlock(&gstate.tcb_lock);
+    return -1;
+  }
+
+  tcb->joined = TRUE;
+  tcb->detached = TRUE;
+  if (tcb->status != STATUS_EXITED) {
+    /* thr_exit() takes care of it */
+    mutex_unlock(&gstate.tcb_lock);
+    return 0;
+  }
+  list_remv(&tcb->tcb_entry);
+  mutex_unlock(&gstate.tcb_lock);
+  reclaim_thread(tcb);
+  return 0;
+}
+
 /**
  * @brief Exits the thread with status.
  *
@@ -487,22 +765,40 @@ void thr_exit(void *status)
 {
   tcb_t *tcb = get_tcb();
 
+  TRACE(TRACE_EXIT, status, 0);
+
+  /* Hand whatever we retired over to the threads that stay around */
+  ebr_thread_exit(tcb);
+
+  /* Keep the detached threads that are gone from piling up */
+  reap_detached();
+
+  /* Whatever is left in our front caches would be lost with the TCB */
+  slab_thread_exit(tcb);
+
+  /* Same for what we printed */
+  stdout_flush(&tcb->out);
+
   mutex_lock(&gstate.tcb_lock);
   assert(tcb != NULL);
   tcb->ret = status;
   tcb->status = STATUS_EXITED;
-  if(tcb->joined == TRUE){
+  if (tcb->detached == TRUE) {
+    /* Nobody is going to join us, whoever creates or exits the next thread
+     * reclaims the TCB and the stack */
+    list_remv(&tcb->tcb_entry);
+    list_add_tail(&gstate.detached_list, &tcb->tcb_entry);
+  } else if(tcb->joined == TRUE){
     cond_signal(&tcb->exited);
   }
   mutex_unlock(&gstate.tcb_lock);
 
-  /* Leave TCB alone because thr_join might be called later. Also, if root
-   * thread gets here, we don't free its stack b/c it is not ours to free */
-  if (tcb->tid != gstate.root_tid)
-    free(tcb->stack_low);
-
-  /* Vanish thyself */
-  vanish();
+  /* We are still running on our stack, so leave it and the TCB alone. They
+   * are freed by the joining thread, or by reap_detached(), once we are
+   * past the point of touching them. Root thread's stack_alloc is NULL b/c
+   * its stack is not ours to free. */
+  trace_thread_exit(tcb);
+  thread_vanish(&tcb->vanished);
 }
 
 /**
@@ -0,0 +1,203 @@
+/**
+ * @file trace.c
+ * @brief Implementation of the event tracer APIs specified in
+ *        user/inc/trace.h
+ *
+ * Rings come out of a fixed pool, so recording an event never allocates and
+ * malloc() can be traced too. A thread takes a ring on its first event and
+ * is the only one to ever write it, which is why there is no lock: the
+ * event goes in first, the head moves after. A ring stays with its thread
+ * past thr_exit() so that the dump still has the thread's last moments.
+ * Only once the pool has run dry are the rings of exited threads handed out
+ * again, emptied. Threads that find none go untraced, and are counted.
+ *
+ * Events only start once thr_init() is done, get_tcb() is needed to find
+ * the ring. The dump is meant for a quiet moment, a thread writing its ring
+ * meanwhile may show up with an event torn in half.
+ *
+ * Without THR_TRACE all that is left is a dump saying so.
+ *
+ * @author Zhan Chen (zhanc1)
+ * @author X.D. Zhai (xingdaz)
+ */
+
+#include <trace.h>
+#include <simics.h>         /* lprintf() */
+#include <syscall.h>        /* get_ticks() */
+#include <stddef.h>         /* NULL */
+#include "trace_internals.h"
+#include "thr_internals.h"  /* tcb_t and get_tcb() */
+#include "asm_internals.h"  /* atomic_add() and cmpxchg() */
+
+#ifdef THR_TRACE
+
+#define TRACE_RINGS   64    /* Threads traced at once */
+#define TRACE_EVENTS  256   /* Events kept per thread, a power of two */
+
+/**
+ * @brief An event, 16 bytes.
+ */
+typedef struct trace_ev {
+  unsigned int ticks;
+  int type;                 /* TRACE_CREATE and friends */
+  unsigned int a, b;
+} trace_ev_t;
+
+/**
+ * @brief Ring of the last events of a thread.
+ */
+typedef struct trace_ring {
+  int tid;                  /* Thread writing it */
+  volatile int exited;      /* Set once the thread is gone for good */
+  volatile unsigned int head; /* Events ever written */
+  trace_ev_t events[TRACE_EVENTS];
+} trace_ring_t;
+
+static trace_ring_t rings[TRACE_RINGS];
+static volatile int next_ring = 0;
+static volatile int untraced = 0;
+static int tracing = 0;
+
+/* What the TCB of a thread that got no ring points to */
+static trace_ring_t no_ring;
+
+/**
+ * @brief Takes a ring for the calling thread.
+ * @return The ring, &no_ring if there is none left.
+ */
+static trace_ring_t *take_ring(tcb_t *tcb)
+{
+  trace_ring_t *ring = NULL;
+  int i;
+
+  if ((i = atomic_add(&next_ring, 1)) < TRACE_RINGS) {
+    ring = &rings[i];
+  } else {
+    for (i = 0; i < TRACE_RINGS; i++) {
+      if (rings[i].exited && cmpxchg((int *) &rings[i].exited, 1, 0)) {
+        ring = &rings[i];
+        break;
+      }
+    }
+    if (!ring) {
+      atomic_add(&untraced, 1);
+      return &no_ring;
+    }
+  }
+  ring->tid = tcb->tid;
+  ring->head = 0;
+  return ring;
+}
+
+/**
+ * @brief Records an event in the calling thread's ring.
+ * @param type TRACE_CREATE and friends.
+ * @param a What the event is about.
+ * @param b More of it.
+ */
+void trace_event(int type, unsigned int a, unsigned int b)
+{
+  trace_ring_t *ring;
+  trace_ev_t *ev;
+  tcb_t *tcb;
+
+  if (!tracing)
+    return;
+  tcb = get_tcb();
+  if ((ring = tcb->trace) == NULL)
+    ring = tcb->trace = take_ring(tcb);
+  if (ring == &no_ring)
+    return;
+
+  ev = &ring->events[ring->head & (TRACE_EVENTS - 1)];
+  ev->ticks = get_ticks();
+  ev->type = type;
+  ev->a = a;
+  ev->b = b;
+  ring->head++;
+}
+
+/**
+ * @brief Starts recording events, once get_tcb() works.
+ */
+void trace_enable(void)
+{
+  tracing = 1;
+}
+
+/**
+ * @brief Lets the ring of an exiting thread go to some later thread, should
+ *        the pool run out.
+ * @param tcb TCB of the calling thread, which doesn't record any more events.
+ */
+void trace_thread_exit(tcb_t *tcb)
+{
+  if (tcb->trace && tcb->trace != &no_ring)
+    tcb->trace->exited = 1;
+}
+
+/**
+ * @brief Counts the events of a type still in the rings.
+ * @param type TRACE_CREATE and friends.
+ * @return How many there are.
+ */
+int trace_count(int type)
+{
+  trace_ring_t *ring;
+  unsigned int i, first;
+  int r, n = 0, used = next_ring;
+
+  if (used > TRACE_RINGS)
+    used = TRACE_RINGS;
+  for (r = 0; r < used; r++) {
+    ring = &rings[r];
+    first = ring->head > TRACE_EVENTS ? ring->head - TRACE_EVENTS : 0;
+    for (i = first; i != ring->head; i++) {
+      if (ring->events[i & (TRACE_EVENTS - 1)].type == type)
+        n++;
+    }
+  }
+  return n;
+}
+
+/**
+ * @brief Prints every ring, oldest events first.
+ * @return Events printed.
+ */
+int trace_dump(void)
+{
+  trace_ring_t *ring;
+  trace_ev_t *ev;
+  unsigned int i, first;
+  int r, n = 0, used = next_ring;
+
+  if (used > TRACE_RINGS)
+    used = TRACE_RINGS;
+  lprintf("trace: %d rings, %d threads untraced\n", used, untraced);
+  for (r = 0; r < used; r++) {
+    ring = &rings[r];
+    first = ring->head > TRACE_EVENTS ? ring->head - TRACE_EVENTS : 0;
+    for (i = first; i != ring->head; i++) {
+      ev = &ring->events[i & (TRACE_EVENTS - 1)];
+      lprintf("trace: %d %u %d %x %x\n", ring->tid, ev->ticks, ev->type,
+              ev->a, ev->b);
+      n++;
+    }
+  }
+  return n;
+}
+
+#else
+
+int trace_dump(void)
+{
+  lprintf("trace: not built in, set THR_TRACE in config.mk\n");
+  return -1;
+}
+
+int trace_count(int type)
+{
+  return -1;
+}
+
+#endif /* THR_TRACE */
@@ -0,0 +1,36 @@
+/**
+ * @file trace_internals.h
+ * @brief Hooks of the event tracer, see trace.c.
+ *
+ * Without THR_TRACE the hooks are empty and cost nothing.
+ *
+ * @author Zhan Chen (zhanc1)
+ * @author X.D. Zhai (xingdaz)
+ */
+
+#ifndef _TRACE_INTERNALS_H_
+#define _TRACE_INTERNALS_H_
+
+#include <trace.h>            /* TRACE_CREATE and friends */
+
+struct _tcb;
+
+#ifdef THR_TRACE
+
+void trace_event(int type, unsigned int a, unsigned int b);
+void trace_enable(void);
+void trace_thread_exit(struct _tcb *tcb);
+
+/** @brief Records an event in the calling thread's ring. */
+#define TRACE(type, a, b) \
+  trace_event((type), (unsigned int) (a), (unsigned int) (b))
+
+#else
+
+#define TRACE(type, a, b)       ((void) 0)
+#define trace_enable()          ((void) 0)
+#define trace_thread_exit(tcb)  ((void) 0)
+
+#endif /* THR_TRACE */
+
+#endif /* _TRACE_INTERNALS_H_ */
@@ -0,0 +1,108 @@
+/**
+ * @file user/progs/arena_test.c
+ * @author Zhan Chen (zhanc1)
+ * @brief Test for the malloc arenas.
+ *
+ * A few threads allocate blocks of all sizes and fill them in. Then every
+ * thread checks, grows and frees the blocks of the next thread, so most
+ * frees and reallocs are of blocks from some other arena. This goes on for
+ * a number of rounds. At the end calloc() has to hand out zeroed memory in
+ * every arena, including memory that went through the remote lists.
+ */
+
+#include <syscall.h>
+#include <simics.h>
+#include <stddef.h>
+#include <malloc.h>
+#include <thread.h>
+#include <barrier.h>
+
+#define STACK_SIZE    4096
+#define NUM_THREADS   4
+#define NUM_BLOCKS    200
+#define NUM_ROUNDS    10
+
+static unsigned char *blocks[NUM_THREADS][NUM_BLOCKS];
+static barrier_t barrier;
+static int failed = 0;
+
+/**
+ * @brief Size of block i, from a few bytes to a couple of pages.
+ */
+static int block_size(int i)
+{
+  return 1 + (i * 37) % 9000;
+}
+
+void *worker(void *arg)
+{
+  int me = (int) arg, next = (me + 1) % NUM_THREADS;
+  unsigned char *buf;
+  int round, i, j, size;
+
+  for (round = 0; round < NUM_ROUNDS; round++) {
+    for (i = 0; i < NUM_BLOCKS; i++) {
+      size = block_size(i);
+      if ((buf = malloc(size)) == NULL) {
+        failed = 1;
+        break;
+      }
+      for (j = 0; j < size; j++)
+        buf[j] = me + i + j;
+      blocks[me][i] = buf;
+    }
+    barrier_wait(&barrier);
+
+    for (i = 0; i < NUM_BLOCKS; i++) {
+      if ((buf = blocks[next][i]) == NULL)
+        continue;
+      size = block_size(i);
+      if (i % 4 == 0 && (buf = realloc(buf, size * 2)) == NULL) {
+        failed = 1;
+        continue;
+      }
+      for (j = 0; j < size; j++) {
+        if (buf[j] != (unsigned char) (next + i + j))
+          failed = 1;
+      }
+      free(buf);
+      blocks[next][i] = NULL;
+    }
+    barrier_wait(&barrier);
+  }
+
+  for (i = 0; i < NUM_BLOCKS; i++) {
+    size = block_size(i);
+    if ((buf = calloc(size, 1)) == NULL) {
+      failed = 1;
+      break;
+    }
+    for (j = 0; j < size; j++) {
+      if (buf[j] != 0)
+        failed = 1;
+    }
+    blocks[me][i] = buf;
+  }
+  for (i = 0; i < NUM_BLOCKS; i++)
+    free(blocks[me][i]);
+  return NULL;
+}
+
+int
+main(int argc, char *argv[])
+{
+  int tids[NUM_THREADS];
+  int i;
+
+  if (thr_init(STACK_SIZE) < 0 || barrier_init(&barrier, NUM_THREADS) < 0)
+    return -1;
+
+  for (i = 0; i < NUM_THREADS; i++)
+    tids[i] = thr_create(worker, (void *) i);
+  for (i = 0; i < NUM_THREADS; i++)
+    thr_join(tids[i], NULL);
+  malloc_trim();
+
+  lprintf("arena_test: %s\n", failed ? "FAILED" : "success");
+  return failed;
+}
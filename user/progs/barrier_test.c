@@ -0,0 +1,80 @@
+/**
+ * @file user/progs/barrier_test.c
+ * @author Zhan Chen (zhanc1)
+ * @brief Test for barrier_t and latch_t.
+ *
+ * Workers first count down a latch the main thread waits on, then go through
+ * a number of phases separated by a barrier. In every phase each worker bumps
+ * the counter of that phase, and after the barrier checks that everybody did.
+ * Exactly one worker per phase must be told it is the serial thread.
+ */
+
+#include <syscall.h>
+#include <simics.h>
+#include <thread.h>
+#include <mutex.h>
+#include <barrier.h>
+#include <latch.h>
+#include <stddef.h>
+
+#define NUM_WORKERS   5
+#define PHASES        200
+#define STACK_SIZE    4096
+
+static barrier_t barrier;
+static latch_t ready;
+static mutex_t counter_lock;
+static int counter[PHASES];
+static int serial[PHASES];
+static int failed = 0;
+
+void *worker(void *arg)
+{
+  int phase;
+
+  latch_count_down(&ready);
+  for (phase = 0; phase < PHASES; phase++) {
+    mutex_lock(&counter_lock);
+    counter[phase]++;
+    mutex_unlock(&counter_lock);
+
+    if (barrier_wait(&barrier) == BARRIER_SERIAL_THREAD) {
+      mutex_lock(&counter_lock);
+      serial[phase]++;
+      mutex_unlock(&counter_lock);
+    }
+    if (counter[phase] != NUM_WORKERS)
+      failed = 1;
+  }
+  return NULL;
+}
+
+int
+main(int argc, char *argv[])
+{
+  int tids[NUM_WORKERS];
+  int i;
+
+  if (thr_init(STACK_SIZE) < 0 || mutex_init(&counter_lock) < 0 ||
+      barrier_init(&barrier, NUM_WORKERS) < 0 ||
+      latch_init(&ready, NUM_WORKERS) < 0)
+    return -1;
+
+  for (i = 0; i < NUM_WORKERS; i++)
+    tids[i] = thr_create(worker, NULL);
+
+  latch_wait(&ready);
+  for (i = 0; i < NUM_WORKERS; i++)
+    thr_join(tids[i], NULL);
+
+  for (i = 0; i < PHASES; i++) {
+    if (counter[i] != NUM_WORKERS || serial[i] != 1)
+      failed = 1;
+  }
+  latch_wait(&ready);
+  latch_destroy(&ready);
+  barrier_destroy(&barrier);
+
+  lprintf("barrier_test: %s\n", failed ? "FAILED" : "success");
+  return failed;
+}
@@ -0,0 +1,176 @@
+/**
+ * @file user/progs/bench.h
+ * @author Zhan Chen (zhanc1)
+ * @brief Harness shared by the bench_* programs.
+ *
+ * A benchmark runs its worker on 1, 2, 4 and 8 threads, or on the thread
+ * counts given on the command line, and prints a line per run in the format
+ * of bench_seqlock, with the rate and latencies added:
+ *
+ *    bench: <name> threads=<threads> ops=<ops> ticks=<elapsed>
+ *           ops_per_tick=<ops/ticks> p50=<ticks> p90=<ticks> p99=<ticks>
+ *           max=<ticks>
+ *
+ * all on one line. The workers are let go together once all of them are
+ * created, the clock runs from then until the last one is joined, a run too
+ * short for the clock to tick counts as one tick. Timing
+ * every operation would cost a get_ticks() each, so only one in BENCH_EVERY
+ * is, and the percentiles are of those, in ticks. Latencies are counted in a
+ * histogram, those of BENCH_HIST - 1 ticks or more in its last bucket, so
+ * percentiles up there only tell that much. Each run starts from
+ * scratch, a worker gets its index among the threads of the run as its
+ * argument.
+ */
+
+#ifndef _BENCH_H_
+#define _BENCH_H_
+
+#include <syscall.h>
+#include <simics.h>
+#include <stdio.h>
+#include <stdlib.h>         /* atoi() */
+#include <thread.h>
+#include <barrier.h>
+
+#define BENCH_MAX_THREADS 16
+#define BENCH_HIST        256   /* Latencies told apart, in ticks */
+#define BENCH_EVERY       8     /* One operation in this many is timed */
+#define BENCH_STACK_SIZE  4096
+
+/** @brief Does the i-th operation of thread me, timing it every so often. */
+#define BENCH_TIMED(me, i, ...) do {                  \
+    if ((i) % BENCH_EVERY) {                          \
+      __VA_ARGS__;                                    \
+    } else {                                          \
+      unsigned int bench_t0 = get_ticks();            \
+      __VA_ARGS__;                                    \
+      bench_sample((me), get_ticks() - bench_t0);     \
+    }                                                 \
+  } while (0)
+
+static int bench_hist[BENCH_MAX_THREADS][BENCH_HIST];
+static unsigned int bench_max[BENCH_MAX_THREADS];
+static barrier_t bench_go;
+static int bench_counts[BENCH_MAX_THREADS];
+static int bench_ncounts;
+
+/**
+ * @brief Starts the thread library and reads the thread counts to run with.
+ * @return Number of runs, negative number on error.
+ */
+static int bench_init(int argc, char *argv[])
+{
+  int i;
+
+  if (thr_init(BENCH_STACK_SIZE) < 0)
+    return -1;
+  bench_ncounts = 0;
+  for (i = 1; i < argc && bench_ncounts < BENCH_MAX_THREADS; i++) {
+    if (atoi(argv[i]) < 1 || atoi(argv[i]) > BENCH_MAX_THREADS) {
+      printf("bench: thread counts go from 1 to %d\n", BENCH_MAX_THREADS);
+      return -2;
+    }
+    bench_counts[bench_ncounts++] = atoi(argv[i]);
+  }
+  if (bench_ncounts == 0) {
+    for (i = 0; i < 4; i++)
+      bench_counts[i] = 1 << i;
+    bench_ncounts = 4;
+  }
+  return bench_ncounts;
+}
+
+/**
+ * @brief Notes how long a timed operation of thread me took.
+ */
+static void bench_sample(int me, unsigned int ticks)
+{
+  bench_hist[me][ticks < BENCH_HIST ? ticks : BENCH_HIST - 1]++;
+  if (ticks > bench_max[me])
+    bench_max[me] = ticks;
+}
+
+/**
+ * @brief Waits for the other workers, to start with them.
+ */
+static void bench_begin(void)
+{
+  barrier_wait(&bench_go);
+}
+
+/**
+ * @brief Latency below which pct percent of the timed operations of the
+ *        first threads threads fall.
+ */
+static int bench_pct(int threads, int pct)
+{
+  int i, v, n = 0, seen = 0;
+
+  for (i = 0; i < threads; i++) {
+    for (v = 0; v < BENCH_HIST; v++)
+      n += bench_hist[i][v];
+  }
+  for (v = 0; v < BENCH_HIST - 1; v++) {
+    for (i = 0; i < threads; i++)
+      seen += bench_hist[i][v];
+    if (seen > n / 100 * pct + n % 100 * pct / 100)
+      break;
+  }
+  return v;
+}
+
+/**
+ * @brief Prints the line of a run.
+ */
+static void bench_report(const char *name, int threads, int ops,
+                         unsigned int ticks)
+{
+  unsigned int per = ticks ? ticks : 1, max = 0;
+  int i;
+
+  for (i = 0; i < threads; i++) {
+    if (bench_max[i] > max)
+      max = bench_max[i];
+  }
+  printf("bench: %s threads=%d ops=%d ticks=%u ops_per_tick=%u.%03u "
+         "p50=%d p90=%d p99=%d max=%u\n", name, threads, ops, ticks,
+         ops / per, (ops % per) * 1000 / per, bench_pct(threads, 50),
+         bench_pct(threads, 90), bench_pct(threads, 99), max);
+}
+
+/**
+ * @brief Runs worker on threads threads and reports the run.
+ * @param name Name of the benchmark.
+ * @param threads How many threads to run it on.
+ * @param ops Operations done by all of them together.
+ * @param worker Thread body, calling bench_begin() before it gets going.
+ * @return 0 on success, negative number on error.
+ */
+static int bench_run(const char *name, int threads, int ops,
+                     void *(*worker)(void *))
+{
+  int tids[BENCH_MAX_THREADS];
+  unsigned int start;
+  int i, v;
+
+  if (barrier_init(&bench_go, threads + 1) < 0)
+    return -1;
+  for (i = 0; i < threads; i++) {
+    for (v = 0; v < BENCH_HIST; v++)
+      bench_hist[i][v] = 0;
+    bench_max[i] = 0;
+  }
+  for (i = 0; i < threads; i++) {
+    if ((tids[i] = thr_create(worker, (void *) i)) < 0)
+      return -2;
+  }
+  barrier_wait(&bench_go);
+  start = get_ticks();
+  for (i = 0; i < threads; i++)
+    thr_join(tids[i], NULL);
+  bench_report(name, threads, ops, get_ticks() - start);
+  barrier_destroy(&bench_go);
+  return 0;
+}
+
+#endif /* _BENCH_H_ */
@@ -0,0 +1,76 @@
+/**
+ * @file user/progs/bench_cond_pingpong.c
+ * @author Zhan Chen (zhanc1)
+ * @brief Benchmark of handing the turn back and forth with a condition
+ *        variable.
+ *
+ * The threads play in pairs, a lone thread plays against itself and never
+ * has to wait. Each pair has a mutex, a condition variable and a ball, which
+ * goes over to the other side and has to come back before it can be hit
+ * again. An operation is a hit, its latency that of getting the ball back.
+ */
+
+#include <mutex.h>
+#include <cond.h>
+#include "bench.h"
+
+#define OPS_PER_THREAD  500
+
+/**
+ * @brief A pair of players.
+ */
+typedef struct table {
+  mutex_t lock;
+  cond_t turn;
+  int ball;                 /* Hits so far, even ones by the first player */
+  int players;
+} table_t;
+
+static table_t tables[BENCH_MAX_THREADS / 2 + 1];
+
+void *worker(void *arg)
+{
+  int i, me = (int) arg;
+  table_t *t = &tables[me / 2];
+  int side = me % 2;
+
+  bench_begin();
+  for (i = 0; i < OPS_PER_THREAD; i++) {
+    BENCH_TIMED(me, i, {
+      mutex_lock(&t->lock);
+      while (t->players == 2 && t->ball % 2 != side)
+        cond_wait(&t->turn, &t->lock);
+      t->ball++;
+      cond_signal(&t->turn);
+      mutex_unlock(&t->lock);
+    });
+  }
+  return NULL;
+}
+
+int
+main(int argc, char *argv[])
+{
+  int r, i, runs, threads;
+
+  if ((runs = bench_init(argc, argv)) < 0)
+    return -1;
+  for (r = 0; r < runs; r++) {
+    threads = bench_counts[r];
+    for (i = 0; i < (threads + 1) / 2; i++) {
+      if (mutex_init(&tables[i].lock) < 0 || cond_init(&tables[i].turn) < 0)
+        return -1;
+      tables[i].ball = 0;
+      tables[i].players = 2 * i + 1 < threads ? 2 : 1;
+    }
+    if (bench_run("bench_cond_pingpong", threads, threads * OPS_PER_THREAD,
+                  worker) < 0)
+      break;
+    for (i = 0; i < (threads + 1) / 2; i++) {
+      cond_destroy(&tables[i].turn);
+      mutex_destroy(&tables[i].lock);
+    }
+  }
+  lprintf("bench_cond_pingpong: %s\n", r == runs ? "success" : "FAILED");
+  return r != runs;
+}
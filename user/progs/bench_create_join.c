@@ -0,0 +1,51 @@
+/**
+ * @file user/progs/bench_create_join.c
+ * @author Zhan Chen (zhanc1)
+ * @brief Benchmark of thread creation.
+ *
+ * Every thread creates a thread that returns right away and joins it, over
+ * and over. An operation is a thr_create() and its thr_join().
+ */
+
+#include <stddef.h>
+#include "bench.h"
+
+#define OPS_PER_THREAD  100
+
+void *child(void *arg)
+{
+  return arg;
+}
+
+void *worker(void *arg)
+{
+  int i, tid, me = (int) arg;
+  void *status;
+
+  bench_begin();
+  for (i = 0; i < OPS_PER_THREAD; i++) {
+    BENCH_TIMED(me, i, {
+      if ((tid = thr_create(child, (void *) i)) < 0 ||
+          thr_join(tid, &status) < 0 || status != (void *) i)
+        return (void *) -1;
+    });
+  }
+  return NULL;
+}
+
+int
+main(int argc, char *argv[])
+{
+  int r, runs, threads;
+
+  if ((runs = bench_init(argc, argv)) < 0)
+    return -1;
+  for (r = 0; r < runs; r++) {
+    threads = bench_counts[r];
+    if (bench_run("bench_create_join", threads, threads * OPS_PER_THREAD,
+                  worker) < 0)
+      break;
+  }
+  lprintf("bench_create_join: %s\n", r == runs ? "success" : "FAILED");
+  return r != runs;
+}
@@ -0,0 +1,52 @@
+/**
+ * @file user/progs/bench_malloc.c
+ * @author Zhan Chen (zhanc1)
+ * @brief Benchmark of malloc() and free() from many threads.
+ *
+ * Every thread keeps WINDOW blocks of 16 to 1024 bytes around, replacing a
+ * pseudo-random one of them each time. An operation is a free() and a
+ * malloc().
+ */
+
+#include <malloc.h>
+#include "bench.h"
+
+#define OPS_PER_THREAD  2000
+#define WINDOW          32
+
+void *worker(void *arg)
+{
+  void *blocks[WINDOW] = { NULL };
+  unsigned int seed = 12345 + (int) arg;
+  int i, slot, me = (int) arg;
+
+  bench_begin();
+  for (i = 0; i < OPS_PER_THREAD; i++) {
+    seed = seed * 1103515245 + 12345;
+    slot = (seed >> 16) % WINDOW;
+    BENCH_TIMED(me, i, {
+      free(blocks[slot]);
+      blocks[slot] = malloc(16 + (seed >> 8) % 1009);
+    });
+  }
+  for (slot = 0; slot < WINDOW; slot++)
+    free(blocks[slot]);
+  return NULL;
+}
+
+int
+main(int argc, char *argv[])
+{
+  int r, runs, threads;
+
+  if ((runs = bench_init(argc, argv)) < 0)
+    return -1;
+  for (r = 0; r < runs; r++) {
+    threads = bench_counts[r];
+    if (bench_run("bench_malloc", threads, threads * OPS_PER_THREAD,
+                  worker) < 0)
+      break;
+  }
+  lprintf("bench_malloc: %s\n", r == runs ? "success" : "FAILED");
+  return r != runs;
+}
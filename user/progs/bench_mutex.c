@@ -0,0 +1,49 @@
+/**
+ * @file user/progs/bench_mutex.c
+ * @author Zhan Chen (zhanc1)
+ * @brief Benchmark of a mutex everybody wants.
+ *
+ * Every thread bumps a shared counter under the same mutex. An operation is
+ * a lock and an unlock, the latency is that of the pair.
+ */
+
+#include <mutex.h>
+#include "bench.h"
+
+#define OPS_PER_THREAD  2000
+
+static mutex_t lock;
+static volatile int counter;
+
+void *worker(void *arg)
+{
+  int i, me = (int) arg;
+
+  bench_begin();
+  for (i = 0; i < OPS_PER_THREAD; i++) {
+    BENCH_TIMED(me, i, {
+      mutex_lock(&lock);
+      counter++;
+      mutex_unlock(&lock);
+    });
+  }
+  return NULL;
+}
+
+int
+main(int argc, char *argv[])
+{
+  int r, runs, threads;
+
+  if ((runs = bench_init(argc, argv)) < 0 || mutex_init(&lock) < 0)
+    return -1;
+  for (r = 0; r < runs; r++) {
+    threads = bench_counts[r];
+    counter = 0;
+    if (bench_run("bench_mutex", threads, threads * OPS_PER_THREAD,
+                  worker) < 0 || counter != threads * OPS_PER_THREAD)
+      break;
+  }
+  lprintf("bench_mutex: %s\n", r == runs ? "success" : "FAILED");
+  return r != runs;
+}
@@ -0,0 +1,59 @@
+/**
+ * @file user/progs/bench_rwlock_mix.c
+ * @author Zhan Chen (zhanc1)
+ * @brief Benchmark of a reader/writer lock that is mostly read.
+ *
+ * Every thread reads a small table under the lock, and one time in
+ * WRITE_EVERY updates it instead. An operation is a lock and an unlock in
+ * either mode.
+ */
+
+#include <rwlock.h>
+#include "bench.h"
+
+#define OPS_PER_THREAD  1000
+#define WRITE_EVERY     10
+#define TABLE_SIZE      16
+
+static rwlock_t lock;
+static volatile int table[TABLE_SIZE];
+
+void *worker(void *arg)
+{
+  int i, j, sum = 0, me = (int) arg;
+
+  bench_begin();
+  for (i = 0; i < OPS_PER_THREAD; i++) {
+    BENCH_TIMED(me, i, {
+      if ((i + me) % WRITE_EVERY) {
+        rwlock_lock(&lock, RWLOCK_READ);
+        for (j = sum = 0; j < TABLE_SIZE; j++)
+          sum += table[j];
+        rwlock_unlock(&lock);
+      } else {
+        rwlock_lock(&lock, RWLOCK_WRITE);
+        for (j = 0; j < TABLE_SIZE; j++)
+          table[j]++;
+        rwlock_unlock(&lock);
+      }
+    });
+  }
+  return (void *) sum;
+}
+
+int
+main(int argc, char *argv[])
+{
+  int r, runs, threads;
+
+  if ((runs = bench_init(argc, argv)) < 0 || rwlock_init(&lock) < 0)
+    return -1;
+  for (r = 0; r < runs; r++) {
+    threads = bench_counts[r];
+    if (bench_run("bench_rwlock_mix", threads, threads * OPS_PER_THREAD,
+                  worker) < 0)
+      break;
+  }
+  lprintf("bench_rwlock_mix: %s\n", r == runs ? "success" : "FAILED");
+  return r != runs;
+}
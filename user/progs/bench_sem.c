@@ -0,0 +1,51 @@
+/**
+ * @file user/progs/bench_sem.c
+ * @author Zhan Chen (zhanc1)
+ * @brief Benchmark of a semaphore guarding a pool of SLOTS resources.
+ *
+ * With more threads than slots some have to wait. An operation is a wait
+ * and a signal.
+ */
+
+#include <sem.h>
+#include "bench.h"
+
+#define OPS_PER_THREAD  1000
+#define SLOTS           2
+
+static sem_t slots;
+static volatile int inside, most;
+
+void *worker(void *arg)
+{
+  int i, me = (int) arg;
+
+  bench_begin();
+  for (i = 0; i < OPS_PER_THREAD; i++) {
+    BENCH_TIMED(me, i, {
+      sem_wait(&slots);
+      if (++inside > most)
+        most = inside;
+      inside--;
+      sem_signal(&slots);
+    });
+  }
+  return NULL;
+}
+
+int
+main(int argc, char *argv[])
+{
+  int r, runs, threads;
+
+  if ((runs = bench_init(argc, argv)) < 0 || sem_init(&slots, SLOTS) < 0)
+    return -1;
+  for (r = 0; r < runs; r++) {
+    threads = bench_counts[r];
+    if (bench_run("bench_sem", threads, threads * OPS_PER_THREAD,
+                  worker) < 0 || most > SLOTS)
+      break;
+  }
+  lprintf("bench_sem: %s\n", r == runs ? "success" : "FAILED");
+  return r != runs;
+}
@@ -0,0 +1,137 @@
+/**
+ * @file user/progs/bench_seqlock.c
+ * @author Zhan Chen (zhanc1)
+ * @brief Read side throughput of seqlock_t against rwlock_t.
+ *
+ * A handful of readers keep taking snapshots of a small stats structure while
+ * one writer keeps updating it. The same run is done once with the readers
+ * behind rwlock_lock(RWLOCK_READ) and once with optimistic seqlock reads.
+ * Every snapshot is checked for consistency. One line per run is printed:
+ *
+ *    bench: <name> threads=<readers> ops=<reads> ticks=<elapsed>
+ */
+
+#include <syscall.h>
+#include <simics.h>
+#include <stdio.h>
+#include <thread.h>
+#include <rwlock.h>
+#include <seqlock.h>
+
+#define NUM_READERS   4
+#define READS         20000
+#define STACK_SIZE    4096
+#define NUM_BUCKETS   16
+
+typedef struct stats {
+  unsigned int requests;
+  unsigned int bytes;   /* Wraps around on fast machines, hence unsigned */
+  unsigned int errors;
+  unsigned int hist[NUM_BUCKETS]; /* requests, to widen the race window */
+  unsigned int sum;     /* requests + bytes + errors, checked by readers */
+} stats_t;
+
+static stats_t stats;
+static rwlock_t rwlock;
+static seqlock_t seqlock;
+static volatile int use_seqlock;
+static volatile int readers_done;
+static int failed = 0;
+
+static void snapshot(stats_t *copy)
+{
+  int seq;
+
+  if (use_seqlock) {
+    do {
+      seq = seqlock_read_begin(&seqlock);
+      *copy = stats;
+    } while (seqlock_read_retry(&seqlock, seq));
+  } else {
+    rwlock_lock(&rwlock, RWLOCK_READ);
+    *copy = stats;
+    rwlock_unlock(&rwlock);
+  }
+}
+
+static void update(int i)
+{
+  int j;
+
+  if (use_seqlock)
+    seqlock_write_lock(&seqlock);
+  else
+    rwlock_lock(&rwlock, RWLOCK_WRITE);
+  stats.requests++;
+  stats.bytes += i;
+  stats.errors += i & 1;
+  for (j = 0; j < NUM_BUCKETS; j++)
+    stats.hist[j] = stats.requests;
+  stats.sum = stats.requests + stats.bytes + stats.errors;
+  if (use_seqlock)
+    seqlock_write_unlock(&seqlock);
+  else
+    rwlock_unlock(&rwlock);
+}
+
+void *reader(void *arg)
+{
+  stats_t copy;
+  int i, j;
+
+  for (i = 0; i < READS; i++) {
+    snapshot(&copy);
+    if (copy.requests + copy.bytes + copy.errors != copy.sum)
+      failed = 1;
+    for (j = 0; j < NUM_BUCKETS; j++) {
+      if (copy.hist[j] != copy.requests)
+        failed = 1;
+    }
+  }
+  return NULL;
+}
+
+void *writer(void *arg)
+{
+  int i = 0;
+
+  while (!readers_done)
+    update(i++);
+  return NULL;
+}
+
+static void run(const char *name, int seq)
+{
+  int tids[NUM_READERS];
+  int writer_tid, i;
+  unsigned int start;
+
+  use_seqlock = seq;
+  readers_done = 0;
+  writer_tid = thr_create(writer, NULL);
+
+  start = get_ticks();
+  for (i = 0; i < NUM_READERS; i++)
+    tids[i] = thr_create(reader, NULL);
+  for (i = 0; i < NUM_READERS; i++)
+    thr_join(tids[i], NULL);
+  printf("bench: %s threads=%d ops=%d ticks=%u\n", name, NUM_READERS,
+         NUM_READERS * READS, get_ticks() - start);
+
+  readers_done = 1;
+  thr_join(writer_tid, NULL);
+}
+
+int
+main(int argc, char *argv[])
+{
+  if (thr_init(STACK_SIZE) < 0 || rwlock_init(&rwlock) < 0 ||
+      seqlock_init(&seqlock) < 0)
+    return -1;
+
+  run("rwlock_read", 0);
+  run("seqlock_read", 1);
+
+  lprintf("bench_seqlock: %s\n", failed ? "FAILED" : "success");
+  return failed;
+}
@@ -0,0 +1,119 @@
+/**
+ * @file user/progs/calloc_test.c
+ * @author Zhan Chen (zhanc1)
+ * @brief Test for calloc() skipping memory that is still zero.
+ *
+ * calloc() only clears what was handed out before, so every way a used byte
+ * can end up in a fresh block has to be covered: blocks freed and handed out
+ * again, blocks that grew with realloc() and shrank again, the free block at
+ * the end of the heap merged with the memory the heap grows by, and large
+ * mapped blocks. The same goes on in the arenas of a few threads.
+ */
+
+#include <syscall.h>
+#include <simics.h>
+#include <stddef.h>
+#include <string.h>
+#include <malloc.h>
+#include <thread.h>
+
+#define STACK_SIZE    4096
+#define NUM_THREADS   4
+#define NUM_BLOCKS    64
+#define NUM_ROUNDS    8
+#define LARGE         (64 * 1024)
+
+static int failed = 0;
+
+/**
+ * @brief Calloc a block and check it is zero, then dirty it.
+ */
+static unsigned char *dirty_calloc(int size)
+{
+  unsigned char *buf;
+  int i;
+
+  if ((buf = calloc(size, 1)) == NULL) {
+    failed = 1;
+    return NULL;
+  }
+  for (i = 0; i < size; i++) {
+    if (buf[i] != 0) {
+      lprintf("calloc_test: byte %d of %d not zero\n", i, size);
+      failed = 1;
+      break;
+    }
+  }
+  memset(buf, 0xff, size);
+  return buf;
+}
+
+/**
+ * @brief Size of block i in round r, from a few bytes to a few pages.
+ */
+static int block_size(int r, int i)
+{
+  return 1 + (r * 131 + i * 797) % 13000;
+}
+
+void *worker(void *arg)
+{
+  unsigned char *blocks[NUM_BLOCKS];
+  unsigned char *buf;
+  int round, i, size;
+
+  for (round = 0; round < NUM_ROUNDS; round++) {
+    for (i = 0; i < NUM_BLOCKS; i++)
+      blocks[i] = dirty_calloc(block_size(round, i));
+
+    /* Grow and shrink some, leaving dirty free space behind */
+    for (i = 0; i < NUM_BLOCKS; i += 3) {
+      size = block_size(round, i);
+      if (blocks[i] && (buf = realloc(blocks[i], size * 3)) != NULL) {
+        memset(buf, 0xff, size * 3);
+        blocks[i] = realloc(buf, size / 2 + 1);
+      }
+    }
+    for (i = round % 2; i < NUM_BLOCKS; i += 2) {
+      free(blocks[i]);
+      blocks[i] = NULL;
+    }
+    for (i = round % 2; i < NUM_BLOCKS; i += 2)
+      blocks[i] = dirty_calloc(block_size(round + 1, i));
+    for (i = 0; i < NUM_BLOCKS; i++)
+      free(blocks[i]);
+  }
+  return NULL;
+}
+
+int
+main(int argc, char *argv[])
+{
+  int tids[NUM_THREADS];
+  unsigned char *a, *b;
+  int i;
+
+  /* The free block at the end of the heap merges with new memory */
+  a = dirty_calloc(3000);
+  b = dirty_calloc(900);
+  free(b);
+  b = dirty_calloc(8000);
+  free(b);
+  free(a);
+  free(dirty_calloc(12000));
+
+  /* Large blocks, fresh or at a reused address */
+  for (i = 0; i < 4; i++)
+    free(dirty_calloc(LARGE));
+
+  if (thr_init(STACK_SIZE) < 0)
+    return -1;
+  worker(NULL);
+  for (i = 0; i < NUM_THREADS; i++)
+    tids[i] = thr_create(worker, NULL);
+  for (i = 0; i < NUM_THREADS; i++)
+    thr_join(tids[i], NULL);
+
+  lprintf("calloc_test: %s\n", failed ? "FAILED" : "success");
+  return failed;
+}
@@ -0,0 +1,88 @@
+/**
+ * @file user/progs/cond_race_test.c
+ * @author Zhan Chen (zhanc1)
+ * @brief Race test for condition variables, small enough for the schedule
+ *        explorer in host/ to go through a great many of its schedules.
+ *
+ * Producers hand items to consumers through a one item mailbox, each side
+ * waiting on a condition variable of its own for the other and waking just
+ * one thread with cond_signal(), the producers while holding the mutex, the
+ * consumers after letting go of it. A wakeup lost between cond_wait()
+ * letting go of the mutex and deschedule(), or one that ends some later
+ * wait instead, leaves somebody asleep for good, an item taken twice or
+ * never shows in the sum.
+ */
+
+#include <syscall.h>
+#include <simics.h>
+#include <stddef.h>
+#include <thread.h>
+#include <mutex.h>
+#include <cond.h>
+
+#define STACK_SIZE      4096
+#define NUM_PRODUCERS   2
+#define NUM_CONSUMERS   2
+#define NUM_ITEMS       3       /* Per producer */
+
+static mutex_t lock;
+static cond_t filled, emptied;
+static int full = 0, item;
+static int sum = 0;
+
+void *producer(void *arg)
+{
+  int i, me = (int) arg;
+
+  for (i = 1; i <= NUM_ITEMS; i++) {
+    mutex_lock(&lock);
+    while (full)
+      cond_wait(&emptied, &lock);
+    item = me * NUM_ITEMS + i;
+    full = 1;
+    cond_signal(&filled);
+    mutex_unlock(&lock);
+  }
+  return NULL;
+}
+
+void *consumer(void *arg)
+{
+  int i, n = (int) arg;
+
+  for (i = 0; i < n; i++) {
+    mutex_lock(&lock);
+    while (!full)
+      cond_wait(&filled, &lock);
+    sum += item;
+    full = 0;
+    mutex_unlock(&lock);
+    cond_signal(&emptied);
+  }
+  return NULL;
+}
+
+int
+main(int argc, char *argv[])
+{
+  int tids[NUM_PRODUCERS + NUM_CONSUMERS];
+  int i, items = NUM_PRODUCERS * NUM_ITEMS, expected = 0;
+
+  if (thr_init(STACK_SIZE) < 0 || mutex_init(&lock) < 0 ||
+      cond_init(&filled) < 0 || cond_init(&emptied) < 0)
+    return -1;
+
+  for (i = 0; i < NUM_PRODUCERS; i++)
+    tids[i] = thr_create(producer, (void *) i);
+  for (i = 0; i < NUM_CONSUMERS; i++) {
+    tids[NUM_PRODUCERS + i] = thr_create(consumer, (void *)
+      (items / NUM_CONSUMERS + (i < items % NUM_CONSUMERS)));
+  }
+  for (i = 0; i < NUM_PRODUCERS + NUM_CONSUMERS; i++)
+    thr_join(tids[i], NULL);
+
+  for (i = 1; i <= items; i++)
+    expected += i;
+  lprintf("cond_race_test: %s\n", sum == expected ? "success" : "FAILED");
+  return sum != expected;
+}
@@ -0,0 +1,169 @@
+/**
+ * @file user/progs/coroutine_test.c
+ * @author Zhan Chen (zhanc1)
+ * @brief Test for stackless coroutines: yields taking turns, a pipeline
+ *        from a generator coroutine through a squaring one to a thread,
+ *        run by two threads at once, and a long chain of relays.
+ */
+
+#include <syscall.h>
+#include <simics.h>
+#include <stddef.h>
+#include <thread.h>
+#include <coroutine.h>
+
+#define STACK_SIZE      4096
+#define NUM_TURNS       5
+#define NUM_VALUES      50
+#define NUM_RELAYS      200
+#define NUM_TOKENS      20
+
+/**
+ * @brief What a stage keeps across waits.
+ */
+typedef struct stage {
+  co_t co;
+  chan_t *in, *out;
+  void *val;
+  int i, rc;
+} stage_t;
+
+static char turns[2 * NUM_TURNS + 1];
+static int nturns = 0;
+static co_sched_t sched;
+static chan_t values, squares, relays[NUM_RELAYS + 1];
+static stage_t gen_st, square_st, relay_st[NUM_RELAYS];
+
+int take_turns(co_t *co)
+{
+  stage_t *st = (stage_t *) co;
+
+  co_begin(co);
+  for (st->i = 0; st->i < NUM_TURNS; st->i++) {
+    turns[nturns++] = (char) (int) st->val;
+    co_yield(co);
+  }
+  co_end(co);
+}
+
+int generate(co_t *co)
+{
+  stage_t *st = (stage_t *) co;
+
+  co_begin(co);
+  for (st->i = 1; st->i <= NUM_VALUES; st->i++) {
+    co_send(co, st->out, (void *) st->i, st->rc);
+    if (st->rc == CHAN_CLOSED)
+      co_exit(co);
+  }
+  chan_close(st->out);
+  co_end(co);
+}
+
+int square(co_t *co)
+{
+  stage_t *st = (stage_t *) co;
+
+  co_begin(co);
+  for (;;) {
+    co_recv(co, st->in, &st->val, st->rc);
+    if (st->rc == CHAN_CLOSED)
+      break;
+    st->val = (void *) ((int) st->val * (int) st->val);
+    co_send(co, st->out, st->val, st->rc);
+  }
+  chan_close(st->out);
+  co_end(co);
+}
+
+int relay(co_t *co)
+{
+  stage_t *st = (stage_t *) co;
+
+  co_begin(co);
+  for (;;) {
+    co_recv(co, st->in, &st->val, st->rc);
+    if (st->rc == CHAN_CLOSED)
+      break;
+    co_send(co, st->out, (void *) ((int) st->val + 1), st->rc);
+  }
+  chan_close(st->out);
+  co_end(co);
+}
+
+void *runner(void *arg)
+{
+  co_sched_run(&sched);
+  return NULL;
+}
+
+int
+main(int argc, char *argv[])
+{
+  stage_t a, b;
+  int i, tids[2], sum = 0, expected = 0, ok = 1;
+  void *val;
+
+  if (thr_init(STACK_SIZE) < 0 || co_sched_init(&sched) < 0)
+    return -1;
+
+  /* One thread runs them, so they take strict turns */
+  a.val = (void *) 'a';
+  b.val = (void *) 'b';
+  co_start(&sched, &a.co, take_turns, NULL);
+  co_start(&sched, &b.co, take_turns, NULL);
+  co_sched_run(&sched);
+  for (i = 0; i < 2 * NUM_TURNS; i++) {
+    if (turns[i] != "ab"[i % 2])
+      ok = 0;
+  }
+
+  /* Generator and square run by two threads, main sums what comes out */
+  if (chan_init(&values, 2) < 0 || chan_init(&squares, 1) < 0)
+    return -1;
+  gen_st.out = &values;
+  square_st.in = &values;
+  square_st.out = &squares;
+  co_start(&sched, &gen_st.co, generate, NULL);
+  co_start(&sched, &square_st.co, square, NULL);
+  tids[0] = thr_create(runner, NULL);
+  tids[1] = thr_create(runner, NULL);
+  while (chan_recv(&squares, &val) == 0)
+    sum += (int) val;
+  thr_join(tids[0], NULL);
+  thr_join(tids[1], NULL);
+  for (i = 1; i <= NUM_VALUES; i++)
+    expected += i * i;
+  if (sum != expected)
+    ok = 0;
+
+  /* Tokens from main through a chain of relays, each adding one */
+  for (i = 0; i <= NUM_RELAYS; i++) {
+    if (chan_init(&relays[i], 1) < 0)
+      return -1;
+  }
+  for (i = 0; i < NUM_RELAYS; i++) {
+    relay_st[i].in = &relays[i];
+    relay_st[i].out = &relays[i + 1];
+    co_start(&sched, &relay_st[i].co, relay, NULL);
+  }
+  tids[0] = thr_create(runner, NULL);
+  for (i = 0; i < NUM_TOKENS; i++)
+    chan_send(&relays[0], (void *) i);
+  chan_close(&relays[0]);
+  for (i = 0; chan_recv(&relays[NUM_RELAYS], &val) == 0; i++) {
+    if ((int) val != i + NUM_RELAYS)
+      ok = 0;
+  }
+  if (i != NUM_TOKENS)
+    ok = 0;
+  thr_join(tids[0], NULL);
+
+  for (i = 0; i <= NUM_RELAYS; i++)
+    chan_destroy(&relays[i]);
+  chan_destroy(&values);
+  chan_destroy(&squares);
+  co_sched_destroy(&sched);
+  lprintf("coroutine_test: %s\n", ok ? "success" : "FAILED");
+  return !ok;
+}
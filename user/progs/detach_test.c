@@ -0,0 +1,84 @@
+/**
+ * @file user/progs/detach_test.c
+ * @author Zhan Chen (zhanc1)
+ * @brief Test for thr_detach().
+ *
+ * Threads are detached before and after they exit, and nobody can join them
+ * afterwards. Then a lot more detached threads with a large stack are
+ * created than would fit in memory at once, one after the other, which only
+ * works if their stacks and TCBs are reclaimed.
+ */
+
+#include <syscall.h>
+#include <simics.h>
+#include <stddef.h>
+#include <thread.h>
+#include <thread_ex.h>
+
+#define STACK_SIZE    4096
+#define BIG_STACK     (256 * 1024)
+#define NUM_CHURN     2000
+
+static volatile int exited = 0;
+static volatile int release = 0;
+static int failed = 0;
+
+void *quick(void *arg)
+{
+  exited = 1;
+  return NULL;
+}
+
+void *slow(void *arg)
+{
+  while (!release)
+    yield(-1);
+  exited = 1;
+  return NULL;
+}
+
+int
+main(int argc, char *argv[])
+{
+  thr_attr_t attr;
+  int i, tid;
+
+  if (thr_init(STACK_SIZE) < 0)
+    return -1;
+
+  /* Detach a thread that is still running */
+  tid = thr_create(slow, NULL);
+  if (thr_detach(tid) < 0 || thr_detach(tid) != -1 || thr_join(tid, NULL) >= 0)
+    failed = 1;
+  release = 1;
+  while (!exited)
+    yield(tid);
+
+  /* Detach a thread that is gone already */
+  exited = 0;
+  tid = thr_create(quick, NULL);
+  while (!exited)
+    yield(tid);
+  if (thr_detach(tid) < 0 || thr_join(tid, NULL) >= 0)
+    failed = 1;
+  if (thr_detach(-1) != -2)
+    failed = 1;
+
+  /* Churn through way more stack than we could ever hold */
+  thr_attr_init(&attr);
+  thr_attr_setstacksize(&attr, BIG_STACK);
+  thr_attr_setdetached(&attr, 1);
+  for (i = 0; i < NUM_CHURN; i++) {
+    exited = 0;
+    if ((tid = thr_create_ex(quick, NULL, &attr)) < 0) {
+      lprintf("detach_test: create %d failed\n", i);
+      failed = 1;
+      break;
+    }
+    while (!exited)
+      yield(tid);
+  }
+
+  lprintf("detach_test: %s\n", failed ? "FAILED" : "success");
+  return failed;
+}
@@ -0,0 +1,101 @@
+/** 
+ * @file user/progs/ebr_test.c
+ * @author Zhan Chen (zhanc1)
+ * @brief Stress test for epoch based reclamation.
+ *
+ * Readers keep dereferencing a shared pointer without any lock while writers
+ * keep swapping in new objects and retiring the old ones. If an object is
+ * freed while a reader still holds it, the allocator hands the memory out to
+ * a writer which overwrites it, and the reader notices the value changing
+ * underneath it.
+ */
+
+#include <syscall.h>
+#include <simics.h>
+#include <thread.h>
+#include <malloc.h>
+#include <mutex.h>
+#include <ebr.h>
+
+#define NUM_READERS   4
+#define NUM_WRITERS   2
+#define READS         2000
+#define WRITES        1000
+#define STACK_SIZE    4096
+
+typedef struct obj {
+  int val;
+  int check;
+} obj_t;
+
+static obj_t *shared;
+static mutex_t writer_lock;
+static int failed = 0;
+
+void *reader(void *arg)
+{
+  int i, val;
+  obj_t *o;
+
+  for (i = 0; i < READS; i++) {
+    ebr_enter();
+    o = shared;
+    val = o->val;
+    if (i % 8 == 0)
+      yield(-1);
+    if (o->val != val || o->check != ~val)
+      failed = 1;
+    ebr_exit();
+  }
+  return NULL;
+}
+
+void *writer(void *arg)
+{
+  int i;
+  obj_t *o, *old;
+
+  for (i = 0; i < WRITES; i++) {
+    if (!(o = malloc(sizeof(obj_t)))) {
+      failed = 1;
+      break;
+    }
+    o->val = (int) arg * WRITES + i;
+    o->check = ~o->val;
+    mutex_lock(&writer_lock);
+    old = shared;
+    shared = o;
+    mutex_unlock(&writer_lock);
+    if (ebr_retire(old) < 0)
+      failed = 1;
+  }
+  ebr_flush();
+  return NULL;
+}
+
+int 
+main(int argc, char *argv[])
+{
+  int tids[NUM_READERS + NUM_WRITERS];
+  int i;
+
+  if (thr_init(STACK_SIZE) < 0 || mutex_init(&writer_lock) < 0)
+    return -1;
+
+  shared = malloc(sizeof(obj_t));
+  shared->val = 0;
+  shared->check = ~0;
+
+  for (i = 0; i < NUM_READERS; i++)
+    tids[i] = thr_create(reader, NULL);
+  for (i = 0; i < NUM_WRITERS; i++)
+    tids[NUM_READERS + i] = thr_create(writer, (void *) (i + 1));
+  for (i = 0; i < NUM_READERS + NUM_WRITERS; i++) {
+    if (tids[i] < 0 || thr_join(tids[i], NULL) < 0)
+      failed = 1;
+  }
+
+  ebr_flush();
+  lprintf("ebr_test: %s\n", failed ? "FAILED" : "success");
+  return failed;
+}
@@ -0,0 +1,190 @@
+/**
+ * @file user/progs/fiber_test.c
+ * @author Zhan Chen (zhanc1)
+ * @brief Test for fibers: a fiber mutex held across yields, a mailbox
+ *        between fibers on a fiber condition variable, fibers joining the
+ *        fibers they created, and a crowd of fibers all blocked at once.
+ *
+ *    fiber_test [crowd]
+ *
+ * The crowd is 2000 fibers unless given, 100000 of them take about 400MB.
+ */
+
+#include <syscall.h>
+#include <simics.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <thread.h>
+#include <fiber.h>
+
+#define STACK_SIZE      4096
+#define NUM_WORKERS     3
+#define FIBER_STACK     4096
+#define NUM_COUNTERS    6
+#define NUM_ROUNDS      5       /* Per counter */
+#define NUM_ITEMS       20      /* Per producer, there are two of each */
+#define NUM_PARENTS     4
+#define NUM_CHILDREN    4       /* Per parent */
+#define NUM_CROWD       2000    /* Unless given */
+
+static fiber_mutex_t lock;
+static fiber_cond_t filled, emptied, all_in, gate;
+static int counter = 0, inside = 0, overlap = 0;
+static int full = 0, item, sum = 0;
+static int arrived = 0, open = 0;
+
+void *count(void *arg)
+{
+  int i;
+
+  for (i = 0; i < NUM_ROUNDS; i++) {
+    fiber_mutex_lock(&lock);
+    if (inside++)
+      overlap = 1;
+    fiber_yield();
+    counter++;
+    inside--;
+    fiber_mutex_unlock(&lock);
+    fiber_yield();
+  }
+  return NULL;
+}
+
+void *producer(void *arg)
+{
+  int i, me = (int) arg;
+
+  for (i = 1; i <= NUM_ITEMS; i++) {
+    fiber_mutex_lock(&lock);
+    while (full)
+      fiber_cond_wait(&emptied, &lock);
+    item = me * NUM_ITEMS + i;
+    full = 1;
+    fiber_cond_signal(&filled);
+    fiber_mutex_unlock(&lock);
+  }
+  return NULL;
+}
+
+void *consumer(void *arg)
+{
+  int i;
+
+  for (i = 0; i < NUM_ITEMS; i++) {
+    fiber_mutex_lock(&lock);
+    while (!full)
+      fiber_cond_wait(&filled, &lock);
+    sum += item;
+    full = 0;
+    fiber_mutex_unlock(&lock);
+    fiber_cond_signal(&emptied);
+  }
+  return NULL;
+}
+
+void *child(void *arg)
+{
+  return (void *) ((int) arg * 2);
+}
+
+void *parent(void *arg)
+{
+  int fids[NUM_CHILDREN], i, total = 0;
+  void *status;
+
+  for (i = 0; i < NUM_CHILDREN; i++)
+    fids[i] = fiber_create(child, (void *) ((int) arg + i));
+  for (i = 0; i < NUM_CHILDREN; i++) {
+    if (fiber_join(fids[i], &status) < 0)
+      return (void *) -1;
+    total += (int) status;
+  }
+  return (void *) total;
+}
+
+void *crowd(void *arg)
+{
+  fiber_mutex_lock(&lock);
+  arrived++;
+  fiber_cond_signal(&all_in);
+  while (!open)
+    fiber_cond_wait(&gate, &lock);
+  fiber_mutex_unlock(&lock);
+  return arg;
+}
+
+void *opener(void *arg)
+{
+  fiber_mutex_lock(&lock);
+  while (arrived < (int) arg)
+    fiber_cond_wait(&all_in, &lock);
+  open = 1;
+  fiber_cond_broadcast(&gate);
+  fiber_mutex_unlock(&lock);
+  return NULL;
+}
+
+int
+main(int argc, char *argv[])
+{
+  int i, j, expected = 0, created = 0, ok = 1;
+  int num_crowd = argc > 1 ? atoi(argv[1]) : NUM_CROWD, *fids;
+  void *status;
+
+  if (thr_init(STACK_SIZE) < 0 || fiber_init(NUM_WORKERS, FIBER_STACK) < 0 ||
+      fiber_mutex_init(&lock) < 0 || fiber_cond_init(&filled) < 0 ||
+      fiber_cond_init(&emptied) < 0 || fiber_cond_init(&all_in) < 0 ||
+      fiber_cond_init(&gate) < 0 || num_crowd < NUM_COUNTERS ||
+      (fids = malloc(num_crowd * sizeof(int))) == NULL)
+    return -1;
+  if (fiber_self() != 0)
+    ok = 0;
+
+  for (i = 0; i < NUM_COUNTERS; i++)
+    fids[i] = fiber_create(count, NULL);
+  for (i = 0; i < NUM_COUNTERS; i++)
+    fiber_join(fids[i], NULL);
+  if (counter != NUM_COUNTERS * NUM_ROUNDS || overlap)
+    ok = 0;
+
+  fids[0] = fiber_create(producer, (void *) 0);
+  fids[1] = fiber_create(producer, (void *) 1);
+  fids[2] = fiber_create(consumer, NULL);
+  fids[3] = fiber_create(consumer, NULL);
+  for (i = 0; i < 4; i++)
+    fiber_join(fids[i], NULL);
+  for (i = 1; i <= 2 * NUM_ITEMS; i++)
+    expected += i;
+  if (sum != expected)
+    ok = 0;
+
+  for (i = 0; i < NUM_PARENTS; i++)
+    fids[i] = fiber_create(parent, (void *) (i * NUM_CHILDREN));
+  for (i = 0; i < NUM_PARENTS; i++) {
+    expected = 0;
+    for (j = 0; j < NUM_CHILDREN; j++)
+      expected += (i * NUM_CHILDREN + j) * 2;
+    if (fiber_join(fids[i], &status) < 0 || (int) status != expected)
+      ok = 0;
+  }
+  if (fiber_join(fids[0], NULL) >= 0)
+    ok = 0;
+
+  /* All of them blocked at once, till the last one is in */
+  while (created < num_crowd &&
+         (fids[created] = fiber_create(crowd, (void *) created)) > 0)
+    created++;
+  if (created < num_crowd || fiber_join(fiber_create(opener, (void *)
+                                                     created), NULL) < 0)
+    ok = 0;
+  for (i = 0; i < created; i++) {
+    if (fiber_join(fids[i], &status) < 0 || (int) status != i)
+      ok = 0;
+  }
+
+  free(fids);
+  if (fiber_shutdown() < 0)
+    ok = 0;
+  lprintf("fiber_test: %s\n", ok ? "success" : "FAILED");
+  return !ok;
+}
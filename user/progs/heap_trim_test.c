@@ -0,0 +1,120 @@
+/**
+ * @file user/progs/heap_trim_test.c
+ * @author Zhan Chen (zhanc1)
+ * @brief Test for giving freed heap memory back to the kernel.
+ *
+ * A burst of allocations is freed and the pages in the middle of it must be
+ * gone, which is checked by asking new_pages() for one of them. The burst is
+ * repeated to make sure the pages come back when the heap is reused, from a
+ * few threads at once, and then once more with trimming turned off until
+ * malloc_trim() is called by hand.
+ */
+
+#include <syscall.h>
+#include <simics.h>
+#include <stddef.h>
+#include <malloc.h>
+#include <thread.h>
+
+#define STACK_SIZE    4096
+#define BLOCK_SIZE    (12 * 1024)
+#define NUM_BLOCKS    160
+#define NUM_ROUNDS    8
+#define NUM_THREADS   3
+
+static int failed = 0;
+
+/**
+ * @brief Fill and check a burst of blocks, then free them.
+ * @param blocks Where to keep the blocks.
+ * @param seed Value mixed into the fill pattern.
+ * @return The page in the middle of the burst.
+ */
+static void *burst(int **blocks, int seed)
+{
+  int i, j;
+  void *middle;
+
+  for (i = 0; i < NUM_BLOCKS; i++) {
+    blocks[i] = malloc(BLOCK_SIZE);
+    if (blocks[i] == NULL) {
+      failed = 1;
+      return NULL;
+    }
+    for (j = 0; j < BLOCK_SIZE / sizeof(int); j++)
+      blocks[i][j] = seed + i + j;
+  }
+  for (i = 0; i < NUM_BLOCKS; i++) {
+    for (j = 0; j < BLOCK_SIZE / sizeof(int); j++) {
+      if (blocks[i][j] != seed + i + j)
+        failed = 1;
+    }
+  }
+  middle = (void *)(((unsigned int) blocks[NUM_BLOCKS / 2] + PAGE_SIZE) &
+                    ~(PAGE_SIZE - 1));
+  for (i = 0; i < NUM_BLOCKS; i++)
+    free(blocks[i]);
+  return middle;
+}
+
+/**
+ * @brief Tell whether page is mapped, without touching it.
+ */
+static int mapped(void *page)
+{
+  if (new_pages(page, PAGE_SIZE) < 0)
+    return 1;
+  remove_pages(page);
+  return 0;
+}
+
+void *churn(void *arg)
+{
+  int *blocks[NUM_BLOCKS];
+  int i;
+
+  for (i = 0; i < NUM_ROUNDS; i++)
+    burst(blocks, (int) arg * NUM_ROUNDS + i);
+  return NULL;
+}
+
+int
+main(int argc, char *argv[])
+{
+  int *blocks[NUM_BLOCKS];
+  int tids[NUM_THREADS];
+  void *middle;
+  int i;
+
+  if (thr_init(STACK_SIZE) < 0)
+    return -1;
+
+  /* Freed bursts give their pages back, and get them again when reused */
+  for (i = 0; i < NUM_ROUNDS; i++) {
+    middle = burst(blocks, i);
+    if (middle == NULL || mapped(middle)) {
+      lprintf("heap_trim_test: page %p still mapped after round %d\n",
+              middle, i);
+      failed = 1;
+    }
+  }
+  if (malloc_trim() != 0)
+    failed = 1;
+
+  for (i = 0; i < NUM_THREADS; i++)
+    tids[i] = thr_create(churn, (void *) i);
+  for (i = 0; i < NUM_THREADS; i++)
+    thr_join(tids[i], NULL);
+
+  /* With trimming off only malloc_trim() gives pages back */
+  malloc_set_trim_threshold(0);
+  middle = burst(blocks, -1);
+  if (middle == NULL || !mapped(middle) || malloc_trim() <= 0 ||
+      mapped(middle))
+    failed = 1;
+  malloc_set_trim_threshold(BLOCK_SIZE);
+  burst(blocks, -2);
+
+  lprintf("heap_trim_test: %s\n", failed ? "FAILED" : "success");
+  return failed;
+}
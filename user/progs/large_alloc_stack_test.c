@@ -0,0 +1,85 @@
+/**
+ * @file user/progs/large_alloc_stack_test.c
+ * @author X.D. Zhai (xingdaz)
+ * @brief Test for large allocations made before thr_init().
+ *
+ * Large blocks are mapped in ranges of their own, from the top of the
+ * address space down. Without thr_init() there are no peer stacks to put in
+ * between, and the root thread's stack must still have room to grow: a
+ * single threaded program takes a few large blocks, then recurses a long way
+ * down. Neither the blocks nor the frames may be scribbled over, and no
+ * block may be where the stack went. The blocks grow a page each, so that
+ * none fits in a range another one was given, should that range be taken
+ * by something else already.
+ */
+
+#include <syscall.h>
+#include <simics.h>
+#include <stddef.h>
+#include <string.h>
+#include <malloc.h>
+
+#define LARGE         (64 * 1024)
+#define NUM_LARGE     8
+#define SIZE(i)       (LARGE + (i) * PAGE_SIZE)
+#define FRAME         1000
+#define DEPTH         1000    /* ~1 MB of stack */
+
+static int failed = 0;
+
+/**
+ * @brief Fills a frame, recurses, then checks that the frame is intact.
+ */
+static int deep(int depth)
+{
+  char frame[FRAME];
+  int i, ret = 0;
+
+  memset(frame, depth & 0xff, sizeof(frame));
+  if (depth > 0)
+    ret = deep(depth - 1);
+  for (i = 0; i < sizeof(frame); i++) {
+    if (frame[i] != (char) (depth & 0xff))
+      return -1;
+  }
+  return ret;
+}
+
+int
+main(int argc, char *argv[])
+{
+  char *blocks[NUM_LARGE], *top = (char *) &argc;
+  int i, j;
+
+  for (i = 0; i < NUM_LARGE; i++) {
+    if ((blocks[i] = malloc(SIZE(i))) == NULL) {
+      lprintf("large_alloc_stack_test: out of memory\n");
+      return -1;
+    }
+    memset(blocks[i], i, SIZE(i));
+  }
+
+  if (deep(DEPTH) < 0) {
+    lprintf("large_alloc_stack_test: a frame was scribbled over\n");
+    failed = 1;
+  }
+
+  for (i = 0; i < NUM_LARGE; i++) {
+    if (blocks[i] + SIZE(i) > top - DEPTH * FRAME && blocks[i] < top) {
+      lprintf("large_alloc_stack_test: block at %p in the stack's way\n",
+              blocks[i]);
+      failed = 1;
+    }
+    for (j = 0; j < SIZE(i); j++) {
+      if (blocks[i][j] != (char) i) {
+        lprintf("large_alloc_stack_test: block %d scribbled over\n", i);
+        failed = 1;
+        break;
+      }
+    }
+    free(blocks[i]);
+  }
+
+  lprintf("large_alloc_stack_test: %s\n", failed ? "FAILED" : "success");
+  return failed;
+}
@@ -0,0 +1,136 @@
+/**
+ * @file user/progs/large_alloc_test.c
+ * @author X.D. Zhai (xingdaz)
+ * @brief Test for large allocations mapped outside the heap.
+ *
+ * Large blocks must live outside the heap, be unmapped as soon as they are
+ * freed and have their address space reused afterwards, including a range
+ * that is only big enough once freed neighbours are merged. Moving data
+ * between the heap and a mapped block with realloc() must keep it intact.
+ * A thread working out of an arena of its own must unmap a large block right
+ * away too, even though the block belongs to arena 0.
+ */
+
+#include <syscall.h>
+#include <simics.h>
+#include <stddef.h>
+#include <string.h>
+#include <malloc.h>
+#include <thread.h>
+
+#define STACK_SIZE    4096
+#define LARGE         (64 * 1024)
+#define NUM_LARGE     16
+#define NUM_CYCLES    1000
+#define NUM_THREADS   4       /* At least one gets an arena besides 0 */
+
+static int failed = 0;
+
+/**
+ * @brief Tell whether page is mapped, without touching it.
+ */
+static int mapped(void *page)
+{
+  if (new_pages(page, PAGE_SIZE) < 0)
+    return 1;
+  remove_pages(page);
+  return 0;
+}
+
+/**
+ * @brief Fail the test with a message.
+ */
+static void fail(const char *what)
+{
+  lprintf("large_alloc_test: %s\n", what);
+  failed = 1;
+}
+
+/**
+ * @brief Frees the large block it is given, after a small allocation that
+ *        picks its arena.
+ */
+void *freer(void *arg)
+{
+  free(malloc(64));
+  free(arg);
+  return NULL;
+}
+
+int
+main(int argc, char *argv[])
+{
+  char *blocks[NUM_LARGE];
+  char *small, *big, *first, *low, *high;
+  void *page;
+  int i;
+
+  if (thr_init(STACK_SIZE) < 0)
+    return -1;
+
+  /* Out of the heap, gone once freed, and its address used again */
+  small = malloc(64);
+  big = malloc(LARGE);
+  if (small == NULL || big == NULL)
+    return -1;
+  if (big > small && big < small + LARGE)
+    fail("large block inside the heap");
+  memset(big, 0x5a, LARGE);
+  page = (void *)(((unsigned int) big + PAGE_SIZE) & ~(PAGE_SIZE - 1));
+  free(big);
+  if (mapped(page))
+    fail("freed large block still mapped");
+  first = big;
+  for (i = 0; i < NUM_CYCLES; i++) {
+    big = malloc(LARGE);
+    if (big != first)
+      fail("address space not reused");
+    big[LARGE - 1] = i;
+    free(big);
+  }
+
+  /* Freed neighbours are merged into one range big enough for all of them */
+  low = high = NULL;
+  for (i = 0; i < NUM_LARGE; i++) {
+    blocks[i] = malloc(LARGE);
+    if (blocks[i] == NULL)
+      return -1;
+    if (low == NULL || blocks[i] < low)
+      low = blocks[i];
+    if (blocks[i] > high)
+      high = blocks[i];
+  }
+  for (i = 0; i < NUM_LARGE; i += 2)
+    free(blocks[i]);
+  for (i = 1; i < NUM_LARGE; i += 2)
+    free(blocks[i]);
+  big = malloc(NUM_LARGE * LARGE);
+  if (big == NULL || big < low - PAGE_SIZE || big > high)
+    fail("freed ranges not merged");
+  free(big);
+
+  /* realloc() across the threshold in both directions */
+  strcpy(small, "pebbles");
+  big = realloc(small, LARGE);
+  if (big == NULL || strcmp(big, "pebbles") != 0)
+    fail("realloc into a mapped block");
+  big[LARGE - 1] = 'x';
+  small = realloc(big, 64);
+  if (small == NULL || strcmp(small, "pebbles") != 0)
+    fail("realloc out of a mapped block");
+  free(small);
+
+  /* Freed by threads of the other arenas */
+  for (i = 0; i < NUM_THREADS; i++) {
+    big = malloc(LARGE);
+    if (big == NULL)
+      return -1;
+    page = (void *)(((unsigned int) big + PAGE_SIZE) & ~(PAGE_SIZE - 1));
+    thr_join(thr_create(freer, big), NULL);
+    if (mapped(page))
+      fail("large block freed by another thread still mapped");
+  }
+
+  lprintf("large_alloc_test: %s\n", failed ? "FAILED" : "success");
+  return failed;
+}
@@ -0,0 +1,136 @@
+/**
+ * @file user/progs/lazy_stack_test.c
+ * @author Zhan Chen (zhanc1)
+ * @brief Test for lazily committed peer thread stacks.
+ *
+ * Four hundred threads with a declared stack size of 256 KB are alive at the
+ * same time, far more than could be backed by memory if every stack was
+ * committed up front. Each thread only uses a few hundred bytes, except for
+ * a few that recurse most of the way down their stack, and a few that jump
+ * half of it down at once with a single frame. One more makes system calls
+ * at every depth across a few pages that aren't committed yet, so that some
+ * of them fault in the middle of the call.
+ */
+
+#include <syscall.h>
+#include <simics.h>
+#include <stddef.h>
+#include <thread.h>
+#include <barrier.h>
+#include <string.h>
+
+#define STACK_SIZE    (256 * 1024)
+#define NUM_THREADS   400
+#define NUM_DEEP      4
+#define DEPTH         200     /* ~1 KB a frame */
+#define NUM_BIG       2
+#define BIG_FRAME     (128 * 1024)
+#define EDGE_PAGES    3
+
+static barrier_t all_alive;
+static int failed = 0;
+
+static int deep(int depth)
+{
+  volatile char frame[1000];
+
+  frame[0] = depth;
+  if (depth == 0)
+    return frame[0];
+  return deep(depth - 1) + 1;
+}
+
+void *shallow(void *arg)
+{
+  char buf[256];
+  int i;
+
+  for (i = 0; i < sizeof(buf); i++)
+    buf[i] = (int) arg;
+  barrier_wait(&all_alive);
+  return (void *) (int) buf[sizeof(buf) - 1];
+}
+
+void *grower(void *arg)
+{
+  barrier_wait(&all_alive);
+  return (void *) deep(DEPTH);
+}
+
+void *big_frame(void *arg)
+{
+  char frame[BIG_FRAME];
+
+  barrier_wait(&all_alive);
+  memset(frame, (int) arg, sizeof(frame));
+  return (void *) (int) (frame[0] + frame[sizeof(frame) - 1]);
+}
+
+/**
+ * @brief Calls make_runnable() on a thread that isn't descheduled from
+ *        depth bytes further down the stack, without touching them.
+ */
+static int call_at(int depth)
+{
+  char skip[depth];
+
+  (void) skip;
+  return make_runnable(thr_getid());
+}
+
+void *edge(void *arg)
+{
+  int depth;
+
+  barrier_wait(&all_alive);
+  for (depth = sizeof(int); depth <= EDGE_PAGES * PAGE_SIZE;
+       depth += sizeof(int)) {
+    if (call_at(depth) >= 0)
+      return (void *) -1;
+  }
+  return NULL;
+}
+
+int
+main(int argc, char *argv[])
+{
+  static int tids[NUM_THREADS];
+  void *status;
+  int i;
+
+  if (thr_init(STACK_SIZE) < 0 || barrier_init(&all_alive, NUM_THREADS) < 0)
+    return -1;
+
+  for (i = 0; i < NUM_THREADS; i++) {
+    if (i == NUM_THREADS - 1)
+      tids[i] = thr_create(edge, NULL);
+    else if (i < NUM_DEEP)
+      tids[i] = thr_create(grower, NULL);
+    else if (i < NUM_DEEP + NUM_BIG)
+      tids[i] = thr_create(big_frame, (void *) i);
+    else
+      tids[i] = thr_create(shallow, (void *) (i & 0x7f));
+    if (tids[i] < 0) {
+      lprintf("lazy_stack_test: thread %d not created\n", i);
+      task_vanish(-1);
+    }
+  }
+
+  for (i = 0; i < NUM_THREADS; i++) {
+    if (thr_join(tids[i], &status) < 0)
+      failed = 1;
+    else if (i < NUM_DEEP && (int) status != DEPTH)
+      failed = 1;
+    else if (i >= NUM_DEEP && i < NUM_DEEP + NUM_BIG &&
+             (int) status != 2 * i)
+      failed = 1;
+    else if (i == NUM_THREADS - 1 && status != NULL)
+      failed = 1;
+    else if (i >= NUM_DEEP + NUM_BIG && i < NUM_THREADS - 1 &&
+             (int) status != (i & 0x7f))
+      failed = 1;
+  }
+
+  lprintf("lazy_stack_test: %s\n", failed ? "FAILED" : "success");
+  return failed;
+}
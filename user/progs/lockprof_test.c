@@ -0,0 +1,77 @@
+/**
+ * @file user/progs/lockprof_test.c
+ * @author Zhan Chen (zhanc1)
+ * @brief Test for the lock contention profiler.
+ *
+ * A few threads fight over a mutex, a reader/writer lock and a semaphore,
+ * each holding them across a yield() so that the others have to wait. The
+ * locks are named and the profile dumped at the end, where they have to top
+ * the list in a library built with THR_PROFILE. Otherwise the dump only has
+ * to say it isn't there.
+ */
+
+#include <syscall.h>
+#include <simics.h>
+#include <stddef.h>
+#include <thread.h>
+#include <mutex.h>
+#include <rwlock.h>
+#include <sem.h>
+#include <lockprof.h>
+
+#define STACK_SIZE    4096
+#define NUM_THREADS   6
+#define NUM_ROUNDS    100
+
+static mutex_t hot;
+static rwlock_t rw;
+static sem_t slots;
+static volatile int count = 0;
+
+void *worker(void *arg)
+{
+  int i, mine;
+
+  for (i = 0; i < NUM_ROUNDS; i++) {
+    mutex_lock(&hot);
+    mine = count;
+    yield(-1);
+    count = mine + 1;
+    mutex_unlock(&hot);
+  }
+  for (i = 0; i < NUM_ROUNDS; i++) {
+    rwlock_lock(&rw, i % 4 ? RWLOCK_READ : RWLOCK_WRITE);
+    yield(-1);
+    rwlock_unlock(&rw);
+  }
+  for (i = 0; i < NUM_ROUNDS; i++) {
+    sem_wait(&slots);
+    yield(-1);
+    sem_signal(&slots);
+  }
+  return NULL;
+}
+
+int
+main(int argc, char *argv[])
+{
+  int tids[NUM_THREADS];
+  int i;
+
+  if (thr_init(STACK_SIZE) < 0 || mutex_init(&hot) < 0 ||
+      rwlock_init(&rw) < 0 || sem_init(&slots, 2) < 0)
+    return -1;
+  lockprof_name(&hot, "hot");
+  lockprof_name(&rw, "rw");
+  lockprof_name(&slots, "slots");
+
+  for (i = 0; i < NUM_THREADS; i++)
+    tids[i] = thr_create(worker, NULL);
+  for (i = 0; i < NUM_THREADS; i++)
+    thr_join(tids[i], NULL);
+  lockprof_dump(8);
+
+  lprintf("lockprof_test: %s\n",
+          count == NUM_THREADS * NUM_ROUNDS ? "success" : "FAILED");
+  return count != NUM_THREADS * NUM_ROUNDS;
+}
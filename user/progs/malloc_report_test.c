@@ -0,0 +1,51 @@
+/**
+ * @file user/progs/malloc_report_test.c
+ * @author Zhan Chen (zhanc1)
+ * @brief Test for the allocator report of a program without threads.
+ *
+ * Goes about it the way the shell does: no thr_init(), and straight to
+ * _malloc() and _free(). Command lines come and go, a few are never freed,
+ * and _malloc_report() then has to print them as in use in their size
+ * class. The test checks the counters itself; the host build's make check
+ * also looks for the report's lines in its output, see host/Makefile.
+ */
+
+#include <syscall.h>
+#include <simics.h>
+#include <stddef.h>
+#include <string.h>
+#include <malloc.h>
+
+#define NUM_LINES     50
+#define NUM_LEAKED    7
+#define LINE_SIZE     2000  /* 2016 with overhead, in the class up to 2048 */
+#define LINE_CLASS    6
+
+int
+main(int argc, char *argv[])
+{
+  malloc_stats_t stats;
+  char *lines[NUM_LINES];
+  int i, failed = 0;
+
+  for (i = 0; i < NUM_LINES; i++) {
+    if ((lines[i] = _malloc(LINE_SIZE)) == NULL) {
+      lprintf("malloc_report_test: out of memory\n");
+      return -1;
+    }
+    memset(lines[i], 'a' + i % 26, LINE_SIZE);
+  }
+  for (i = NUM_LEAKED; i < NUM_LINES; i++)
+    _free(lines[i]);
+
+  _malloc_stats(&stats);
+  if (stats.allocs[LINE_CLASS] - stats.frees[LINE_CLASS] != NUM_LEAKED) {
+    lprintf("malloc_report_test: %u lines in use, not %d\n",
+            stats.allocs[LINE_CLASS] - stats.frees[LINE_CLASS], NUM_LEAKED);
+    failed = 1;
+  }
+  _malloc_report();
+
+  lprintf("malloc_report_test: %s\n", failed ? "FAILED" : "success");
+  return failed;
+}
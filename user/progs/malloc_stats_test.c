@@ -0,0 +1,109 @@
+/**
+ * @file user/progs/malloc_stats_test.c
+ * @author Zhan Chen (zhanc1)
+ * @brief Test for the allocator counters and report.
+ *
+ * Blocks of one size class come and go, and the counters have to follow
+ * them exactly, in use bytes included. A block that is never freed has to
+ * show up as in use, and large blocks as mapped. Then a few threads share
+ * the arenas for a while and the report gets printed.
+ */
+
+#include <syscall.h>
+#include <simics.h>
+#include <stddef.h>
+#include <malloc.h>
+#include <thread.h>
+
+#define STACK_SIZE    4096
+#define NUM_THREADS   8
+#define NUM_BLOCKS    100
+#define BLOCK_SIZE    100   /* 112 with overhead, in the class up to 128 */
+#define BLOCK_CLASS   2
+#define LARGE         (64 * 1024)
+
+static int failed = 0;
+
+/**
+ * @brief Fail the test with a message.
+ */
+static void fail(const char *what)
+{
+  lprintf("malloc_stats_test: %s\n", what);
+  failed = 1;
+}
+
+/**
+ * @brief Blocks of the test's class in use according to stats.
+ */
+static int in_use(malloc_stats_t *stats)
+{
+  return stats->allocs[BLOCK_CLASS] - stats->frees[BLOCK_CLASS];
+}
+
+void *worker(void *arg)
+{
+  void *blocks[NUM_BLOCKS];
+  int i, j;
+
+  for (i = 0; i < 20; i++) {
+    for (j = 0; j < NUM_BLOCKS; j++)
+      blocks[j] = malloc(1 + (i * j * 37) % 4000);
+    for (j = 0; j < NUM_BLOCKS; j++)
+      free(blocks[j]);
+  }
+  return NULL;
+}
+
+int
+main(int argc, char *argv[])
+{
+  malloc_stats_t before, during, after;
+  void *blocks[NUM_BLOCKS];
+  void *leak, *large;
+  int tids[NUM_THREADS];
+  int i;
+
+  if (thr_init(STACK_SIZE) < 0)
+    return -1;
+  free(malloc(BLOCK_SIZE));
+
+  malloc_stats(&before);
+  for (i = 0; i < NUM_BLOCKS; i++)
+    blocks[i] = malloc(BLOCK_SIZE);
+  leak = malloc(BLOCK_SIZE);
+  large = malloc(LARGE);
+  malloc_stats(&during);
+  if (in_use(&during) - in_use(&before) != NUM_BLOCKS + 1)
+    fail("allocs not counted");
+  if (during.live - before.live != (NUM_BLOCKS + 1) * (BLOCK_SIZE + 12))
+    fail("live bytes wrong");
+  if (during.mapped - before.mapped < LARGE)
+    fail("large block not mapped");
+  if (during.searches <= before.searches || during.probes < during.searches)
+    fail("searches not counted");
+  if (during.committed < during.live + during.free_bytes ||
+      during.largest_free > during.free_bytes)
+    fail("heap doesn't add up");
+
+  for (i = 0; i < NUM_BLOCKS; i++)
+    free(blocks[i]);
+  free(large);
+  malloc_stats(&after);
+  if (in_use(&after) - in_use(&before) != 1)
+    fail("leaked block not in use");
+  if (after.live - before.live != BLOCK_SIZE + 12)
+    fail("live bytes wrong after free");
+  if (after.mapped != before.mapped)
+    fail("large block still mapped");
+  free(leak);
+
+  for (i = 0; i < NUM_THREADS; i++)
+    tids[i] = thr_create(worker, NULL);
+  for (i = 0; i < NUM_THREADS; i++)
+    thr_join(tids[i], NULL);
+  malloc_report();
+
+  lprintf("malloc_stats_test: %s\n", failed ? "FAILED" : "success");
+  return failed;
+}
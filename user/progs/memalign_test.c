@@ -0,0 +1,133 @@
+/**
+ * @file user/progs/memalign_test.c
+ * @author X.D. Zhai (xingdaz)
+ * @brief Test for memalign() and valloc().
+ *
+ * Blocks of all alignments and sizes have to start where they were asked
+ * to, hold their data and not overlap, in arena 0 and in the arenas of a
+ * few threads. The space skipped in front of an aligned block has to be
+ * there for the next malloc(), and large page aligned blocks are mapped on
+ * their own like any other large block.
+ */
+
+#include <syscall.h>
+#include <simics.h>
+#include <stddef.h>
+#include <string.h>
+#include <malloc.h>
+#include <thread.h>
+
+#define STACK_SIZE    4096
+#define NUM_THREADS   4
+#define NUM_BLOCKS    96
+#define NUM_ROUNDS    6
+#define LARGE         (64 * 1024)
+
+static int failed = 0;
+
+/**
+ * @brief Fail the test with a message.
+ */
+static void fail(const char *what)
+{
+  lprintf("memalign_test: %s\n", what);
+  failed = 1;
+}
+
+/**
+ * @brief Alignment of block i, 16 bytes to 2 pages.
+ */
+static int block_align(int i)
+{
+  return 16 << (i % 10);
+}
+
+/**
+ * @brief Size of block i, from a few bytes to a couple of pages.
+ */
+static int block_size(int i)
+{
+  return 1 + (i * 389) % 9000;
+}
+
+void *worker(void *arg)
+{
+  unsigned char *blocks[NUM_BLOCKS];
+  int me = (int) arg, round, i, j, size;
+
+  for (round = 0; round < NUM_ROUNDS; round++) {
+    for (i = 0; i < NUM_BLOCKS; i++) {
+      size = block_size(i + round);
+      blocks[i] = memalign(block_align(i), size);
+      if (blocks[i] == NULL) {
+        fail("out of memory");
+        return NULL;
+      }
+      if ((unsigned int) blocks[i] % block_align(i))
+        fail("block not aligned");
+      memset(blocks[i], me + i, size);
+    }
+    for (i = 0; i < NUM_BLOCKS; i++) {
+      size = block_size(i + round);
+      for (j = 0; j < size; j++) {
+        if (blocks[i][j] != (unsigned char) (me + i)) {
+          fail("blocks overlap");
+          break;
+        }
+      }
+      if (i % 5 == 0 && (blocks[i] = realloc(blocks[i], size * 2)) == NULL)
+        fail("out of memory growing");
+      else if (blocks[i][size - 1] != (unsigned char) (me + i))
+        fail("data lost growing");
+    }
+    for (i = 0; i < NUM_BLOCKS; i++)
+      free(blocks[i]);
+  }
+  return NULL;
+}
+
+int
+main(int argc, char *argv[])
+{
+  int tids[NUM_THREADS];
+  char *before, *aligned, *after;
+  int i;
+
+  if (thr_init(STACK_SIZE) < 0)
+    return -1;
+
+  /* The space in front of the block is free */
+  before = malloc(24);
+  aligned = memalign(PAGE_SIZE, 64);
+  after = malloc(24);
+  if (aligned == NULL || (unsigned int) aligned % PAGE_SIZE)
+    fail("page aligned block");
+  else if (after > aligned)
+    fail("space in front of aligned block lost");
+  free(before);
+  free(aligned);
+  free(after);
+
+  /* Large ones go to a range of their own, and come back there */
+  aligned = valloc(LARGE);
+  if (aligned == NULL || (unsigned int) aligned % PAGE_SIZE)
+    fail("large page aligned block");
+  memset(aligned, 0x5a, LARGE);
+  before = aligned;
+  free(aligned);
+  if ((aligned = valloc(LARGE)) != before)
+    fail("large page aligned range not reused");
+  free(aligned);
+
+  if (memalign(24, 64) != NULL)
+    fail("alignment that isn't a power of two");
+
+  worker((void *) NUM_THREADS);
+  for (i = 0; i < NUM_THREADS; i++)
+    tids[i] = thr_create(worker, (void *) i);
+  for (i = 0; i < NUM_THREADS; i++)
+    thr_join(tids[i], NULL);
+
+  lprintf("memalign_test: %s\n", failed ? "FAILED" : "success");
+  return failed;
+}
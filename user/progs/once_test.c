@@ -0,0 +1,57 @@
+/**
+ * @file user/progs/once_test.c
+ * @author Zhan Chen (zhanc1)
+ * @brief Test for thr_once().
+ *
+ * A bunch of threads race through thr_once() on an initialization that
+ * yields halfway through. It must run exactly once and nobody may return
+ * from thr_once() before it has finished.
+ */
+
+#include <syscall.h>
+#include <simics.h>
+#include <stddef.h>
+#include <thread.h>
+#include <once.h>
+
+#define NUM_THREADS   8
+#define STACK_SIZE    4096
+
+static once_t once = ONCE_INIT;
+static volatile int runs = 0;
+static volatile int ready = 0;
+static int failed = 0;
+
+static void init(void)
+{
+  runs++;
+  yield(-1);
+  ready = 1;
+}
+
+void *racer(void *arg)
+{
+  thr_once(&once, init);
+  if (!ready || runs != 1)
+    failed = 1;
+  return NULL;
+}
+
+int
+main(int argc, char *argv[])
+{
+  int tids[NUM_THREADS];
+  int i;
+
+  if (thr_init(STACK_SIZE) < 0)
+    return -1;
+
+  for (i = 0; i < NUM_THREADS; i++)
+    tids[i] = thr_create(racer, NULL);
+  racer(NULL);
+  for (i = 0; i < NUM_THREADS; i++)
+    thr_join(tids[i], NULL);
+
+  lprintf("once_test: %s\n", failed ? "FAILED" : "success");
+  return failed;
+}
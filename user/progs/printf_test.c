@@ -0,0 +1,128 @@
+/**
+ * @file user/progs/printf_test.c
+ * @author Zhan Chen (zhanc1)
+ * @brief Test for _doprnt() through snprintf(): conversions, flags, widths
+ *        and precisions, numbers of every size, and output cut short.
+ */
+
+#include <syscall.h>
+#include <simics.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+
+#define BUF_SIZE        128
+
+static int failed = 0;
+
+/**
+ * @brief Checks what snprintf() made of a format against what it should be.
+ */
+static void check(int line, const char *got, const char *want)
+{
+  if (strcmp(got, want) != 0) {
+    lprintf("printf_test: line %d: got \"%s\", want \"%s\"\n", line, got,
+            want);
+    failed = 1;
+  }
+}
+
+/**
+ * @brief snprintf() into buf, without gcc checking the formats, some of
+ *        which only _doprnt() knows.
+ */
+static int format(char *buf, int size, const char *fmt, ...)
+{
+  va_list args;
+  int ret;
+
+  va_start(args, fmt);
+  ret = vsnprintf(buf, size, fmt, args);
+  va_end(args);
+  return ret;
+}
+
+#define CHECK(want, ...) do {                                       \
+    char buf[BUF_SIZE];                                             \
+    format(buf, sizeof(buf), __VA_ARGS__);                          \
+    check(__LINE__, buf, want);                                     \
+  } while (0)
+
+int
+main(int argc, char *argv[])
+{
+  char small[8], big[BUF_SIZE * 4], out[BUF_SIZE * 4];
+  int i;
+
+  /* Plain text, and conversions that aren't numbers */
+  CHECK("", "");
+  CHECK("no conversions at all", "no conversions at all");
+  CHECK("100%", "100%%");
+  CHECK("a-b", "%c-%c", 'a', 'b');
+  CHECK("[hello]", "[%s]", "hello");
+  CHECK("[]", "[%s]", (char *) NULL);
+  CHECK("[  hi]", "[%4s]", "hi");
+  CHECK("[hi  ]", "[%-4s]", "hi");
+  CHECK("[hel]", "[%.3s]", "hello");
+  CHECK("[  hel]", "[%5.3s]", "hello");
+  CHECK("[hel  ]", "[%-5.3s]", "hello");
+  CHECK("[   hi]", "[%*s]", 5, "hi");
+  CHECK("[hi   ]", "[%*s]", -5, "hi");
+  CHECK("[he]", "[%.*s]", 2, "hello");
+
+  /* Decimal */
+  CHECK("0 7 42 100 65535", "%d %d %d %d %d", 0, 7, 42, 100, 65535);
+  CHECK("-1 -10 -99 -100", "%d %d %d %d", -1, -10, -99, -100);
+  CHECK("2147483647 -2147483648", "%d %d", 2147483647, (int) 0x80000000);
+  CHECK("4294967295 3000000000", "%u %u", 0xffffffff, 3000000000u);
+  CHECK("[   42] [42   ] [00042]", "[%5d] [%-5d] [%05d]", 42, 42, 42);
+  CHECK("[  -42] [-0042] [-42  ]", "[%5d] [%05d] [%-5d]", -42, -42, -42);
+  CHECK("+5 -5  5", "%+d %+d % d", 5, -5, 5);
+  CHECK("[+0005]", "[%+05d]", 5);
+  CHECK("123456789 1000000000", "%ld %lu", 123456789L, 1000000000UL);
+  CHECK("9876543210 -9876543210", "%lld %lld", 9876543210LL,
+        -9876543210LL);
+  CHECK("18446744073709551615", "%llu", 0xffffffffffffffffULL);
+  CHECK("[ 9876543210]", "[%11lld]", 9876543210LL);
+
+  /* Other bases */
+  CHECK("0 f ff deadbeef", "%x %x %x %x", 0, 15, 255, 0xdeadbeef);
+  CHECK("deadbeef", "%X", 0xDEADBEEF);       /* Digits are lower case */
+  CHECK("[0x1f] [0] [0x0001f]", "[%#x] [%#x] [%#07x]", 0x1f, 0, 0x1f);
+  CHECK("[   1f] [0001f] [1f   ]", "[%5x] [%05x] [%-5x]", 0x1f, 0x1f,
+        0x1f);
+  CHECK("123456789abcdef0", "%llx", 0x123456789abcdef0ULL);
+  CHECK("17 017 0", "%o %#o %#o", 15, 15, 0);
+  CHECK("37777777777", "%o", 0xffffffff);
+  CHECK("-10 10", "%z %z", -16, 16);
+  CHECK("0x00000000 0x0000beef", "%p %p", (void *) 0, (void *) 0xbeef);
+  CHECK("1010", "%b", 10, "\2");
+  CHECK("3<BITTWO,BITONE>", "%b", 3, "\10\2BITTWO\1BITONE");
+
+  /* Several at once */
+  CHECK("tid 12: read 4096 bytes at 0x00ff1000 from \"disk\" in 37 ticks",
+        "tid %d: read %u bytes at %p from \"%s\" in %d ticks", 12, 4096,
+        (void *) 0xff1000, "disk", 37);
+
+  /* Cut short */
+  i = format(small, sizeof(small), "%s=%d", "value", 123456);
+  check(__LINE__, small, "value=1");
+  if (i != sizeof(small) - 1)
+    failed = 1;
+  i = format(small, sizeof(small), "%08x", 0xabc);
+  check(__LINE__, small, "00000ab");
+
+  /* Longer than any of the buffers along the way */
+  memset(big, 'y', BUF_SIZE * 2);
+  big[BUF_SIZE * 2] = '\0';
+  i = sprintf(out, "<%s>", big);
+  if (i != BUF_SIZE * 2 + 2 || out[0] != '<' || out[i - 1] != '>' ||
+      strncmp(out + 1, big, BUF_SIZE * 2) != 0)
+    failed = 1;
+  i = sprintf(out, "[%300d]", 5);
+  if (i != 302 || out[299] != ' ' || out[300] != '5' || out[301] != ']')
+    failed = 1;
+
+  lprintf("printf_test: %s\n", failed ? "FAILED" : "success");
+  return failed;
+}
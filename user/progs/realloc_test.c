@@ -0,0 +1,112 @@
+/**
+ * @file user/progs/realloc_test.c
+ * @author X.D. Zhai (xingdaz)
+ * @brief Test for realloc() growing and shrinking blocks in place.
+ *
+ * A buffer at the end of the heap is grown a little at a time, the way a
+ * string builder would, and must hardly ever move. Shrinking it must not
+ * move it either, and must leave the tail for the next malloc(). A buffer
+ * with an allocated block right behind it has to move, and in every case
+ * the data has to survive.
+ */
+
+#include <syscall.h>
+#include <simics.h>
+#include <stddef.h>
+#include <malloc.h>
+#include <thread.h>
+
+#define STACK_SIZE    4096
+#define STEP          24
+#define FINAL_SIZE    (64 * 1024)
+#define MAX_MOVES     4
+
+static int failed = 0;
+
+/**
+ * @brief Fail the test with a message.
+ */
+static void fail(const char *what)
+{
+  lprintf("realloc_test: %s\n", what);
+  failed = 1;
+}
+
+/**
+ * @brief Check that buf holds the pattern up to size.
+ */
+static int intact(unsigned char *buf, int size)
+{
+  int i;
+
+  for (i = 0; i < size; i++) {
+    if (buf[i] != (unsigned char) (i * 7))
+      return 0;
+  }
+  return 1;
+}
+
+int
+main(int argc, char *argv[])
+{
+  unsigned char *buf, *grown, *blocker, *tail;
+  int size, moves = 0, i;
+
+  if (thr_init(STACK_SIZE) < 0)
+    return -1;
+
+  /* Grow a little at a time */
+  if ((buf = malloc(STEP)) == NULL)
+    return -1;
+  for (i = 0; i < STEP; i++)
+    buf[i] = i * 7;
+  for (size = STEP; size < FINAL_SIZE; size += STEP) {
+    if ((grown = realloc(buf, size + STEP)) == NULL) {
+      fail("out of memory growing");
+      return -1;
+    }
+    if (grown != buf)
+      moves++;
+    buf = grown;
+    for (i = size; i < size + STEP; i++)
+      buf[i] = i * 7;
+  }
+  if (moves > MAX_MOVES)
+    fail("buffer kept moving while growing");
+  if (!intact(buf, size))
+    fail("data lost growing");
+
+  /* Shrink it, the tail goes to the next one to ask */
+  if (realloc(buf, FINAL_SIZE / 2) != buf)
+    fail("buffer moved while shrinking");
+  if (!intact(buf, FINAL_SIZE / 2))
+    fail("data lost shrinking");
+  tail = malloc(FINAL_SIZE / 8);
+  if (tail == NULL || tail < buf || tail >= buf + FINAL_SIZE)
+    fail("tail not reused");
+
+  /* Nowhere to grow, has to move */
+  blocker = malloc(STEP);
+  if ((grown = realloc(tail, FINAL_SIZE)) == NULL)
+    fail("out of memory moving");
+  free(blocker);
+  free(grown);
+
+  /* Grow into a free neighbour */
+  grown = malloc(STEP);
+  blocker = malloc(STEP * 4);
+  tail = malloc(STEP);
+  free(blocker);
+  for (i = 0; i < STEP; i++)
+    grown[i] = i * 7;
+  if (realloc(grown, STEP * 4) != grown)
+    fail("didn't grow into free neighbour");
+  if (!intact(grown, STEP))
+    fail("data lost growing into neighbour");
+
+  free(grown);
+  free(tail);
+  free(buf);
+  lprintf("realloc_test: %s\n", failed ? "FAILED" : "success");
+  return failed;
+}
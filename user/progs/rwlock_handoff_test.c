@@ -0,0 +1,136 @@
+/**
+ * @file user/progs/rwlock_handoff_test.c
+ * @author Zhan Chen (zhanc1)
+ * @brief Test for who gets an rwlock when a writer lets go of it.
+ *
+ * The main thread holds the lock for writing while others queue up behind
+ * it, then lets go in one of three ways:
+ *
+ *   - "writer": a writer is queued, and must find itself the holder.
+ *   - "unlock": a reader then a writer are queued, the main thread unlocks.
+ *   - "downgrade": the same, but the main thread downgrades first.
+ *
+ * In the last two the reader gets in right away, and the writer when the
+ * readers are done; it may not be dropped from the queue on the way. Each
+ * waiter is only created once the one before it is in the queue, so the
+ * order is always the same.
+ */
+
+#include <syscall.h>
+#include <simics.h>
+#include <stddef.h>
+#include <string.h>
+#include <thread.h>
+#include <rwlock.h>
+#include <rwlock_type.h>
+
+#define STACK_SIZE    4096
+#define TIMEOUT       1000    /* Ticks to wait for the writer */
+
+static rwlock_t rwlock;
+static volatile int writer_done = 0;
+static int failed = 0;
+
+/**
+ * @brief Number of threads waiting on the rwlock.
+ */
+static int queued(void)
+{
+  list_ptr entry;
+  int n = 0;
+
+  mutex_lock(&rwlock.data);
+  for (entry = rwlock.queue.next; entry != &rwlock.queue; entry = entry->next)
+    n++;
+  mutex_unlock(&rwlock.data);
+  return n;
+}
+
+/**
+ * @brief Creates a thread and waits until it is in the rwlock's queue.
+ */
+static int create_queued(void *(*func)(void *))
+{
+  int n = queued();
+  int tid = thr_create(func, NULL);
+
+  while (queued() == n)
+    yield(-1);
+  return tid;
+}
+
+void *reader(void *arg)
+{
+  rwlock_lock(&rwlock, RWLOCK_READ);
+  if (rwlock.holder <= 0)
+    failed = 1;
+  rwlock_unlock(&rwlock);
+  return NULL;
+}
+
+void *writer(void *arg)
+{
+  rwlock_lock(&rwlock, RWLOCK_WRITE);
+  if (rwlock.holder != -gettid()) {
+    lprintf("rwlock_handoff_test: holder %d, not %d\n",
+            rwlock.holder, -gettid());
+    failed = 1;
+  }
+  writer_done = 1;
+  rwlock_unlock(&rwlock);
+  return NULL;
+}
+
+int
+main(int argc, char *argv[])
+{
+  char *mode = (argc > 1) ? argv[1] : "all";
+  int do_writer = 0, do_unlock = 0, do_downgrade = 0;
+  int r, w, i, t;
+
+  if (thr_init(STACK_SIZE) < 0 || rwlock_init(&rwlock) < 0)
+    return -1;
+
+  if (!strcmp(mode, "writer")) {
+    do_writer = 1;
+  } else if (!strcmp(mode, "unlock")) {
+    do_unlock = 1;
+  } else if (!strcmp(mode, "downgrade")) {
+    do_downgrade = 1;
+  } else {
+    do_writer = do_unlock = do_downgrade = 1;
+  }
+
+  if (do_writer) {
+    rwlock_lock(&rwlock, RWLOCK_WRITE);
+    w = create_queued(writer);
+    rwlock_unlock(&rwlock);
+    thr_join(w, NULL);
+  }
+
+  for (i = 0; i < 2; i++) {
+    if (!(i == 0 ? do_unlock : do_downgrade))
+      continue;
+    writer_done = 0;
+    rwlock_lock(&rwlock, RWLOCK_WRITE);
+    r = create_queued(reader);
+    w = create_queued(writer);
+    if (i == 1)
+      rwlock_downgrade(&rwlock);
+    rwlock_unlock(&rwlock);
+    thr_join(r, NULL);
+
+    for (t = 0; t < TIMEOUT && !writer_done; t++)
+      sleep(1);
+    if (!writer_done) {
+      lprintf("rwlock_handoff_test: writer dropped by %s\n",
+              i == 0 ? "unlock" : "downgrade");
+      lprintf("rwlock_handoff_test: FAILED\n");
+      task_vanish(-1);
+    }
+    thr_join(w, NULL);
+  }
+
+  lprintf("rwlock_handoff_test: %s\n", failed ? "FAILED" : "success");
+  return failed;
+}
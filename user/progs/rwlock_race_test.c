@@ -0,0 +1,83 @@
+/**
+ * @file user/progs/rwlock_race_test.c
+ * @author Zhan Chen (zhanc1)
+ * @brief Race test for rwlock_downgrade(), small enough for the schedule
+ *        explorer in host/ to go through a great many of its schedules.
+ *
+ * Writers bump a value and its copy one after the other, yielding in
+ * between, then downgrade and check nobody wrote since. Readers check the
+ * two agree. A writer let in by a downgrade, or a reader let in while a
+ * writer still holds the lock, gets caught. Everybody yields while holding
+ * the lock to give the others a chance at it.
+ */
+
+#include <syscall.h>
+#include <simics.h>
+#include <stddef.h>
+#include <thread.h>
+#include <rwlock.h>
+
+#define STACK_SIZE    4096
+#define NUM_WRITERS   2
+#define NUM_READERS   2
+#define NUM_ROUNDS    2
+
+static rwlock_t rwlock;
+static volatile int value = 0, copy = 0;
+static int failed = 0;
+
+void *writer(void *arg)
+{
+  int i, mine;
+
+  for (i = 0; i < NUM_ROUNDS; i++) {
+    rwlock_lock(&rwlock, RWLOCK_WRITE);
+    mine = ++value;
+    yield(-1);
+    copy = value;
+    rwlock_downgrade(&rwlock);
+    yield(-1);
+    if (value != mine || copy != mine)
+      failed = 1;
+    rwlock_unlock(&rwlock);
+  }
+  return NULL;
+}
+
+void *reader(void *arg)
+{
+  int i;
+
+  for (i = 0; i < NUM_ROUNDS; i++) {
+    rwlock_lock(&rwlock, RWLOCK_READ);
+    if (value != copy)
+      failed = 1;
+    yield(-1);
+    if (value != copy)
+      failed = 1;
+    rwlock_unlock(&rwlock);
+  }
+  return NULL;
+}
+
+int
+main(int argc, char *argv[])
+{
+  int tids[NUM_WRITERS + NUM_READERS];
+  int i;
+
+  if (thr_init(STACK_SIZE) < 0 || rwlock_init(&rwlock) < 0)
+    return -1;
+
+  for (i = 0; i < NUM_WRITERS; i++)
+    tids[i] = thr_create(writer, NULL);
+  for (i = 0; i < NUM_READERS; i++)
+    tids[NUM_WRITERS + i] = thr_create(reader, NULL);
+  for (i = 0; i < NUM_WRITERS + NUM_READERS; i++)
+    thr_join(tids[i], NULL);
+
+  if (value != NUM_WRITERS * NUM_ROUNDS)
+    failed = 1;
+  lprintf("rwlock_race_test: %s\n", failed ? "FAILED" : "success");
+  return failed;
+}
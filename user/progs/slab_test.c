@@ -0,0 +1,129 @@
+/**
+ * @file user/progs/slab_test.c
+ * @author X.D. Zhai (xingdaz)
+ * @brief Test for the slab caches.
+ *
+ * A few threads allocate objects from caches with and without front caches,
+ * fill them with their own pattern and check nobody else got the same
+ * object. Half of the objects are freed by a different thread than the one
+ * that allocated them. Then a lot of threads are created and joined in a
+ * row, which goes through the TCB cache and the flush on thr_exit().
+ */
+
+#include <syscall.h>
+#include <simics.h>
+#include <stddef.h>
+#include <thread.h>
+#include <slab.h>
+
+#define STACK_SIZE    4096
+#define NUM_THREADS   4
+#define NUM_CACHES    6   /* more than the ones getting front caches */
+#define NUM_OBJS      64
+#define NUM_ROUNDS    20
+#define NUM_CHURN     1000
+
+typedef struct obj {
+  int owner;
+  int words[5];
+} obj_t;
+
+static slab_t *caches[NUM_CACHES];
+static obj_t *handoff[NUM_THREADS][NUM_OBJS / 2];
+static volatile int handed_off[NUM_THREADS];
+static int failed = 0;
+
+/**
+ * @brief Allocates, checks and frees objects, freeing half of the objects of
+ *        the previous thread on the way.
+ * @param arg Index of the thread.
+ */
+void *worker(void *arg)
+{
+  int me = (int) arg, prev = (me + NUM_THREADS - 1) % NUM_THREADS;
+  obj_t *objs[NUM_OBJS];
+  slab_t *cache;
+  int round, i, j;
+
+  for (round = 0; round < NUM_ROUNDS; round++) {
+    cache = caches[round % NUM_CACHES];
+    for (i = 0; i < NUM_OBJS; i++) {
+      if ((objs[i] = slab_alloc(cache)) == NULL) {
+        failed = 1;
+        return NULL;
+      }
+      objs[i]->owner = me;
+      for (j = 0; j < 5; j++)
+        objs[i]->words[j] = me + i + j;
+    }
+    yield(-1);
+    for (i = 0; i < NUM_OBJS; i++) {
+      if (objs[i]->owner != me)
+        failed = 1;
+      for (j = 0; j < 5; j++) {
+        if (objs[i]->words[j] != me + i + j)
+          failed = 1;
+      }
+    }
+
+    /* Leave half for the next thread to free if it took the last batch,
+     * free the rest ourselves */
+    i = 0;
+    if (!handed_off[me]) {
+      for (; i < NUM_OBJS / 2; i++)
+        handoff[me][i] = objs[i];
+      handed_off[me] = round % NUM_CACHES + 1;
+    }
+    for (; i < NUM_OBJS; i++)
+      slab_free(cache, objs[i]);
+
+    if (handed_off[prev]) {
+      for (i = 0; i < NUM_OBJS / 2; i++)
+        slab_free(caches[handed_off[prev] - 1], handoff[prev][i]);
+      handed_off[prev] = 0;
+    }
+  }
+  return NULL;
+}
+
+void *nothing(void *arg)
+{
+  return arg;
+}
+
+int
+main(int argc, char *argv[])
+{
+  int tids[NUM_THREADS];
+  void *status;
+  int i, j;
+
+  if (thr_init(STACK_SIZE) < 0)
+    return -1;
+
+  for (i = 0; i < NUM_CACHES; i++) {
+    if ((caches[i] = slab_create(sizeof(obj_t))) == NULL)
+      return -1;
+  }
+  for (i = 0; i < NUM_THREADS; i++)
+    tids[i] = thr_create(worker, (void *) i);
+  for (i = 0; i < NUM_THREADS; i++)
+    thr_join(tids[i], NULL);
+  for (i = 0; i < NUM_THREADS; i++) {
+    if (handed_off[i]) {
+      for (j = 0; j < NUM_OBJS / 2; j++)
+        slab_free(caches[handed_off[i] - 1], handoff[i][j]);
+    }
+  }
+
+  for (i = 0; i < NUM_CHURN; i++) {
+    if (thr_join(thr_create(nothing, (void *) i), &status) < 0 ||
+        status != (void *) i) {
+      failed = 1;
+      break;
+    }
+  }
+
+  lprintf("slab_test: %s\n", failed ? "FAILED" : "success");
+  return failed;
+}
@@ -0,0 +1,87 @@
+/**
+ * @file user/progs/stack_overflow_test.c
+ * @author Zhan Chen (zhanc1)
+ * @brief Test for the guard page below peer thread stacks.
+ *
+ * A thread with a small stack recurses without end while its neighbour keeps
+ * checking a canary on its own stack, which is the next one down. The task
+ * is expected to be killed with a message naming the overflowing thread,
+ * something like:
+ *
+ *    Thread 5 overflowed its stack at 0xffbf5ffc, eip 0x1000123
+ *
+ * If the task lives on, the overflow went unnoticed.
+ *
+ * Run as "stack_overflow_test null", a thread dereferences a NULL pointer
+ * instead, which is no overflow however far below its stack it is:
+ *
+ *    Thread 5 exception 14 at 0x00000010, eip 0x1000123
+ */
+
+#include <syscall.h>
+#include <simics.h>
+#include <stddef.h>
+#include <thread.h>
+#include <string.h>
+
+#define STACK_SIZE    (2 * PAGE_SIZE)
+#define CANARY        0x0badc0de
+
+static volatile int canary_ok = 1;
+static volatile int bottom = -1;  /* Never reached */
+
+static int recurse(int depth)
+{
+  volatile int frame[16];
+
+  frame[0] = depth;
+  if (depth == bottom)
+    return depth;
+  return recurse(depth + 1) + frame[0];
+}
+
+void *overflower(void *arg)
+{
+  lprintf("stack_overflow_test: thread %d is about to overflow\n",
+          thr_getid());
+  return (void *) recurse(0);
+}
+
+void *null_deref(void *arg)
+{
+  volatile int *null = NULL;
+
+  lprintf("stack_overflow_test: thread %d is about to dereference NULL\n",
+          thr_getid());
+  return (void *) null[4];
+}
+
+void *neighbour(void *arg)
+{
+  volatile int canary = CANARY;
+
+  while (1) {
+    if (canary != CANARY)
+      canary_ok = 0;
+    yield(-1);
+  }
+  return NULL;
+}
+
+int
+main(int argc, char *argv[])
+{
+  if (thr_init(STACK_SIZE) < 0)
+    return -1;
+
+  if (argc > 1 && strcmp(argv[1], "null") == 0)
+    thr_create(null_deref, NULL);
+  else
+    thr_create(overflower, NULL);
+  thr_create(neighbour, NULL);
+  sleep(100);
+
+  lprintf("stack_overflow_test: FAILED, %s\n",
+          canary_ok ? "overflow went unnoticed" : "neighbour's stack smashed");
+  return -1;
+}
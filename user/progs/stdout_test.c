@@ -0,0 +1,84 @@
+/**
+ * @file user/progs/stdout_test.c
+ * @author Zhan Chen (zhanc1)
+ * @brief Test for buffered stdout: threads put lines together out of many
+ *        printf() and putchar() calls, which must not run into each other
+ *        when line or fully buffered. Besides the first, every line printed
+ *        reads "stdout_test: <tid> <n>:" followed by NUM_WORDS words of
+ *        " <tid>.<n>".
+ *
+ * The test can't read back the console, so it only checks what the calls
+ * return. "make check" in host/ checks the lines, and any change to what is
+ * printed has to go there too.
+ */
+
+#include <syscall.h>
+#include <simics.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <thread.h>
+
+#define STACK_SIZE      4096
+#define NUM_THREADS     4
+#define NUM_LINES       50
+#define NUM_WORDS       8
+
+static int modes[] = { _IOLBF, _IOFBF };
+
+void *talker(void *arg)
+{
+  int tid = thr_getid(), i, j;
+
+  for (i = 0; i < NUM_LINES; i++) {
+    printf("stdout_test: %d %d:", tid, i);
+    for (j = 0; j < NUM_WORDS; j++) {
+      putchar(' ');
+      printf("%d.%d", tid, i);
+    }
+    putchar('\n');
+    if (i % 10 == 0)
+      yield(-1);
+  }
+  return NULL;
+}
+
+int
+main(int argc, char *argv[])
+{
+  int i, m, tids[NUM_THREADS], ok = 1;
+  char *s;
+
+  if (setvbuf(stdout, NULL, 3, 0) != EOF ||
+      setvbuf(stdout, (char *) tids, _IOFBF, sizeof(tids)) != EOF ||
+      fflush(NULL) != 0)
+    ok = 0;
+
+  /* The unfinished line is held, thr_init() prints it */
+  if (setvbuf(stdout, NULL, _IOLBF, 0) != 0)
+    ok = 0;
+  for (s = "stdout_test: start"; *s; s++)
+    putchar(*s);
+  if (thr_init(STACK_SIZE) < 0)
+    return -1;
+  puts("ed");
+
+  for (m = 0; m < sizeof(modes) / sizeof(modes[0]); m++) {
+    if (setvbuf(stdout, NULL, modes[m], 0) != 0)
+      ok = 0;
+    for (i = 0; i < NUM_THREADS; i++)
+      tids[i] = thr_create(talker, NULL);
+    talker(NULL);
+    for (i = 0; i < NUM_THREADS; i++)
+      thr_join(tids[i], NULL);
+  }
+
+  /* Nothing is held, so only one thread talks */
+  if (setvbuf(stdout, NULL, _IONBF, 0) != 0)
+    ok = 0;
+  talker(NULL);
+  if (fflush(stdout) != 0)
+    ok = 0;
+
+  lprintf("stdout_test: %s\n", ok ? "success" : "FAILED");
+  return !ok;
+}
@@ -0,0 +1,110 @@
+/**
+ * @file user/progs/thr_attr_test.c
+ * @author Zhan Chen (zhanc1)
+ * @brief Test for thr_create_ex() and thread attributes.
+ *
+ * The library is initialized with a small stack size. A couple of threads
+ * get a large stack through the attributes and use most of it, one runs on a
+ * stack handed in by the caller, and a few hundred detached threads are
+ * created and forgotten about, whose memory has to be reused.
+ */
+
+#include <syscall.h>
+#include <simics.h>
+#include <stddef.h>
+#include <thread.h>
+#include <thread_ex.h>
+#include <mutex.h>
+
+#define STACK_SIZE    4096
+#define BIG_STACK     (64 * 1024)
+#define NUM_BIG       2
+#define NUM_DETACHED  300
+#define USER_STACK    8192
+
+static mutex_t lock;
+static volatile int detached_done = 0;
+static char user_stack[USER_STACK];
+static int failed = 0;
+
+/* Touches about 48 KB of stack */
+static int deep(int depth)
+{
+  char frame[1024];
+  int i;
+
+  for (i = 0; i < sizeof(frame); i++)
+    frame[i] = depth;
+  if (depth == 0)
+    return frame[0];
+  return deep(depth - 1) + frame[sizeof(frame) - 1];
+}
+
+void *big(void *arg)
+{
+  return (void *) deep(47);
+}
+
+void *on_user_stack(void *arg)
+{
+  char local;
+
+  if (&local < user_stack || &local >= user_stack + USER_STACK)
+    failed = 1;
+  return arg;
+}
+
+void *detached(void *arg)
+{
+  mutex_lock(&lock);
+  detached_done++;
+  mutex_unlock(&lock);
+  return NULL;
+}
+
+int
+main(int argc, char *argv[])
+{
+  thr_attr_t attr;
+  int tids[NUM_BIG];
+  void *status;
+  int i, tid;
+
+  if (thr_init(STACK_SIZE) < 0 || mutex_init(&lock) < 0)
+    return -1;
+
+  thr_attr_init(&attr);
+  thr_attr_setstacksize(&attr, BIG_STACK);
+  for (i = 0; i < NUM_BIG; i++)
+    tids[i] = thr_create_ex(big, NULL, &attr);
+  for (i = 0; i < NUM_BIG; i++) {
+    if (tids[i] < 0 || thr_join(tids[i], &status) < 0 ||
+        (int) status != 47 * 48 / 2)
+      failed = 1;
+  }
+
+  thr_attr_init(&attr);
+  if (thr_attr_setstack(&attr, user_stack, 16) >= 0)
+    failed = 1;
+  thr_attr_setstack(&attr, user_stack, USER_STACK);
+  tid = thr_create_ex(on_user_stack, (void *) 42, &attr);
+  if (tid < 0 || thr_join(tid, &status) < 0 || (int) status != 42)
+    failed = 1;
+
+  thr_attr_init(&attr);
+  thr_attr_setdetached(&attr, 1);
+  for (i = 0; i < NUM_DETACHED; i++) {
+    if ((tid = thr_create_ex(detached, NULL, &attr)) < 0) {
+      failed = 1;
+      break;
+    }
+  }
+  /* Nobody may join a detached thread */
+  if (tid >= 0 && thr_join(tid, NULL) == 0)
+    failed = 1;
+  while (detached_done < i)
+    yield(-1);
+
+  lprintf("thr_attr_test: %s\n", failed ? "FAILED" : "success");
+  return failed;
+}
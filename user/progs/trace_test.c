@@ -0,0 +1,119 @@
+/**
+ * @file user/progs/trace_test.c
+ * @author Zhan Chen (zhanc1)
+ * @brief Test for the event tracer.
+ *
+ * A few threads take turns on a mutex, pass a token around with a condition
+ * variable and allocate a little on the way, then the rings get dumped. In a
+ * library built with THR_TRACE every thr_create(), lock, unlock, malloc()
+ * and free() has to be in there, they are few enough for the rings to hold
+ * them all. Otherwise the dump only has to say it isn't there.
+ *
+ * realloc() only shows up as a free() and a malloc() when the block moves,
+ * so every block traced as taken is traced as given back exactly once.
+ */
+
+#include <syscall.h>
+#include <simics.h>
+#include <stddef.h>
+#include <malloc.h>
+#include <thread.h>
+#include <mutex.h>
+#include <cond.h>
+#include <trace.h>
+
+#define STACK_SIZE    4096
+#define NUM_THREADS   4
+#define NUM_ROUNDS    10
+
+static mutex_t lock;
+static cond_t turn;
+static volatile int token = 0;
+static int failed = 0;
+
+/**
+ * @brief Fails the test unless there are at least min events of type.
+ */
+static void expect(int type, int min, const char *what)
+{
+  int n = trace_count(type);
+
+  if (n >= 0 && n < min) {
+    lprintf("trace_test: %d %s, expected %d\n", n, what, min);
+    failed = 1;
+  }
+}
+
+void *worker(void *arg)
+{
+  int i, me = (int) arg;
+  void *buf;
+
+  for (i = 0; i < NUM_ROUNDS; i++) {
+    mutex_lock(&lock);
+    while (token % NUM_THREADS != me)
+      cond_wait(&turn, &lock);
+    buf = malloc(32 + i);
+    token++;
+    cond_broadcast(&turn);
+    mutex_unlock(&lock);
+    free(buf);
+  }
+  return NULL;
+}
+
+/**
+ * @brief Resizes a block every which way, then checks that the trace saw
+ *        as many blocks taken as given back.
+ */
+static void realloc_balance(void)
+{
+  int mallocs = trace_count(TRACE_MALLOC), frees = trace_count(TRACE_FREE);
+  char *buf, *moved;
+
+  buf = malloc(64);
+  buf = realloc(buf, 32);             /* Shrinks, in place */
+  if (realloc(buf, 0) != NULL)        /* Fails, leaves buf alone */
+    failed = 1;
+  if ((moved = realloc(buf, 16 * 1024)) != NULL)
+    buf = moved;
+  free(buf);
+
+  if (mallocs >= 0 && trace_count(TRACE_MALLOC) - mallocs !=
+      trace_count(TRACE_FREE) - frees) {
+    lprintf("trace_test: realloc() traced %d malloc()s and %d free()s\n",
+            trace_count(TRACE_MALLOC) - mallocs,
+            trace_count(TRACE_FREE) - frees);
+    failed = 1;
+  }
+}
+
+int
+main(int argc, char *argv[])
+{
+  int tids[NUM_THREADS];
+  int i;
+
+  if (thr_init(STACK_SIZE) < 0 || mutex_init(&lock) < 0 ||
+      cond_init(&turn) < 0)
+    return -1;
+
+  for (i = 0; i < NUM_THREADS; i++)
+    tids[i] = thr_create(worker, (void *) i);
+  for (i = 0; i < NUM_THREADS; i++)
+    thr_join(tids[i], NULL);
+  realloc_balance();
+
+  trace_dump();
+  expect(TRACE_CREATE, NUM_THREADS, "thr_create()s");
+  expect(TRACE_EXIT, NUM_THREADS, "exits");
+  expect(TRACE_LOCK, NUM_THREADS * NUM_ROUNDS, "locks");
+  expect(TRACE_UNLOCK, NUM_THREADS * NUM_ROUNDS, "unlocks");
+  expect(TRACE_MALLOC, NUM_THREADS * NUM_ROUNDS, "malloc()s");
+  expect(TRACE_FREE, NUM_THREADS * NUM_ROUNDS, "free()s");
+  if (token != NUM_THREADS * NUM_ROUNDS)
+    failed = 1;
+
+  lprintf("trace_test: %s\n", failed ? "FAILED" : "success");
+  return failed;
+}